@@ -5,6 +5,10 @@
 //
 //   - par_octasphere_get_counts
 //   - par_octasphere_populate
+//   - par_octasphere_populate_cached
+//   - par_octasphere_update_positions
+//   - par_octasphere_get_batch_offsets
+//   - par_octasphere_populate_batch
 //
 // Usage example:
 //
@@ -31,6 +35,12 @@
 //        /* Generate vertex coordinates, UV's, and triangle indices. */
 //        par_octasphere_populate(&cfg, &mesh);
 //
+// Attributes can be interleaved by pointing them into a single buffer and setting their strides.
+// To save memory, normals can be written as two snorm16 values with octahedral encoding.
+//
+// For very large meshes, set indices_mode to PAR_OCTASPHERE_INDICES_32 and allocate indices32
+// instead of indices. This raises the subdivision limit to PAR_OCTASPHERE_MAX_SUBDIVISIONS_32.
+//
 // To generate a sphere: set width, height, and depth to 0 in your configuration.
 // To generate a capsule shape: set only two of these dimensions to 0.
 //
@@ -47,6 +57,7 @@ extern "C" {
 #endif
 
 #define PAR_OCTASPHERE_MAX_SUBDIVISIONS 5
+#define PAR_OCTASPHERE_MAX_SUBDIVISIONS_32 12
 
 typedef enum {
     PAR_OCTASPHERE_UV_LATLONG,
@@ -56,6 +67,11 @@ typedef enum {
     PAR_OCTASPHERE_NORMALS_SMOOTH,
 } par_octasphere_normals_mode;
 
+typedef enum {
+    PAR_OCTASPHERE_INDICES_16,  // populates mesh.indices, this is the default
+    PAR_OCTASPHERE_INDICES_32,  // populates mesh.indices32
+} par_octasphere_indices_mode;
+
 typedef struct {
     float corner_radius;
     float width;
@@ -64,8 +80,11 @@ typedef struct {
     int num_subdivisions;
     par_octasphere_uv_mode uv_mode;
     par_octasphere_normals_mode normals_mode;
+    par_octasphere_indices_mode indices_mode;
 } par_octasphere_config;
 
+// Client-allocated mesh. Attribute strides are in bytes, where zero means tightly packed. The
+// normals stride applies to both normal formats. Attributes other than positions may be null.
 typedef struct {
     float* positions;
     float* normals;
@@ -73,6 +92,11 @@ typedef struct {
     uint16_t* indices;
     uint32_t num_indices;
     uint32_t num_vertices;
+    uint32_t* indices32;
+    int16_t* octahedral_normals;
+    uint32_t positions_stride;
+    uint32_t normals_stride;
+    uint32_t texcoords_stride;
 } par_octasphere_mesh;
 
 // Computes the maximum possible number of indices and vertices for the given octasphere config.
@@ -82,6 +106,43 @@ void par_octasphere_get_counts(const par_octasphere_config* config, uint32_t* nu
 // Populates a pre-allocated mesh structure with indices and vertices.
 void par_octasphere_populate(const par_octasphere_config* config, par_octasphere_mesh* mesh);
 
+// Populates a pre-allocated mesh by scaling and translating a unit sphere, which must have been
+// populated by the client with the same number of subdivisions and index mode, and with a
+// corner_radius of 1. The unit sphere's index array for that mode must be non-null, and it must
+// have texcoords if the target mesh has texcoords and uses PAR_OCTASPHERE_UV_LATLONG. The unit
+// sphere is never modified, so it can be shared between threads. This skips all trigonometry and
+// is much faster than par_octasphere_populate.
+void par_octasphere_populate_cached(const par_octasphere_mesh* unit_sphere,
+                                    const par_octasphere_config* config,
+                                    par_octasphere_mesh* mesh);
+
+// Rewrites only the positions of a mesh that was populated with the same number of subdivisions,
+// which is useful for animating the dimensions or corner radius of a rounded box. Normals,
+// texcoords, and indices are unaffected, so they can stay resident on the GPU. Positions are
+// derived from a unit sphere as in par_octasphere_populate_cached. Returns false without touching
+// the mesh if its indices cannot represent the new shape, in which case it must be populated
+// again. This happens when growing a sphere into a box or capsule, or when PARO_CONSTANT_TOPOLOGY
+// is disabled.
+bool par_octasphere_update_positions(const par_octasphere_mesh* unit_sphere,
+                                     const par_octasphere_config* config,
+                                     par_octasphere_mesh* mesh);
+
+// Computes where each config of a batch begins within a single packed mesh. Both offset arrays
+// must have room for num_configs + 1 entries, and the final entries are the total counts.
+void par_octasphere_get_batch_offsets(const par_octasphere_config* configs, uint32_t num_configs,
+                                      uint32_t* index_offsets, uint32_t* vertex_offsets);
+
+// Populates a pre-allocated mesh with an entire batch, such that it can be drawn with a single
+// call. Indices are adjusted by the base vertex of their config, and any unused indices at the end
+// of a config's range form degenerate triangles. All configs must have the same indices_mode.
+// The optional unit sphere is used for every config whose subdivision level and index mode it
+// matches, provided that it has any texcoords the config needs, as in
+// par_octasphere_populate_cached. When compiled with OpenMP, configs are populated in parallel.
+void par_octasphere_populate_batch(const par_octasphere_config* configs, uint32_t num_configs,
+                                   const uint32_t* index_offsets, const uint32_t* vertex_offsets,
+                                   const par_octasphere_mesh* unit_sphere,
+                                   par_octasphere_mesh* mesh);
+
 #ifdef __cplusplus
 }
 #endif
@@ -99,33 +160,79 @@ void par_octasphere_populate(const par_octasphere_config* config, par_octasphere
 #define PARO_MIN(a, b) (a > b ? b : a)
 #define PARO_MAX(a, b) (a > b ? a : b)
 #define PARO_CLAMP(v, lo, hi) PARO_MAX(lo, PARO_MIN(hi, v))
-#define PARO_MAX_BOUNDARY_LENGTH ((1 << PAR_OCTASPHERE_MAX_SUBDIVISIONS) + 1)
+#define PARO_MAX_BOUNDARY_LENGTH ((1 << PAR_OCTASPHERE_MAX_SUBDIVISIONS_32) + 1)
 
 #ifndef PARO_CONSTANT_TOPOLOGY
 #define PARO_CONSTANT_TOPOLOGY 1
 #endif
 
-static uint16_t* paro_write_quad(uint16_t* dst, uint16_t a, uint16_t b, uint16_t c, uint16_t d) {
-    *dst++ = a;
-    *dst++ = b;
-    *dst++ = c;
-    *dst++ = c;
-    *dst++ = d;
-    *dst++ = a;
-    return dst;
+#ifdef _OPENMP
+#define PARO_PARALLEL_FOR _Pragma("omp parallel for")
+#else
+#define PARO_PARALLEL_FOR
+#endif
+
+// Destination for triangle indices, exactly one of which is non-null.
+typedef struct {
+    uint16_t* narrow;
+    uint32_t* wide;
+} paro_indices;
+
+static paro_indices paro_get_indices(const par_octasphere_config* config,
+                                     const par_octasphere_mesh* mesh) {
+    paro_indices indices = {0};
+    if (config->indices_mode == PAR_OCTASPHERE_INDICES_32) {
+        indices.wide = mesh->indices32;
+    } else {
+        indices.narrow = mesh->indices;
+    }
+    return indices;
 }
 
-static void paro_write_ui3(uint16_t* dst, int index, uint16_t a, uint16_t b, uint16_t c) {
-    dst[index * 3 + 0] = a;
-    dst[index * 3 + 1] = b;
-    dst[index * 3 + 2] = c;
+static void paro_set_index(paro_indices dst, uint32_t index, uint32_t value) {
+    if (dst.wide) {
+        dst.wide[index] = value;
+    } else {
+        dst.narrow[index] = (uint16_t)value;
+    }
 }
 
-static float* paro_write_f3(float* dst, const float src[3]) {
-    dst[0] = src[0];
-    dst[1] = src[1];
-    dst[2] = src[2];
-    return dst + 3;
+static uint32_t paro_get_index(paro_indices src, uint32_t index) {
+    return src.wide ? src.wide[index] : src.narrow[index];
+}
+
+static uint32_t paro_write_quad(paro_indices dst, uint32_t index, uint32_t a, uint32_t b,
+                                uint32_t c, uint32_t d) {
+    paro_set_index(dst, index++, a);
+    paro_set_index(dst, index++, b);
+    paro_set_index(dst, index++, c);
+    paro_set_index(dst, index++, c);
+    paro_set_index(dst, index++, d);
+    paro_set_index(dst, index++, a);
+    return index;
+}
+
+static void paro_write_ui3(paro_indices dst, int index, uint32_t a, uint32_t b, uint32_t c) {
+    paro_set_index(dst, index * 3 + 0, a);
+    paro_set_index(dst, index * 3 + 1, b);
+    paro_set_index(dst, index * 3 + 2, c);
+}
+
+// Clamps the number of subdivisions according to the index mode.
+static int paro_get_subdivisions(const par_octasphere_config* config) {
+    const int max_subdivisions = config->indices_mode == PAR_OCTASPHERE_INDICES_32
+                                     ? PAR_OCTASPHERE_MAX_SUBDIVISIONS_32
+                                     : PAR_OCTASPHERE_MAX_SUBDIVISIONS;
+    return PARO_CLAMP(config->num_subdivisions, 0, max_subdivisions);
+}
+
+// Returns the address of a vertex attribute within a strided array.
+static float* paro_vertex(const void* base, uint32_t stride, int index) {
+    return (float*)((char*)base + (size_t)stride * index);
+}
+
+static uint32_t paro_stride(uint32_t stride, uint32_t packed_size) {
+    return stride ? stride : packed_size;
 }
 
 static void paro_copy(float dst[3], const float src[3]) {
@@ -213,26 +320,64 @@ static void paro_quat_rotate_vector(float dst[3], const float quat[4], const flo
     paro_add(dst, dst, p);
 }
 
-static float* paro_write_geodesic(float* dst, const float point_a[3], const float point_b[3],
-                                  int num_segments) {
-    dst = paro_write_f3(dst, point_a);
+static int paro_write_geodesic(float* positions, uint32_t stride, int index,
+                               const float point_a[3], const float point_b[3],
+                               int num_segments) {
+    paro_copy(paro_vertex(positions, stride, index++), point_a);
     if (num_segments == 0) {
-        return dst;
+        return index;
     }
     const float angle_between_endpoints = acos(paro_dot(point_a, point_b));
     const float dtheta = angle_between_endpoints / num_segments;
     float rotation_axis[3], quat[4];
     paro_cross(rotation_axis, point_a, point_b);
     paro_normalize(rotation_axis);
-    for (int point_index = 1; point_index < num_segments; point_index++, dst += 3) {
+    for (int point_index = 1; point_index < num_segments; point_index++) {
         paro_quat_from_rotation(quat, rotation_axis, dtheta * point_index);
-        paro_quat_rotate_vector(dst, quat, point_a);
+        paro_quat_rotate_vector(paro_vertex(positions, stride, index++), quat, point_a);
+    }
+    paro_copy(paro_vertex(positions, stride, index++), point_b);
+    return index;
+}
+
+// Encodes a unit vector with an octahedral projection into two snorm16 values.
+static void paro_encode_octahedral(int16_t dst[2], const float n[3]) {
+    const float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = n[0] / l1, y = n[1] / l1;
+    if (n[2] < 0) {
+        const float folded_x = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+        const float folded_y = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = folded_x;
+        y = folded_y;
+    }
+    dst[0] = (int16_t)roundf(PARO_CLAMP(x, -1.0f, 1.0f) * 32767);
+    dst[1] = (int16_t)roundf(PARO_CLAMP(y, -1.0f, 1.0f) * 32767);
+}
+
+// Writes smooth normals in every requested format, which are simply the unit sphere positions.
+static void paro_write_normals(const float* unit_positions, uint32_t unit_stride,
+                               par_octasphere_mesh* mesh, int total_vertices) {
+    const uint32_t normals_stride = paro_stride(mesh->normals_stride, sizeof(float) * 3);
+    const uint32_t octahedral_stride = paro_stride(mesh->normals_stride, sizeof(int16_t) * 2);
+    if (mesh->normals && unit_stride == sizeof(float) * 3 &&
+        normals_stride == sizeof(float) * 3) {
+        memcpy(mesh->normals, unit_positions, sizeof(float) * 3 * total_vertices);
+    } else if (mesh->normals) {
+        for (int i = 0; i < total_vertices; i++) {
+            paro_copy(paro_vertex(mesh->normals, normals_stride, i),
+                      paro_vertex(unit_positions, unit_stride, i));
+        }
+    }
+    if (mesh->octahedral_normals) {
+        for (int i = 0; i < total_vertices; i++) {
+            int16_t* dst = (int16_t*)paro_vertex(mesh->octahedral_normals, octahedral_stride, i);
+            paro_encode_octahedral(dst, paro_vertex(unit_positions, unit_stride, i));
+        }
     }
-    return paro_write_f3(dst, point_b);
 }
 
 void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* mesh) {
-    const int ndivisions = PARO_CLAMP(config->num_subdivisions, 0, PAR_OCTASPHERE_MAX_SUBDIVISIONS);
+    const int ndivisions = paro_get_subdivisions(config);
     const int n = (1 << ndivisions) + 1;
     const int verts_per_patch = n * (n + 1) / 2;
     const float r2 = config->corner_radius * 2;
@@ -242,12 +387,12 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
     const float tx = (w - r2) / 2, ty = (h - r2) / 2, tz = (d - r2) / 2;
 
     // Find the vertex indices along each of the patch's 3 edges.
-    uint16_t boundaries[3][PARO_MAX_BOUNDARY_LENGTH];
-    int a = 0, b = 0, c = 0, row;
-    uint16_t j0 = 0;
+    uint32_t boundaries[3][PARO_MAX_BOUNDARY_LENGTH];
+    int a = 0, b = 0, c = 0, row = 0;
+    uint32_t j0 = 0;
     for (int col_index = 0; col_index < n - 1; col_index++) {
         int col_height = n - 1 - col_index;
-        uint16_t j1 = j0 + 1;
+        uint32_t j1 = j0 + 1;
         boundaries[0][a++] = j0;
         for (row = 0; row < col_height - 1; row++) {
             if (col_height == n - 1) {
@@ -267,8 +412,8 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
     if (!PARO_CONSTANT_TOPOLOGY && config->corner_radius == 0) {
         mesh->num_indices = 0;
     }
-    uint16_t* write_ptr = mesh->indices + mesh->num_indices;
-    const uint16_t* begin_ptr = write_ptr;
+    const paro_indices indices = paro_get_indices(config, mesh);
+    uint32_t write_index = mesh->num_indices;
 
     if (PARO_CONSTANT_TOPOLOGY || config->corner_radius > 0) {
         // Go around the top half.
@@ -276,16 +421,16 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
             if (!PARO_CONSTANT_TOPOLOGY && (patch % 2) == 0 && tz == 0) continue;
             if (!PARO_CONSTANT_TOPOLOGY && (patch % 2) == 1 && tx == 0) continue;
             const int next_patch = (patch + 1) % 4;
-            const uint16_t* boundary_a = boundaries[1];
-            const uint16_t* boundary_b = boundaries[0];
-            const uint16_t offset_a = verts_per_patch * patch;
-            const uint16_t offset_b = verts_per_patch * next_patch;
+            const uint32_t* boundary_a = boundaries[1];
+            const uint32_t* boundary_b = boundaries[0];
+            const uint32_t offset_a = verts_per_patch * patch;
+            const uint32_t offset_b = verts_per_patch * next_patch;
             for (int i = 0; i < n - 1; i++) {
-                const uint16_t a = boundary_a[i] + offset_a;
-                const uint16_t b = boundary_b[i] + offset_b;
-                const uint16_t c = boundary_a[i + 1] + offset_a;
-                const uint16_t d = boundary_b[i + 1] + offset_b;
-                write_ptr = paro_write_quad(write_ptr, a, b, d, c);
+                const uint32_t a = boundary_a[i] + offset_a;
+                const uint32_t b = boundary_b[i] + offset_b;
+                const uint32_t c = boundary_a[i + 1] + offset_a;
+                const uint32_t d = boundary_b[i + 1] + offset_b;
+                write_index = paro_write_quad(indices, write_index, a, b, d, c);
             }
         }
         // Go around the bottom half.
@@ -293,32 +438,32 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
             if (!PARO_CONSTANT_TOPOLOGY && (patch % 2) == 0 && tx == 0) continue;
             if (!PARO_CONSTANT_TOPOLOGY && (patch % 2) == 1 && tz == 0) continue;
             const int next_patch = 4 + (patch + 1) % 4;
-            const uint16_t* boundary_a = boundaries[0];
-            const uint16_t* boundary_b = boundaries[2];
-            const uint16_t offset_a = verts_per_patch * patch;
-            const uint16_t offset_b = verts_per_patch * next_patch;
+            const uint32_t* boundary_a = boundaries[0];
+            const uint32_t* boundary_b = boundaries[2];
+            const uint32_t offset_a = verts_per_patch * patch;
+            const uint32_t offset_b = verts_per_patch * next_patch;
             for (int i = 0; i < n - 1; i++) {
-                const uint16_t a = boundary_a[i] + offset_a;
-                const uint16_t b = boundary_b[i] + offset_b;
-                const uint16_t c = boundary_a[i + 1] + offset_a;
-                const uint16_t d = boundary_b[i + 1] + offset_b;
-                write_ptr = paro_write_quad(write_ptr, d, b, a, c);
+                const uint32_t a = boundary_a[i] + offset_a;
+                const uint32_t b = boundary_b[i] + offset_b;
+                const uint32_t c = boundary_a[i + 1] + offset_a;
+                const uint32_t d = boundary_b[i + 1] + offset_b;
+                write_index = paro_write_quad(indices, write_index, d, b, a, c);
             }
         }
         // Connect the top and bottom halves.
         if (PARO_CONSTANT_TOPOLOGY || ty > 0) {
             for (int patch = 0; patch < 4; patch++) {
                 const int next_patch = 4 + (4 - patch) % 4;
-                const uint16_t* boundary_a = boundaries[2];
-                const uint16_t* boundary_b = boundaries[1];
-                const uint16_t offset_a = verts_per_patch * patch;
-                const uint16_t offset_b = verts_per_patch * next_patch;
+                const uint32_t* boundary_a = boundaries[2];
+                const uint32_t* boundary_b = boundaries[1];
+                const uint32_t offset_a = verts_per_patch * patch;
+                const uint32_t offset_b = verts_per_patch * next_patch;
                 for (int i = 0; i < n - 1; i++) {
-                    const uint16_t a = boundary_a[i] + offset_a;
-                    const uint16_t b = boundary_b[n - 1 - i] + offset_b;
-                    const uint16_t c = boundary_a[i + 1] + offset_a;
-                    const uint16_t d = boundary_b[n - 1 - i - 1] + offset_b;
-                    write_ptr = paro_write_quad(write_ptr, a, b, d, c);
+                    const uint32_t a = boundary_a[i] + offset_a;
+                    const uint32_t b = boundary_b[n - 1 - i] + offset_b;
+                    const uint32_t c = boundary_a[i + 1] + offset_a;
+                    const uint32_t d = boundary_b[n - 1 - i - 1] + offset_b;
+                    write_index = paro_write_quad(indices, write_index, a, b, d, c);
                 }
             }
         }
@@ -326,17 +471,17 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
 
     // Fill in the top and bottom holes.
     if (PARO_CONSTANT_TOPOLOGY || tx > 0 || ty > 0) {
-        uint16_t a, b, c, d;
+        uint32_t a, b, c, d;
         a = boundaries[0][n - 1];
         b = a + verts_per_patch;
         c = b + verts_per_patch;
         d = c + verts_per_patch;
-        write_ptr = paro_write_quad(write_ptr, a, b, c, d);
+        write_index = paro_write_quad(indices, write_index, a, b, c, d);
         a = boundaries[2][0] + verts_per_patch * 4;
         b = a + verts_per_patch;
         c = b + verts_per_patch;
         d = c + verts_per_patch;
-        write_ptr = paro_write_quad(write_ptr, a, b, c, d);
+        write_index = paro_write_quad(indices, write_index, a, b, c, d);
     }
 
     // Fill in the side holes.
@@ -344,10 +489,10 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
         const int sides[4][2] = {{7, 0}, {1, 2}, {3, 4}, {5, 6}};
         for (int side = 0; side < 4; side++) {
             int patch_index, patch, next_patch;
-            uint16_t *boundary_a, *boundary_b;
-            uint16_t offset_a, offset_b;
+            uint32_t *boundary_a, *boundary_b;
+            uint32_t offset_a, offset_b;
 
-            uint16_t a, b;
+            uint32_t a, b;
             patch_index = sides[side][0];
             patch = patch_index / 2;
             next_patch = 4 + (4 - patch) % 4;
@@ -363,7 +508,7 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
                 b = boundary_b[0] + offset_b;
             }
 
-            uint16_t c, d;
+            uint32_t c, d;
             patch_index = sides[side][1];
             patch = patch_index / 2;
             next_patch = 4 + (4 - patch) % 4;
@@ -378,11 +523,11 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
                 c = boundary_a[n - 1] + offset_a;
                 d = boundary_b[0] + offset_b;
             }
-            write_ptr = paro_write_quad(write_ptr, a, b, d, c);
+            write_index = paro_write_quad(indices, write_index, a, b, d, c);
         }
     }
 
-    mesh->num_indices += write_ptr - begin_ptr;
+    mesh->num_indices = write_index;
 
 #ifndef NDEBUG
     uint32_t expected_indices;
@@ -394,7 +539,7 @@ void paro_add_quads(const par_octasphere_config* config, par_octasphere_mesh* me
 
 void par_octasphere_get_counts(const par_octasphere_config* config, uint32_t* num_indices,
                                uint32_t* num_vertices) {
-    const int ndivisions = PARO_CLAMP(config->num_subdivisions, 0, PAR_OCTASPHERE_MAX_SUBDIVISIONS);
+    const int ndivisions = paro_get_subdivisions(config);
     const int n = (1 << ndivisions) + 1;
     const int verts_per_patch = n * (n + 1) / 2;
     const float r2 = config->corner_radius * 2;
@@ -422,8 +567,46 @@ void par_octasphere_get_counts(const par_octasphere_config* config, uint32_t* nu
     *num_vertices = verts_per_patch * 8;
 }
 
+// Scales the eight octants of a unit sphere by the corner radius, then pushes each of them
+// outwards to form a box or capsule. The source and destination may be the same.
+static void paro_transform_octants(const par_octasphere_config* config, const float* src,
+                                   uint32_t src_stride, float* dst, uint32_t dst_stride,
+                                   int verts_per_patch) {
+    const float r = config->corner_radius;
+    const float r2 = r * 2;
+    const float w = PARO_MAX(config->width, r2);
+    const float h = PARO_MAX(config->height, r2);
+    const float d = PARO_MAX(config->depth, r2);
+    const float tx = (w - r2) / 2, ty = (h - r2) / 2, tz = (d - r2) / 2;
+    const bool translated = tx != 0 || ty != 0 || tz != 0;
+    for (int octant = 0; octant < 8; octant++) {
+        const int begin = octant * verts_per_patch, end = begin + verts_per_patch;
+        if (!translated) {
+            for (int i = begin; i < end; i++) {
+                const float* s = paro_vertex(src, src_stride, i);
+                float* t = paro_vertex(dst, dst_stride, i);
+                t[0] = s[0] * r;
+                t[1] = s[1] * r;
+                t[2] = s[2] * r;
+            }
+            continue;
+        }
+        const float sx = (octant < 2 || octant == 4 || octant == 7) ? +1 : -1;
+        const float sy = octant < 4 ? +1 : -1;
+        const float sz = (octant == 0 || octant == 3 || octant == 4 || octant == 5) ? +1 : -1;
+        const float ox = tx * sx, oy = ty * sy, oz = tz * sz;
+        for (int i = begin; i < end; i++) {
+            const float* s = paro_vertex(src, src_stride, i);
+            float* t = paro_vertex(dst, dst_stride, i);
+            t[0] = s[0] * r + ox;
+            t[1] = s[1] * r + oy;
+            t[2] = s[2] * r + oz;
+        }
+    }
+}
+
 void par_octasphere_populate(const par_octasphere_config* config, par_octasphere_mesh* mesh) {
-    const int ndivisions = PARO_CLAMP(config->num_subdivisions, 0, PAR_OCTASPHERE_MAX_SUBDIVISIONS);
+    const int ndivisions = paro_get_subdivisions(config);
     const int n = (1 << ndivisions) + 1;
     const int verts_per_patch = n * (n + 1) / 2;
     const float r2 = config->corner_radius * 2;
@@ -433,18 +616,21 @@ void par_octasphere_populate(const par_octasphere_config* config, par_octasphere
     const float tx = (w - r2) / 2, ty = (h - r2) / 2, tz = (d - r2) / 2;
     const int triangles_per_patch = (n - 2) * (n - 1) + n - 1;
     const int total_vertices = verts_per_patch * 8;
+    const uint32_t positions_stride = paro_stride(mesh->positions_stride, sizeof(float) * 3);
+    const uint32_t texcoords_stride = paro_stride(mesh->texcoords_stride, sizeof(float) * 2);
 
     // START TESSELLATION OF SINGLE PATCH (one-eighth of the octasphere)
-    float* write_ptr = mesh->positions;
+    int write_index = 0;
     for (int i = 0; i < n; i++) {
         const float theta = PARO_PI * 0.5 * i / (n - 1);
         const float point_a[] = {0, sinf(theta), cosf(theta)};
         const float point_b[] = {cosf(theta), sinf(theta), 0};
         const int num_segments = n - 1 - i;
-        write_ptr = paro_write_geodesic(write_ptr, point_a, point_b, num_segments);
+        write_index = paro_write_geodesic(mesh->positions, positions_stride, write_index, point_a,
+                                          point_b, num_segments);
     }
     int f = 0, j0 = 0;
-    uint16_t* faces = mesh->indices;
+    const paro_indices faces = paro_get_indices(config, mesh);
     for (int col_index = 0; col_index < n - 1; col_index++) {
         const int col_height = n - 1 - col_index;
         const int j1 = j0 + 1;
@@ -471,19 +657,18 @@ void par_octasphere_populate(const par_octasphere_config* config, par_octasphere
         paro_scale(euler_angles[octant], PARO_PI * 0.5);
         float quat[4];
         paro_quat_from_eulers(quat, euler_angles[octant]);
-        float* dst = mesh->positions + octant * verts_per_patch * 3;
-        const float* src = mesh->positions;
-        for (int vindex = 0; vindex < verts_per_patch; vindex++, dst += 3, src += 3) {
-            paro_quat_rotate_vector(dst, quat, src);
+        const int dst = octant * verts_per_patch;
+        for (int vindex = 0; vindex < verts_per_patch; vindex++) {
+            paro_quat_rotate_vector(paro_vertex(mesh->positions, positions_stride, dst + vindex),
+                                    quat, paro_vertex(mesh->positions, positions_stride, vindex));
         }
     }
     for (int octant = 1; octant < 8; octant++) {
         const int indices_per_patch = triangles_per_patch * 3;
-        uint16_t* dst = mesh->indices + octant * indices_per_patch;
-        const uint16_t* src = mesh->indices;
-        const uint16_t offset = verts_per_patch * octant;
+        const uint32_t dst = octant * indices_per_patch;
+        const uint32_t offset = verts_per_patch * octant;
         for (int iindex = 0; iindex < indices_per_patch; ++iindex) {
-            dst[iindex] = src[iindex] + offset;
+            paro_set_index(faces, dst + iindex, paro_get_index(faces, iindex) + offset);
         }
     }
     // END 8-WAY CLONE OF PATCH
@@ -492,8 +677,8 @@ void par_octasphere_populate(const par_octasphere_config* config, par_octasphere
         for (int i = 0; i < total_vertices; i++) {
             const int octant = i / verts_per_patch;
             const int relative_index = i % verts_per_patch;
-            float* uv = mesh->texcoords + i * 2;
-            const float* xyz = mesh->positions + i * 3;
+            float* uv = paro_vertex(mesh->texcoords, texcoords_stride, i);
+            const float* xyz = paro_vertex(mesh->positions, positions_stride, i);
             const float x = xyz[0], y = xyz[1], z = xyz[2];
             const float phi = -atan2(z, x);
             const float theta = acos(y);
@@ -517,18 +702,12 @@ void par_octasphere_populate(const par_octasphere_config* config, par_octasphere
         }
     }
 
-    if (mesh->normals && config->normals_mode == PAR_OCTASPHERE_NORMALS_SMOOTH) {
-        memcpy(mesh->normals, mesh->positions, sizeof(float) * 3 * total_vertices);
+    if (config->normals_mode == PAR_OCTASPHERE_NORMALS_SMOOTH) {
+        paro_write_normals(mesh->positions, positions_stride, mesh, total_vertices);
     }
 
-    if (config->corner_radius != 1.0) {
-        for (int i = 0; i < total_vertices; i++) {
-            float* xyz = mesh->positions + i * 3;
-            xyz[0] *= config->corner_radius;
-            xyz[1] *= config->corner_radius;
-            xyz[2] *= config->corner_radius;
-        }
-    }
+    paro_transform_octants(config, mesh->positions, positions_stride, mesh->positions,
+                           positions_stride, verts_per_patch);
 
     mesh->num_indices = triangles_per_patch * 8 * 3;
     mesh->num_vertices = total_vertices;
@@ -537,20 +716,177 @@ void par_octasphere_populate(const par_octasphere_config* config, par_octasphere
         return;
     }
 
-    for (int i = 0; i < total_vertices; i++) {
-        float* xyz = mesh->positions + i * 3;
-        const int octant = i / verts_per_patch;
-        const float sx = (octant < 2 || octant == 4 || octant == 7) ? +1 : -1;
-        const float sy = octant < 4 ? +1 : -1;
-        const float sz = (octant == 0 || octant == 3 || octant == 4 || octant == 5) ? +1 : -1;
-        xyz[0] += tx * sx;
-        xyz[1] += ty * sy;
-        xyz[2] += tz * sz;
+    paro_add_quads(config, mesh);
+}
+
+void par_octasphere_populate_cached(const par_octasphere_mesh* unit_sphere,
+                                    const par_octasphere_config* config,
+                                    par_octasphere_mesh* mesh) {
+    const int ndivisions = paro_get_subdivisions(config);
+    const int n = (1 << ndivisions) + 1;
+    const int verts_per_patch = n * (n + 1) / 2;
+    const float r2 = config->corner_radius * 2;
+    const float w = PARO_MAX(config->width, r2);
+    const float h = PARO_MAX(config->height, r2);
+    const float d = PARO_MAX(config->depth, r2);
+    const float tx = (w - r2) / 2, ty = (h - r2) / 2, tz = (d - r2) / 2;
+    const int triangles_per_patch = (n - 2) * (n - 1) + n - 1;
+    const int total_vertices = verts_per_patch * 8;
+    const uint32_t num_patch_indices = triangles_per_patch * 8 * 3;
+    assert(unit_sphere->num_vertices == (uint32_t)total_vertices);
+    assert(unit_sphere->num_indices == num_patch_indices);
+
+    const paro_indices src = paro_get_indices(config, unit_sphere);
+    const paro_indices dst = paro_get_indices(config, mesh);
+    assert(src.wide || src.narrow);
+    if (dst.wide) {
+        memcpy(dst.wide, src.wide, sizeof(uint32_t) * num_patch_indices);
+    } else {
+        memcpy(dst.narrow, src.narrow, sizeof(uint16_t) * num_patch_indices);
+    }
+
+    const uint32_t unit_positions_stride =
+        paro_stride(unit_sphere->positions_stride, sizeof(float) * 3);
+    const uint32_t unit_texcoords_stride =
+        paro_stride(unit_sphere->texcoords_stride, sizeof(float) * 2);
+    const uint32_t texcoords_stride = paro_stride(mesh->texcoords_stride, sizeof(float) * 2);
+    if (mesh->texcoords && config->uv_mode == PAR_OCTASPHERE_UV_LATLONG) {
+        assert(unit_sphere->texcoords);
+        if (unit_texcoords_stride == sizeof(float) * 2 && texcoords_stride == sizeof(float) * 2) {
+            memcpy(mesh->texcoords, unit_sphere->texcoords, sizeof(float) * 2 * total_vertices);
+        } else {
+            for (int i = 0; i < total_vertices; i++) {
+                float* dst_uv = paro_vertex(mesh->texcoords, texcoords_stride, i);
+                const float* src_uv = paro_vertex(unit_sphere->texcoords, unit_texcoords_stride, i);
+                dst_uv[0] = src_uv[0];
+                dst_uv[1] = src_uv[1];
+            }
+        }
+    }
+
+    if (config->normals_mode == PAR_OCTASPHERE_NORMALS_SMOOTH) {
+        paro_write_normals(unit_sphere->positions, unit_positions_stride, mesh, total_vertices);
+    }
+
+    paro_transform_octants(config, unit_sphere->positions, unit_positions_stride, mesh->positions,
+                           paro_stride(mesh->positions_stride, sizeof(float) * 3),
+                           verts_per_patch);
+
+    mesh->num_indices = num_patch_indices;
+    mesh->num_vertices = total_vertices;
+
+    if (tx == 0 && ty == 0 && tz == 0) {
+        return;
     }
 
     paro_add_quads(config, mesh);
 }
 
+bool par_octasphere_update_positions(const par_octasphere_mesh* unit_sphere,
+                                     const par_octasphere_config* config,
+                                     par_octasphere_mesh* mesh) {
+    const int ndivisions = paro_get_subdivisions(config);
+    const int n = (1 << ndivisions) + 1;
+    const int verts_per_patch = n * (n + 1) / 2;
+    uint32_t num_indices, num_vertices;
+    par_octasphere_get_counts(config, &num_indices, &num_vertices);
+    assert(unit_sphere->num_vertices == num_vertices);
+    assert(mesh->num_vertices == num_vertices);
+    if (!PARO_CONSTANT_TOPOLOGY || mesh->num_indices < num_indices) {
+        return false;
+    }
+    paro_transform_octants(config, unit_sphere->positions,
+                           paro_stride(unit_sphere->positions_stride, sizeof(float) * 3),
+                           mesh->positions, paro_stride(mesh->positions_stride, sizeof(float) * 3),
+                           verts_per_patch);
+    return true;
+}
+
+void par_octasphere_get_batch_offsets(const par_octasphere_config* configs, uint32_t num_configs,
+                                      uint32_t* index_offsets, uint32_t* vertex_offsets) {
+    index_offsets[0] = vertex_offsets[0] = 0;
+    for (uint32_t i = 0; i < num_configs; i++) {
+        uint32_t num_indices, num_vertices;
+        par_octasphere_get_counts(&configs[i], &num_indices, &num_vertices);
+        index_offsets[i + 1] = index_offsets[i] + num_indices;
+        vertex_offsets[i + 1] = vertex_offsets[i] + num_vertices;
+    }
+}
+
+// Checks the requirements of par_octasphere_populate_cached that the vertex count cannot capture.
+static bool paro_can_use_cache(const par_octasphere_mesh* unit_sphere,
+                               const par_octasphere_config* config,
+                               const par_octasphere_mesh* mesh) {
+    const paro_indices src = paro_get_indices(config, unit_sphere);
+    if (!src.wide && !src.narrow) {
+        return false;
+    }
+    return unit_sphere->texcoords || !mesh->texcoords ||
+           config->uv_mode != PAR_OCTASPHERE_UV_LATLONG;
+}
+
+void par_octasphere_populate_batch(const par_octasphere_config* configs, uint32_t num_configs,
+                                   const uint32_t* index_offsets, const uint32_t* vertex_offsets,
+                                   const par_octasphere_mesh* unit_sphere,
+                                   par_octasphere_mesh* mesh) {
+    mesh->num_indices = mesh->num_vertices = 0;
+    if (num_configs == 0) {
+        return;
+    }
+    const paro_indices indices = paro_get_indices(&configs[0], mesh);
+    assert(indices.wide || vertex_offsets[num_configs] <= 65536);
+
+    PARO_PARALLEL_FOR
+    for (int i = 0; i < (int)num_configs; i++) {
+        assert(configs[i].indices_mode == configs[0].indices_mode);
+        const uint32_t base_vertex = vertex_offsets[i];
+        const uint32_t first_index = index_offsets[i];
+        const uint32_t positions_stride = paro_stride(mesh->positions_stride, sizeof(float) * 3);
+        const uint32_t normals_stride = paro_stride(mesh->normals_stride, sizeof(float) * 3);
+        const uint32_t octahedral_stride =
+            paro_stride(mesh->normals_stride, sizeof(int16_t) * 2);
+        const uint32_t texcoords_stride = paro_stride(mesh->texcoords_stride, sizeof(float) * 2);
+        par_octasphere_mesh submesh = {
+            .positions = paro_vertex(mesh->positions, positions_stride, base_vertex),
+            .normals = mesh->normals ? paro_vertex(mesh->normals, normals_stride, base_vertex)
+                                     : NULL,
+            .texcoords = mesh->texcoords
+                             ? paro_vertex(mesh->texcoords, texcoords_stride, base_vertex)
+                             : NULL,
+            .indices = indices.narrow ? indices.narrow + first_index : NULL,
+            .indices32 = indices.wide ? indices.wide + first_index : NULL,
+            .octahedral_normals =
+                mesh->octahedral_normals
+                    ? (int16_t*)paro_vertex(mesh->octahedral_normals, octahedral_stride,
+                                            base_vertex)
+                    : NULL,
+            .positions_stride = positions_stride,
+            .normals_stride = mesh->normals_stride,
+            .texcoords_stride = texcoords_stride,
+        };
+        uint32_t num_unit_indices, num_unit_vertices;
+        par_octasphere_get_counts(&configs[i], &num_unit_indices, &num_unit_vertices);
+        if (unit_sphere && unit_sphere->num_vertices == num_unit_vertices &&
+            paro_can_use_cache(unit_sphere, &configs[i], &submesh)) {
+            par_octasphere_populate_cached(unit_sphere, &configs[i], &submesh);
+        } else {
+            par_octasphere_populate(&configs[i], &submesh);
+        }
+
+        const paro_indices dst = paro_get_indices(&configs[i], &submesh);
+        const uint32_t num_indices = index_offsets[i + 1] - first_index;
+        for (uint32_t j = 0; j < submesh.num_indices; j++) {
+            paro_set_index(dst, j, paro_get_index(dst, j) + base_vertex);
+        }
+        for (uint32_t j = submesh.num_indices; j < num_indices; j++) {
+            paro_set_index(dst, j, base_vertex);
+        }
+    }
+
+    mesh->num_indices = index_offsets[num_configs];
+    mesh->num_vertices = vertex_offsets[num_configs];
+}
+
 #endif  // PAR_OCTASPHERE_IMPLEMENTATION
 #endif  // PAR_OCTASPHERE_H
 
@@ -17,6 +17,12 @@
 // also a flattened list of three-tuples (16-bit uints).  Triangles are always
 // oriented such that their front face winds counter-clockwise.
 //
+// Meshes with more points than a 16-bit index can address store their
+// triangles in "triangles32" instead, and leave "triangles" null.  This is
+// decided at run time on a per-mesh basis, so narrow and wide meshes can be
+// mixed freely.  Merges and generators that would overflow the narrow index
+// type automatically promote the mesh to 32-bit indices.
+//
 // Optionally, meshes can contain 3D normals (one per vertex), and 2D texture
 // coordinates (one per vertex).  That's it!  If you need something fancier,
 // look elsewhere.
@@ -31,6 +37,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 #if !defined(_MSC_VER)
 # include <stdbool.h>
 #else // MSVC
@@ -54,6 +61,7 @@ typedef struct par_shapes_mesh_s {
     int ntriangles;          // Number of triangles
     float* normals;          // Optional list of 3-tuples (X Y Z X Y Z...)
     float* tcoords;          // Optional list of 2-tuples (U V U V U V...)
+    uint32_t* triangles32;   // Replaces "triangles" when indices are 32-bit
 } par_shapes_mesh;
 
 void par_shapes_free_mesh(par_shapes_mesh*);
@@ -99,6 +107,69 @@ typedef void (*par_shapes_fn)(float const*, float*, void*);
 par_shapes_mesh* par_shapes_create_parametric(par_shapes_fn, int slices,
     int stacks, void* userdata);
 
+// Batched flavor of par_shapes_fn that evaluates "count" points at once.  The
+// U and V coordinates arrive in separate arrays, and the callback writes a
+// 3-tuple per point into "xyz".  It may also write unit-length normals and
+// return true, in which case the mesh skips the weld-based normal computation.
+// The return value must be the same for every batch.  Batches hold up to 64
+// points and may span several rows of the UV grid.  They are evaluated
+// concurrently if the library is compiled with OpenMP enabled.
+typedef bool (*par_shapes_batch_fn)(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata);
+par_shapes_mesh* par_shapes_create_parametric_batch(par_shapes_batch_fn,
+    int slices, int stacks, void* userdata);
+
+// Parametric surfaces, platonic solids and disks can also be generated directly
+// into caller-owned memory, such as a mapped GPU buffer, without touching the
+// heap.  First describe the surface with a config and ask for the number of
+// points and triangles.  The Klein bottle needs welded normals and the rock is
+// subdivided and welded, and both need scratch memory, so they are excluded.
+typedef enum {
+    PAR_SHAPES_SURFACE_CYLINDER,
+    PAR_SHAPES_SURFACE_CONE,
+    PAR_SHAPES_SURFACE_TORUS,
+    PAR_SHAPES_SURFACE_SPHERE,
+    PAR_SHAPES_SURFACE_HEMISPHERE,
+    PAR_SHAPES_SURFACE_TREFOIL_KNOT,
+    PAR_SHAPES_SURFACE_PLANE,
+    PAR_SHAPES_SURFACE_CUSTOM,
+    PAR_SHAPES_SURFACE_ICOSAHEDRON,
+    PAR_SHAPES_SURFACE_DODECAHEDRON,
+    PAR_SHAPES_SURFACE_OCTAHEDRON,
+    PAR_SHAPES_SURFACE_TETRAHEDRON,
+    PAR_SHAPES_SURFACE_CUBE,
+    PAR_SHAPES_SURFACE_DISK,
+} par_shapes_surface;
+
+typedef struct {
+    par_shapes_surface surface;
+    int slices;              // Ignored by the platonic solids and the cube
+    int stacks;              // Used by parametric surfaces only
+    float radius;            // Used by the torus, trefoil knot and disk
+    par_shapes_batch_fn fn;  // Used by PAR_SHAPES_SURFACE_CUSTOM
+    void* userdata;          // Used by PAR_SHAPES_SURFACE_CUSTOM
+} par_shapes_config;
+
+// Returns false if the tessellation levels are invalid for the surface.
+// Spheres and hemispheres omit the triangles that collapse at their poles.
+// The platonic solids and the cube always have the same counts.
+bool par_shapes_get_counts(par_shapes_config const*, int* npoints,
+    int* ntriangles);
+
+// Populate a mesh whose arrays are owned by the caller and sized according to
+// par_shapes_get_counts.  The "points" field is required.  The "normals" and
+// "tcoords" fields are optional.  Set either "triangles" or "triangles32" to
+// choose the index width.  The count fields are written by this function.
+// Nothing is allocated, so do not pass the mesh to par_shapes_free_mesh.
+//
+// Returns false if the config is invalid, if "points" or both index arrays are
+// missing, or if the points do not fit into the chosen index width.  Normals
+// are only written if the surface provides analytic normals, which parametric
+// surfaces other than custom ones do.  The disk lies in the XY plane around
+// the origin and faces +Z; it has normals but no texture coordinates.  The
+// platonic solids and the cube have neither.
+bool par_shapes_populate(par_shapes_config const*, par_shapes_mesh* mesh);
+
 // Generate points for a 20-sided polyhedron that fits in the unit sphere.
 // Texture coordinates and normals are not generated.
 par_shapes_mesh* par_shapes_create_icosahedron();
@@ -136,6 +207,32 @@ par_shapes_mesh* par_shapes_create_lsystem(char const* program, int slices,
 // Dump out a text file conforming to the venerable OBJ format.
 void par_shapes_export(par_shapes_mesh const*, char const* objfile);
 
+// Binary formats are much smaller and faster to write than OBJ.  BLOB is a
+// 20-byte header ("PARS", version, npoints, ntriangles, flags) followed by
+// the raw arrays: points, normals, tcoords, and triangles, padded to 4 bytes.
+// Flag bits 0 and 1 indicate normals and tcoords, and bits 8 and up hold the
+// size of an index in bytes.  PLY is binary_little_endian 1.0, and GLB is a
+// self-contained binary glTF 2.0 file.  All formats assume a little-endian
+// host.
+typedef enum {
+    PAR_SHAPES_FORMAT_BLOB,
+    PAR_SHAPES_FORMAT_PLY,
+    PAR_SHAPES_FORMAT_GLB,
+} par_shapes_format;
+
+// Receives the encoded file as a series of contiguous chunks, in order.
+// Return false to abort the export.
+typedef bool (*par_shapes_write_fn)(void const* data, size_t nbytes,
+    void* userdata);
+
+// Stream a mesh to a callback.  Returns false if the callback aborts.
+bool par_shapes_export_binary(par_shapes_mesh const*, par_shapes_format,
+    par_shapes_write_fn, void* userdata);
+
+// Convenience wrapper that writes a binary format to a file.
+bool par_shapes_export_file(par_shapes_mesh const*, par_shapes_format,
+    char const* filename);
+
 // Take a pointer to 6 floats and set them to min xyz, max xyz.
 void par_shapes_compute_aabb(par_shapes_mesh const* mesh, float* aabb);
 
@@ -152,6 +249,30 @@ void par_shapes_rotate(par_shapes_mesh*, float radians, float const* axis);
 void par_shapes_scale(par_shapes_mesh*, float x, float y, float z);
 void par_shapes_merge_and_free(par_shapes_mesh* dst, par_shapes_mesh* src);
 
+// Apply a 4x4 column-major matrix (as in OpenGL) to the points in a single
+// pass.  Normals are transformed by the inverse transpose of the upper 3x3
+// and renormalized, which keeps them correct under non-uniform scale.
+void par_shapes_transform(par_shapes_mesh*, float const* mat4);
+
+// Append "nsrcs" meshes to "dst", each transformed by its own matrix.  The
+// matrices array holds 16 floats per source.  The destination is resized
+// only once, so this is much cheaper than cloning, transforming, and merging
+// each source.
+void par_shapes_merge_transformed(par_shapes_mesh* dst,
+    par_shapes_mesh const* const* srcs, float const* matrices, int nsrcs);
+
+// Append "ninstances" copies of "src" to "dst", each transformed by its own
+// matrix.  If non-null, "point_offsets" and "triangle_offsets" receive the
+// index of the first point and first triangle of each instance within "dst".
+void par_shapes_merge_instances(par_shapes_mesh* dst,
+    par_shapes_mesh const* src, float const* matrices, int ninstances,
+    int* point_offsets, int* triangle_offsets);
+
+// Convert the index buffer to 32-bit integers, which frees "triangles" and
+// populates "triangles32".  Merges do this automatically when the destination
+// would otherwise have more points than PAR_SHAPES_T can address.
+void par_shapes_promote_indices(par_shapes_mesh*);
+
 // Reverse the winding of a run of faces.  Useful when drawing the inside of
 // a Cornell Box.  Pass 0 for nfaces to reverse every face in the mesh.
 void par_shapes_invert(par_shapes_mesh*, int startface, int nfaces);
@@ -168,13 +289,28 @@ void par_shapes_unweld(par_shapes_mesh* mesh, bool create_indices);
 // optimized mesh.  Epsilon is the maximum distance to consider when
 // welding vertices. The mapping argument can be null, or a pointer to
 // npoints integers, which gets filled with the mapping from old vertex
-// indices to new indices.
+// indices to new indices.  The mapping uses the narrow index type, so pass
+// null if the mesh has more points than PAR_SHAPES_T can address.
+//
+// Welding uses a spatial hash sized to epsilon, runs in expected linear time,
+// and is reentrant.  If the library is compiled with OpenMP enabled, the
+// neighbor search is spread across threads.
 par_shapes_mesh* par_shapes_weld(par_shapes_mesh const*, float epsilon,
     PAR_SHAPES_T* mapping);
 
-// Compute smooth normals by averaging adjacent facet normals.
+// Compute smooth normals by averaging adjacent facet normals, weighted by
+// area.  Runs in parallel if the library is compiled with OpenMP enabled.
 void par_shapes_compute_normals(par_shapes_mesh* m);
 
+// Similar to par_shapes_compute_normals, but weights each facet normal by the
+// angle of its corner, which is less sensitive to how a surface is tessellated.
+void par_shapes_compute_angle_weighted_normals(par_shapes_mesh* m);
+
+// Split each triangle into four by inserting a vertex at the midpoint of each
+// edge.  Midpoints are shared between neighboring triangles, so the mesh stays
+// indexed.  Normals and texture coordinates are interpolated if present.
+void par_shapes_subdivide(par_shapes_mesh*);
+
 // Global Config ---------------------------------------------------------------
 
 void par_shapes_set_epsilon_welded_normals(float epsilon);
@@ -217,19 +353,38 @@ void par_shapes__connect(par_shapes_mesh* scene, par_shapes_mesh* cylinder,
 #include <float.h>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
 #include <errno.h>
 
+// When compiled with OpenMP, data-parallel loops are spread across threads.
+#ifdef _OPENMP
+#define PAR_SHAPES__PARALLEL_FOR _Pragma("omp parallel for")
+#else
+#define PAR_SHAPES__PARALLEL_FOR
+#endif
+
 static float par_shapes__epsilon_welded_normals = 0.001;
 static float par_shapes__epsilon_degenerate_sphere = 0.0001;
 
-static void par_shapes__sphere(float const* uv, float* xyz, void*);
-static void par_shapes__hemisphere(float const* uv, float* xyz, void*);
-static void par_shapes__plane(float const* uv, float* xyz, void*);
-static void par_shapes__klein(float const* uv, float* xyz, void*);
-static void par_shapes__cylinder(float const* uv, float* xyz, void*);
-static void par_shapes__cone(float const* uv, float* xyz, void*);
-static void par_shapes__torus(float const* uv, float* xyz, void*);
-static void par_shapes__trefoil(float const* uv, float* xyz, void*);
+static bool par_shapes__sphere(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__hemisphere(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__plane(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__klein(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__cylinder(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__cone(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__torus(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static bool par_shapes__trefoil(float const* u, float const* v, int count,
+    float* xyz, float* normals, void*);
+static par_shapes_mesh* par_shapes__parametric(par_shapes_batch_fn fn,
+    int slices, int stacks, void* userdata, bool poles, bool concurrent,
+    bool normals);
 
 struct osn_context;
 static int par__simplex_noise(int64_t seed, struct osn_context** ctx);
@@ -286,11 +441,15 @@ static void par_shapes__scale3(float* result, float a)
     result[2] *= a;
 }
 
+// Divides rather than multiplying by the reciprocal, which guarantees that
+// axis-aligned vectors come out exactly unit length.
 static void par_shapes__normalize3(float* v)
 {
-    float lsqr = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
-    if (lsqr > 0) {
-        par_shapes__scale3(v, 1.0f / lsqr);
+    float len = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    if (len > 0) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
     }
 }
 
@@ -308,31 +467,165 @@ static void par_shapes__add3(float* result, float const* a)
     result[2] += a[2];
 }
 
-static float par_shapes__sqrdist3(float const* a, float const* b)
+// Returns true if the given number of points cannot be addressed with
+// PAR_SHAPES_T, in which case the mesh needs 32-bit indices.
+static bool par_shapes__needs_wide(int npoints)
+{
+    return sizeof(PAR_SHAPES_T) < sizeof(uint32_t) &&
+        (uint32_t) npoints > (uint32_t) ((PAR_SHAPES_T) -1) + 1u;
+}
+
+static uint32_t par_shapes__get_index(par_shapes_mesh const* m, int i)
+{
+    return m->triangles32 ? m->triangles32[i] : m->triangles[i];
+}
+
+static void par_shapes__set_index(par_shapes_mesh* m, int i, uint32_t value)
+{
+    if (m->triangles32) {
+        m->triangles32[i] = value;
+    } else {
+        m->triangles[i] = (PAR_SHAPES_T) value;
+    }
+}
+
+// Allocates an uninitialized index buffer for "ntriangles" triangles, choosing
+// the index width according to the current number of points.
+static void par_shapes__alloc_triangles(par_shapes_mesh* m)
 {
-    float dx = a[0] - b[0];
-    float dy = a[1] - b[1];
-    float dz = a[2] - b[2];
-    return dx * dx + dy * dy + dz * dz;
+    if (par_shapes__needs_wide(m->npoints)) {
+        m->triangles32 = PAR_MALLOC(uint32_t, 3 * m->ntriangles);
+    } else {
+        m->triangles = PAR_MALLOC(PAR_SHAPES_T, 3 * m->ntriangles);
+    }
+}
+
+static int par_shapes__weld_map(par_shapes_mesh const* mesh, float epsilon,
+    uint32_t* weldmap, uint32_t* reps);
+
+// Fixed-size solids are stored as polygons with the same number of sides,
+// which are split into triangle fans.
+typedef struct {
+    float const* points;
+    PAR_SHAPES_T const* faces;
+    int npoints;
+    int nfaces;
+    int sides;
+} par_shapes__polyhedron;
+
+static bool par_shapes__get_polyhedron(par_shapes_surface surface,
+    par_shapes__polyhedron* poly);
+
+static void par_shapes__populate_disk(float radius, int slices,
+    par_shapes_mesh* mesh);
+
+// Computes normals for "nverts" vertices without a scatter, which allows every
+// stage to run in parallel.  Each triangle corner computes its contribution
+// independently, then a vertex-to-corner table (in CSR form) lets every vertex
+// sum its corners in triangle order.  If "weldmap" is non-null, corners are
+// mapped through it and positions are read from the representative points in
+// "reps".  Triangles that collapse to a line or point are skipped.
+static void par_shapes__gather_normals(par_shapes_mesh const* m,
+    uint32_t const* weldmap, uint32_t const* reps, int nverts,
+    bool angle_weighted, float* normals)
+{
+    const int ntriangles = m->ntriangles;
+    float* corners = PAR_MALLOC(float, 9 * ntriangles);
+    uint32_t* verts = PAR_MALLOC(uint32_t, 3 * ntriangles);
+    PAR_SHAPES__PARALLEL_FOR
+    for (int f = 0; f < ntriangles; f++) {
+        uint32_t* tri = verts + f * 3;
+        float const* p[3];
+        for (int k = 0; k < 3; k++) {
+            uint32_t i = par_shapes__get_index(m, f * 3 + k);
+            tri[k] = weldmap ? weldmap[i] : i;
+            p[k] = m->points + 3 * (reps ? reps[tri[k]] : tri[k]);
+        }
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+            tri[0] = UINT32_MAX;
+            continue;
+        }
+        float* corner = corners + f * 9;
+        float next[3], prev[3], angle[3];
+        for (int k = 0; k < 3; k++) {
+            par_shapes__copy3(next, p[(k + 1) % 3]);
+            par_shapes__subtract3(next, p[k]);
+            par_shapes__copy3(prev, p[(k + 2) % 3]);
+            par_shapes__subtract3(prev, p[k]);
+            par_shapes__cross3(corner + k * 3, next, prev);
+            if (angle_weighted) {
+                float const* cp = corner + k * 3;
+                float sine = sqrtf(par_shapes__dot3(cp, cp));
+                angle[k] = atan2f(sine, par_shapes__dot3(next, prev));
+            }
+        }
+        if (angle_weighted) {
+            float facet[3];
+            par_shapes__copy3(facet, corner);
+            par_shapes__normalize3(facet);
+            for (int k = 0; k < 3; k++) {
+                par_shapes__copy3(corner + k * 3, facet);
+                par_shapes__scale3(corner + k * 3, angle[k]);
+            }
+        }
+    }
+
+    // Counting sort of the corners by vertex.
+    uint32_t* heads = PAR_CALLOC(uint32_t, (nverts + 1));
+    uint32_t* entries = PAR_MALLOC(uint32_t, 3 * ntriangles);
+    for (int f = 0; f < ntriangles; f++) {
+        if (verts[f * 3] != UINT32_MAX) {
+            heads[verts[f * 3 + 0] + 1]++;
+            heads[verts[f * 3 + 1] + 1]++;
+            heads[verts[f * 3 + 2] + 1]++;
+        }
+    }
+    for (int v = 0; v < nverts; v++) {
+        heads[v + 1] += heads[v];
+    }
+    uint32_t* cursor = PAR_MALLOC(uint32_t, nverts);
+    memcpy(cursor, heads, sizeof(uint32_t) * nverts);
+    for (int f = 0; f < ntriangles; f++) {
+        if (verts[f * 3] != UINT32_MAX) {
+            for (int k = 0; k < 3; k++) {
+                entries[cursor[verts[f * 3 + k]]++] = f * 3 + k;
+            }
+        }
+    }
+    PAR_FREE(cursor);
+    PAR_FREE(verts);
+
+    PAR_SHAPES__PARALLEL_FOR
+    for (int v = 0; v < nverts; v++) {
+        float* normal = normals + v * 3;
+        normal[0] = normal[1] = normal[2] = 0;
+        for (uint32_t e = heads[v]; e < heads[v + 1]; e++) {
+            par_shapes__add3(normal, corners + entries[e] * 3);
+        }
+        par_shapes__normalize3(normal);
+    }
+    PAR_FREE(heads);
+    PAR_FREE(entries);
+    PAR_FREE(corners);
 }
 
 void par_shapes__compute_welded_normals(par_shapes_mesh* m)
 {
     const float epsilon = par_shapes__epsilon_welded_normals;
+    PAR_FREE(m->normals);
     m->normals = PAR_MALLOC(float, m->npoints * 3);
-    PAR_SHAPES_T* weldmap = PAR_MALLOC(PAR_SHAPES_T, m->npoints);
-    par_shapes_mesh* welded = par_shapes_weld(m, epsilon, weldmap);
-    par_shapes_compute_normals(welded);
-    float* pdst = m->normals;
-    for (int i = 0; i < m->npoints; i++, pdst += 3) {
-        int d = weldmap[i];
-        float const* pnormal = welded->normals + d * 3;
-        pdst[0] = pnormal[0];
-        pdst[1] = pnormal[1];
-        pdst[2] = pnormal[2];
+    uint32_t* weldmap = PAR_MALLOC(uint32_t, m->npoints);
+    uint32_t* reps = PAR_MALLOC(uint32_t, m->npoints);
+    int nwelded = par_shapes__weld_map(m, epsilon, weldmap, reps);
+    float* welded = PAR_MALLOC(float, 3 * nwelded);
+    par_shapes__gather_normals(m, weldmap, reps, nwelded, false, welded);
+    PAR_SHAPES__PARALLEL_FOR
+    for (int p = 0; p < m->npoints; p++) {
+        par_shapes__copy3(m->normals + p * 3, welded + weldmap[p] * 3);
     }
+    PAR_FREE(welded);
+    PAR_FREE(reps);
     PAR_FREE(weldmap);
-    par_shapes_free_mesh(welded);
 }
 
 par_shapes_mesh* par_shapes_create_cylinder(int slices, int stacks)
@@ -340,7 +633,7 @@ par_shapes_mesh* par_shapes_create_cylinder(int slices, int stacks)
     if (slices < 3 || stacks < 1) {
         return 0;
     }
-    return par_shapes_create_parametric(par_shapes__cylinder, slices,
+    return par_shapes_create_parametric_batch(par_shapes__cylinder, slices,
         stacks, 0);
 }
 
@@ -349,7 +642,7 @@ par_shapes_mesh* par_shapes_create_cone(int slices, int stacks)
     if (slices < 3 || stacks < 1) {
         return 0;
     }
-    return par_shapes_create_parametric(par_shapes__cone, slices,
+    return par_shapes_create_parametric_batch(par_shapes__cone, slices,
         stacks, 0);
 }
 
@@ -367,8 +660,8 @@ par_shapes_mesh* par_shapes_create_parametric_sphere(int slices, int stacks)
     if (slices < 3 || stacks < 3) {
         return 0;
     }
-    par_shapes_mesh* m = par_shapes_create_parametric(par_shapes__sphere,
-        slices, stacks, 0);
+    par_shapes_mesh* m = par_shapes__parametric(par_shapes__sphere, slices,
+        stacks, 0, true, true, true);
     par_shapes_remove_degenerate(m, par_shapes__epsilon_degenerate_sphere);
     return m;
 }
@@ -378,8 +671,8 @@ par_shapes_mesh* par_shapes_create_hemisphere(int slices, int stacks)
     if (slices < 3 || stacks < 3) {
         return 0;
     }
-    par_shapes_mesh* m = par_shapes_create_parametric(par_shapes__hemisphere,
-        slices, stacks, 0);
+    par_shapes_mesh* m = par_shapes__parametric(par_shapes__hemisphere,
+        slices, stacks, 0, true, true, true);
     par_shapes_remove_degenerate(m, par_shapes__epsilon_degenerate_sphere);
     return m;
 }
@@ -392,7 +685,7 @@ par_shapes_mesh* par_shapes_create_torus(int slices, int stacks, float radius)
     assert(radius <= 1.0 && "Use smaller radius to avoid self-intersection.");
     assert(radius >= 0.1 && "Use larger radius to avoid self-intersection.");
     void* userdata = (void*) &radius;
-    return par_shapes_create_parametric(par_shapes__torus, slices,
+    return par_shapes_create_parametric_batch(par_shapes__torus, slices,
         stacks, userdata);
 }
 
@@ -401,8 +694,8 @@ par_shapes_mesh* par_shapes_create_klein_bottle(int slices, int stacks)
     if (slices < 3 || stacks < 3) {
         return 0;
     }
-    par_shapes_mesh* mesh = par_shapes_create_parametric(
-        par_shapes__klein, slices, stacks, 0);
+    par_shapes_mesh* mesh = par_shapes__parametric(par_shapes__klein, slices,
+        stacks, 0, false, true, false);
     int face = 0;
     for (int stack = 0; stack < stacks; stack++) {
         for (int slice = 0; slice < slices; slice++, face += 2) {
@@ -424,7 +717,7 @@ par_shapes_mesh* par_shapes_create_trefoil_knot(int slices, int stacks,
     assert(radius <= 3.0 && "Use smaller radius to avoid self-intersection.");
     assert(radius >= 0.5 && "Use larger radius to avoid self-intersection.");
     void* userdata = (void*) &radius;
-    return par_shapes_create_parametric(par_shapes__trefoil, slices,
+    return par_shapes_create_parametric_batch(par_shapes__trefoil, slices,
         stacks, userdata);
 }
 
@@ -433,70 +726,281 @@ par_shapes_mesh* par_shapes_create_plane(int slices, int stacks)
     if (slices < 1 || stacks < 1) {
         return 0;
     }
-    return par_shapes_create_parametric(par_shapes__plane, slices,
+    return par_shapes_create_parametric_batch(par_shapes__plane, slices,
         stacks, 0);
 }
 
+// Adapts a pointwise par_shapes_fn to the batched interface.
+typedef struct {
+    par_shapes_fn fn;
+    void* userdata;
+} par_shapes__pointwise;
+
+static bool par_shapes__pointwise_batch(float const* u, float const* v,
+    int count, float* xyz, float* normals, void* userdata)
+{
+    par_shapes__pointwise const* pointwise =
+        (par_shapes__pointwise const*) userdata;
+    for (int i = 0; i < count; i++) {
+        float uv[2] = {u[i], v[i]};
+        pointwise->fn(uv, xyz + i * 3, pointwise->userdata);
+    }
+    return false;
+}
+
 par_shapes_mesh* par_shapes_create_parametric(par_shapes_fn fn,
     int slices, int stacks, void* userdata)
 {
-    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
+    par_shapes__pointwise pointwise = {fn, userdata};
+    return par_shapes__parametric(par_shapes__pointwise_batch, slices, stacks,
+        &pointwise, false, false, true);
+}
 
-    // Generate verts.
-    mesh->npoints = (slices + 1) * (stacks + 1);
-    mesh->points = PAR_CALLOC(float, 3 * mesh->npoints);
-    float uv[2];
-    float xyz[3];
-    float* points = mesh->points;
-    for (int stack = 0; stack < stacks + 1; stack++) {
-        uv[0] = (float) stack / stacks;
-        for (int slice = 0; slice < slices + 1; slice++) {
-            uv[1] = (float) slice / slices;
-            fn(uv, xyz, userdata);
-            *points++ = xyz[0];
-            *points++ = xyz[1];
-            *points++ = xyz[2];
+par_shapes_mesh* par_shapes_create_parametric_batch(par_shapes_batch_fn fn,
+    int slices, int stacks, void* userdata)
+{
+    return par_shapes__parametric(fn, slices, stacks, userdata, false, true,
+        true);
+}
+
+// Number of points evaluated per callback.  Batches live on the stack, which
+// keeps the populate path free of heap allocations.
+#define PAR_SHAPES__BATCH_SIZE 64
+
+// Evaluates a run of consecutive grid points starting at "first".
+static bool par_shapes__eval_batch(par_shapes_batch_fn fn, void* userdata,
+    int slices, int stacks, int first, int count, par_shapes_mesh* mesh)
+{
+    float u[PAR_SHAPES__BATCH_SIZE];
+    float v[PAR_SHAPES__BATCH_SIZE];
+    float scratch[PAR_SHAPES__BATCH_SIZE * 3];
+    for (int i = 0; i < count; i++) {
+        int stack = (first + i) / (slices + 1);
+        int slice = (first + i) % (slices + 1);
+        u[i] = (float) stack / stacks;
+        v[i] = (float) slice / slices;
+    }
+    if (mesh->tcoords) {
+        float* uvs = mesh->tcoords + first * 2;
+        for (int i = 0; i < count; i++) {
+            *uvs++ = u[i];
+            *uvs++ = v[i];
         }
     }
-
-    // Generate texture coordinates.
-    mesh->tcoords = PAR_CALLOC(float, 2 * mesh->npoints);
-    float* uvs = mesh->tcoords;
-    for (int stack = 0; stack < stacks + 1; stack++) {
-        uv[0] = (float) stack / stacks;
-        for (int slice = 0; slice < slices + 1; slice++) {
-            uv[1] = (float) slice / slices;
-            *uvs++ = uv[0];
-            *uvs++ = uv[1];
+    float* normals = mesh->normals ? mesh->normals + first * 3 : scratch;
+    return fn(u, v, count, mesh->points + first * 3, normals, userdata);
+}
+
+// Evaluates the callback over the UV grid and generates faces, writing into
+// whatever arrays the mesh provides.  If "poles" is true, the first and last
+// stacks are assumed to collapse to a point, and their degenerate triangles
+// are skipped.  Pointwise callbacks are user code that might not be
+// reentrant, so "concurrent" is false for them.  Returns true if the callback
+// provided normals.
+static bool par_shapes__populate_grid(par_shapes_batch_fn fn, void* userdata,
+    int slices, int stacks, bool poles, bool concurrent, par_shapes_mesh* mesh)
+{
+    // The first batch determines whether normals are analytic.
+    const int npoints = (slices + 1) * (stacks + 1);
+    const int nbatches = (npoints + PAR_SHAPES__BATCH_SIZE - 1) /
+        PAR_SHAPES__BATCH_SIZE;
+    bool analytic = par_shapes__eval_batch(fn, userdata, slices, stacks, 0,
+        PAR_MIN(npoints, PAR_SHAPES__BATCH_SIZE), mesh);
+    if (concurrent) {
+        PAR_SHAPES__PARALLEL_FOR
+        for (int b = 1; b < nbatches; b++) {
+            int first = b * PAR_SHAPES__BATCH_SIZE;
+            int count = PAR_MIN(npoints - first, PAR_SHAPES__BATCH_SIZE);
+            par_shapes__eval_batch(fn, userdata, slices, stacks, first, count,
+                mesh);
+        }
+    } else {
+        for (int b = 1; b < nbatches; b++) {
+            int first = b * PAR_SHAPES__BATCH_SIZE;
+            int count = PAR_MIN(npoints - first, PAR_SHAPES__BATCH_SIZE);
+            par_shapes__eval_batch(fn, userdata, slices, stacks, first, count,
+                mesh);
         }
     }
+    mesh->npoints = npoints;
 
     // Generate faces.
-    mesh->ntriangles = 2 * slices * stacks;
-    mesh->triangles = PAR_CALLOC(PAR_SHAPES_T, 3 * mesh->ntriangles);
-    int v = 0;
-    PAR_SHAPES_T* face = mesh->triangles;
+    int v = 0, f = 0;
     for (int stack = 0; stack < stacks; stack++) {
+        bool north = poles && stack == 0;
+        bool south = poles && stack == stacks - 1;
         for (int slice = 0; slice < slices; slice++) {
             int next = slice + 1;
-            *face++ = v + slice + slices + 1;
-            *face++ = v + next;
-            *face++ = v + slice;
-            *face++ = v + slice + slices + 1;
-            *face++ = v + next + slices + 1;
-            *face++ = v + next;
+            if (!north) {
+                par_shapes__set_index(mesh, f++, v + slice + slices + 1);
+                par_shapes__set_index(mesh, f++, v + next);
+                par_shapes__set_index(mesh, f++, v + slice);
+            }
+            if (!south) {
+                par_shapes__set_index(mesh, f++, v + slice + slices + 1);
+                par_shapes__set_index(mesh, f++, v + next + slices + 1);
+                par_shapes__set_index(mesh, f++, v + next);
+            }
         }
         v += slices + 1;
     }
+    mesh->ntriangles = f / 3;
+    return analytic;
+}
 
-    par_shapes__compute_welded_normals(mesh);
+// Allocates a mesh and populates it.  If the callback does not provide
+// normals and "normals" is false, the caller is responsible for them.
+static par_shapes_mesh* par_shapes__parametric(par_shapes_batch_fn fn,
+    int slices, int stacks, void* userdata, bool poles, bool concurrent,
+    bool normals)
+{
+    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
+    mesh->npoints = (slices + 1) * (stacks + 1);
+    mesh->ntriangles = 2 * slices * (poles ? stacks - 1 : stacks);
+    mesh->points = PAR_MALLOC(float, 3 * mesh->npoints);
+    mesh->normals = PAR_MALLOC(float, 3 * mesh->npoints);
+    mesh->tcoords = PAR_MALLOC(float, 2 * mesh->npoints);
+    par_shapes__alloc_triangles(mesh);
+    bool analytic = par_shapes__populate_grid(fn, userdata, slices, stacks,
+        poles, concurrent, mesh);
+    if (!analytic) {
+        PAR_FREE(mesh->normals);
+        mesh->normals = 0;
+        if (normals) {
+            par_shapes__compute_welded_normals(mesh);
+        }
+    }
     return mesh;
 }
 
+// Finds the callback for a config, or returns false if the config is invalid.
+static bool par_shapes__surface_fn(par_shapes_config const* config,
+    par_shapes_batch_fn* fn, void** userdata, bool* poles)
+{
+    int slices = config->slices;
+    int stacks = config->stacks;
+    *userdata = (void*) &config->radius;
+    *poles = false;
+    switch (config->surface) {
+    case PAR_SHAPES_SURFACE_CYLINDER:
+        *fn = par_shapes__cylinder;
+        return slices >= 3 && stacks >= 1;
+    case PAR_SHAPES_SURFACE_CONE:
+        *fn = par_shapes__cone;
+        return slices >= 3 && stacks >= 1;
+    case PAR_SHAPES_SURFACE_TORUS:
+        *fn = par_shapes__torus;
+        return slices >= 3 && stacks >= 3;
+    case PAR_SHAPES_SURFACE_SPHERE:
+        *fn = par_shapes__sphere;
+        *poles = true;
+        return slices >= 3 && stacks >= 3;
+    case PAR_SHAPES_SURFACE_HEMISPHERE:
+        *fn = par_shapes__hemisphere;
+        *poles = true;
+        return slices >= 3 && stacks >= 3;
+    case PAR_SHAPES_SURFACE_TREFOIL_KNOT:
+        *fn = par_shapes__trefoil;
+        return slices >= 3 && stacks >= 3;
+    case PAR_SHAPES_SURFACE_PLANE:
+        *fn = par_shapes__plane;
+        return slices >= 1 && stacks >= 1;
+    case PAR_SHAPES_SURFACE_CUSTOM:
+        *fn = config->fn;
+        *userdata = config->userdata;
+        return config->fn && slices >= 1 && stacks >= 1;
+    case PAR_SHAPES_SURFACE_ICOSAHEDRON:
+    case PAR_SHAPES_SURFACE_DODECAHEDRON:
+    case PAR_SHAPES_SURFACE_OCTAHEDRON:
+    case PAR_SHAPES_SURFACE_TETRAHEDRON:
+    case PAR_SHAPES_SURFACE_CUBE:
+    case PAR_SHAPES_SURFACE_DISK:
+        break;
+    }
+    return false;
+}
+
+static void par_shapes__populate_polyhedron(par_shapes__polyhedron const* poly,
+    par_shapes_mesh* mesh)
+{
+    memcpy(mesh->points, poly->points, sizeof(float) * 3 * poly->npoints);
+    PAR_SHAPES_T const* face = poly->faces;
+    int f = 0;
+    for (int i = 0; i < poly->nfaces; i++, face += poly->sides) {
+        for (int k = 1; k < poly->sides - 1; k++) {
+            par_shapes__set_index(mesh, f++, face[0]);
+            par_shapes__set_index(mesh, f++, face[k]);
+            par_shapes__set_index(mesh, f++, face[k + 1]);
+        }
+    }
+    mesh->npoints = poly->npoints;
+    mesh->ntriangles = f / 3;
+}
+
+bool par_shapes_get_counts(par_shapes_config const* config, int* npoints,
+    int* ntriangles)
+{
+    par_shapes__polyhedron poly;
+    if (par_shapes__get_polyhedron(config->surface, &poly)) {
+        *npoints = poly.npoints;
+        *ntriangles = poly.nfaces * (poly.sides - 2);
+        return true;
+    }
+    if (config->surface == PAR_SHAPES_SURFACE_DISK && config->slices >= 3) {
+        *npoints = config->slices + 1;
+        *ntriangles = config->slices;
+        return true;
+    }
+    par_shapes_batch_fn fn;
+    void* userdata;
+    bool poles;
+    if (!par_shapes__surface_fn(config, &fn, &userdata, &poles)) {
+        *npoints = *ntriangles = 0;
+        return false;
+    }
+    int slices = config->slices;
+    int stacks = config->stacks;
+    *npoints = (slices + 1) * (stacks + 1);
+    *ntriangles = 2 * slices * (poles ? stacks - 1 : stacks);
+    return true;
+}
+
+bool par_shapes_populate(par_shapes_config const* config,
+    par_shapes_mesh* mesh)
+{
+    int npoints, ntriangles;
+    if (!mesh->points || (!mesh->triangles && !mesh->triangles32) ||
+        !par_shapes_get_counts(config, &npoints, &ntriangles)) {
+        return false;
+    }
+    if (!mesh->triangles32 && par_shapes__needs_wide(npoints)) {
+        return false;
+    }
+    par_shapes__polyhedron poly;
+    if (par_shapes__get_polyhedron(config->surface, &poly)) {
+        par_shapes__populate_polyhedron(&poly, mesh);
+        return true;
+    }
+    if (config->surface == PAR_SHAPES_SURFACE_DISK) {
+        par_shapes__populate_disk(config->radius, config->slices, mesh);
+        return true;
+    }
+    par_shapes_batch_fn fn;
+    void* userdata;
+    bool poles;
+    if (!par_shapes__surface_fn(config, &fn, &userdata, &poles)) {
+        return false;
+    }
+    par_shapes__populate_grid(fn, userdata, config->slices, config->stacks,
+        poles, true, mesh);
+    return true;
+}
+
 void par_shapes_free_mesh(par_shapes_mesh* mesh)
 {
     PAR_FREE(mesh->points);
     PAR_FREE(mesh->triangles);
+    PAR_FREE(mesh->triangles32);
     PAR_FREE(mesh->normals);
     PAR_FREE(mesh->tcoords);
     PAR_FREE(mesh);
@@ -508,7 +1012,7 @@ void par_shapes_export(par_shapes_mesh const* mesh, char const* filename)
     float const* points = mesh->points;
     float const* tcoords = mesh->tcoords;
     float const* norms = mesh->normals;
-    PAR_SHAPES_T const* indices = mesh->triangles;
+    int index = 0;
     if (tcoords && norms) {
         for (int nvert = 0; nvert < mesh->npoints; nvert++) {
             fprintf(objfile, "v %f %f %f\n", points[0], points[1], points[2]);
@@ -519,9 +1023,9 @@ void par_shapes_export(par_shapes_mesh const* mesh, char const* filename)
             tcoords += 2;
         }
         for (int nface = 0; nface < mesh->ntriangles; nface++) {
-            int a = 1 + *indices++;
-            int b = 1 + *indices++;
-            int c = 1 + *indices++;
+            int a = 1 + par_shapes__get_index(mesh, index++);
+            int b = 1 + par_shapes__get_index(mesh, index++);
+            int c = 1 + par_shapes__get_index(mesh, index++);
             fprintf(objfile, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
                 a, a, a, b, b, b, c, c, c);
         }
@@ -533,9 +1037,9 @@ void par_shapes_export(par_shapes_mesh const* mesh, char const* filename)
             norms += 3;
         }
         for (int nface = 0; nface < mesh->ntriangles; nface++) {
-            int a = 1 + *indices++;
-            int b = 1 + *indices++;
-            int c = 1 + *indices++;
+            int a = 1 + par_shapes__get_index(mesh, index++);
+            int b = 1 + par_shapes__get_index(mesh, index++);
+            int c = 1 + par_shapes__get_index(mesh, index++);
             fprintf(objfile, "f %d//%d %d//%d %d//%d\n", a, a, b, b, c, c);
         }
     } else if (tcoords) {
@@ -546,9 +1050,9 @@ void par_shapes_export(par_shapes_mesh const* mesh, char const* filename)
             tcoords += 2;
         }
         for (int nface = 0; nface < mesh->ntriangles; nface++) {
-            int a = 1 + *indices++;
-            int b = 1 + *indices++;
-            int c = 1 + *indices++;
+            int a = 1 + par_shapes__get_index(mesh, index++);
+            int b = 1 + par_shapes__get_index(mesh, index++);
+            int c = 1 + par_shapes__get_index(mesh, index++);
             fprintf(objfile, "f %d/%d %d/%d %d/%d\n", a, a, b, b, c, c);
         }
     } else {
@@ -557,113 +1061,443 @@ void par_shapes_export(par_shapes_mesh const* mesh, char const* filename)
             points += 3;
         }
         for (int nface = 0; nface < mesh->ntriangles; nface++) {
-            int a = 1 + *indices++;
-            int b = 1 + *indices++;
-            int c = 1 + *indices++;
+            int a = 1 + par_shapes__get_index(mesh, index++);
+            int b = 1 + par_shapes__get_index(mesh, index++);
+            int c = 1 + par_shapes__get_index(mesh, index++);
             fprintf(objfile, "f %d %d %d\n", a, b, c);
         }
     }
     fclose(objfile);
 }
 
-static void par_shapes__sphere(float const* uv, float* xyz, void* userdata)
+// Batches small writes into large chunks for the binary exporters.
+typedef struct {
+    par_shapes_write_fn write;
+    void* userdata;
+    bool ok;
+    size_t size;
+    char data[1 << 16];
+} par_shapes__stream;
+
+static void par_shapes__stream_flush(par_shapes__stream* stream)
 {
-    float phi = uv[0] * PAR_PI;
-    float theta = uv[1] * 2 * PAR_PI;
-    xyz[0] = cosf(theta) * sinf(phi);
-    xyz[1] = sinf(theta) * sinf(phi);
-    xyz[2] = cosf(phi);
+    if (stream->ok && stream->size) {
+        stream->ok = stream->write(stream->data, stream->size,
+            stream->userdata);
+    }
+    stream->size = 0;
 }
 
-static void par_shapes__hemisphere(float const* uv, float* xyz, void* userdata)
+static void par_shapes__stream_write(par_shapes__stream* stream,
+    void const* data, size_t nbytes)
 {
-    float phi = uv[0] * PAR_PI;
-    float theta = uv[1] * PAR_PI;
-    xyz[0] = cosf(theta) * sinf(phi);
-    xyz[1] = sinf(theta) * sinf(phi);
-    xyz[2] = cosf(phi);
+    if (stream->size + nbytes > sizeof(stream->data)) {
+        par_shapes__stream_flush(stream);
+    }
+    if (nbytes > sizeof(stream->data)) {
+        if (stream->ok) {
+            stream->ok = stream->write(data, nbytes, stream->userdata);
+        }
+        return;
+    }
+    memcpy(stream->data + stream->size, data, nbytes);
+    stream->size += nbytes;
 }
 
-static void par_shapes__plane(float const* uv, float* xyz, void* userdata)
+static void par_shapes__stream_pad(par_shapes__stream* stream, size_t nbytes,
+    char value)
 {
-    xyz[0] = uv[0];
-    xyz[1] = uv[1];
-    xyz[2] = 0;
+    char padding[4] = {value, value, value, value};
+    par_shapes__stream_write(stream, padding, (4 - nbytes % 4) % 4);
 }
 
-static void par_shapes__klein(float const* uv, float* xyz, void* userdata)
+static size_t par_shapes__index_size(par_shapes_mesh const* mesh)
 {
-    float u = uv[0] * PAR_PI;
-    float v = uv[1] * 2 * PAR_PI;
-    u = u * 2;
-    if (u < PAR_PI) {
-        xyz[0] = 3 * cosf(u) * (1 + sinf(u)) + (2 * (1 - cosf(u) / 2)) *
-            cosf(u) * cosf(v);
-        xyz[2] = -8 * sinf(u) - 2 * (1 - cosf(u) / 2) * sinf(u) * cosf(v);
-    } else {
-        xyz[0] = 3 * cosf(u) * (1 + sinf(u)) + (2 * (1 - cosf(u) / 2)) *
-            cosf(v + PAR_PI);
-        xyz[2] = -8 * sinf(u);
+    return mesh->triangles32 ? sizeof(uint32_t) : sizeof(PAR_SHAPES_T);
+}
+
+static void const* par_shapes__index_data(par_shapes_mesh const* mesh)
+{
+    return mesh->triangles32 ? (void const*) mesh->triangles32 :
+        (void const*) mesh->triangles;
+}
+
+static void par_shapes__export_blob(par_shapes_mesh const* mesh,
+    par_shapes__stream* stream)
+{
+    size_t isize = par_shapes__index_size(mesh);
+    uint32_t header[5] = {
+        0x53524150, // "PARS"
+        1,
+        (uint32_t) mesh->npoints,
+        (uint32_t) mesh->ntriangles,
+        (mesh->normals ? 1u : 0u) | (mesh->tcoords ? 2u : 0u) |
+            (uint32_t) (isize << 8),
+    };
+    par_shapes__stream_write(stream, header, sizeof(header));
+    par_shapes__stream_write(stream, mesh->points,
+        sizeof(float) * 3 * mesh->npoints);
+    if (mesh->normals) {
+        par_shapes__stream_write(stream, mesh->normals,
+            sizeof(float) * 3 * mesh->npoints);
+    }
+    if (mesh->tcoords) {
+        par_shapes__stream_write(stream, mesh->tcoords,
+            sizeof(float) * 2 * mesh->npoints);
+    }
+    size_t nbytes = isize * 3 * mesh->ntriangles;
+    par_shapes__stream_write(stream, par_shapes__index_data(mesh), nbytes);
+    par_shapes__stream_pad(stream, nbytes, 0);
+}
+
+static void par_shapes__export_ply(par_shapes_mesh const* mesh,
+    par_shapes__stream* stream)
+{
+    char header[512];
+    int len = snprintf(header, sizeof(header),
+        "ply\nformat binary_little_endian 1.0\n"
+        "element vertex %d\nproperty float x\nproperty float y\n"
+        "property float z\n%s%s"
+        "element face %d\nproperty list uchar uint vertex_indices\n"
+        "end_header\n", mesh->npoints,
+        mesh->normals ? "property float nx\nproperty float ny\n"
+            "property float nz\n" : "",
+        mesh->tcoords ? "property float s\nproperty float t\n" : "",
+        mesh->ntriangles);
+    par_shapes__stream_write(stream, header, len);
+
+    // Vertex attributes are interleaved through the staging buffer.
+    for (int i = 0; i < mesh->npoints; i++) {
+        float vertex[8];
+        int n = 0;
+        par_shapes__copy3(vertex, mesh->points + i * 3);
+        n += 3;
+        if (mesh->normals) {
+            par_shapes__copy3(vertex + n, mesh->normals + i * 3);
+            n += 3;
+        }
+        if (mesh->tcoords) {
+            vertex[n++] = mesh->tcoords[i * 2 + 0];
+            vertex[n++] = mesh->tcoords[i * 2 + 1];
+        }
+        par_shapes__stream_write(stream, vertex, sizeof(float) * n);
+    }
+    for (int f = 0; f < mesh->ntriangles; f++) {
+        char face[13];
+        uint32_t tri[3] = {
+            par_shapes__get_index(mesh, f * 3 + 0),
+            par_shapes__get_index(mesh, f * 3 + 1),
+            par_shapes__get_index(mesh, f * 3 + 2),
+        };
+        face[0] = 3;
+        memcpy(face + 1, tri, sizeof(tri));
+        par_shapes__stream_write(stream, face, sizeof(face));
+    }
+}
+
+static void par_shapes__export_glb(par_shapes_mesh const* mesh,
+    par_shapes__stream* stream)
+{
+    // Lay out the binary chunk, which holds each attribute in turn.
+    size_t isize = par_shapes__index_size(mesh);
+    size_t vec3size = sizeof(float) * 3 * mesh->npoints;
+    size_t vec2size = sizeof(float) * 2 * mesh->npoints;
+    size_t nsize = mesh->normals ? vec3size : 0;
+    size_t tsize = mesh->tcoords ? vec2size : 0;
+    size_t isizetotal = isize * 3 * mesh->ntriangles;
+    size_t binsize = vec3size + nsize + tsize + isizetotal;
+    size_t binpadded = (binsize + 3) & ~(size_t) 3;
+    int itype = isize == 4 ? 5125 : (isize == 2 ? 5123 : 5121);
+
+    float aabb[6] = {0, 0, 0, 0, 0, 0};
+    if (mesh->npoints) {
+        par_shapes_compute_aabb(mesh, aabb);
+    }
+
+    // Write the JSON chunk by hand, which is simple enough for one mesh.
+    char json[2048];
+    int nattribs = 1;
+    char attribs[128];
+    int alen = snprintf(attribs, sizeof(attribs), "\"POSITION\":0");
+    if (mesh->normals) {
+        alen += snprintf(attribs + alen, sizeof(attribs) - alen,
+            ",\"NORMAL\":%d", nattribs++);
+    }
+    if (mesh->tcoords) {
+        alen += snprintf(attribs + alen, sizeof(attribs) - alen,
+            ",\"TEXCOORD_0\":%d", nattribs++);
+    }
+    char views[512];
+    char accessors[1024];
+    size_t offset = 0;
+    int vlen = snprintf(views, sizeof(views),
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"target\":34962}",
+        vec3size);
+    int clen = snprintf(accessors, sizeof(accessors),
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":%d,"
+        "\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]}",
+        mesh->npoints, aabb[0], aabb[1], aabb[2], aabb[3], aabb[4], aabb[5]);
+    offset += vec3size;
+    int nviews = 1;
+    if (mesh->normals) {
+        vlen += snprintf(views + vlen, sizeof(views) - vlen,
+            ",{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,"
+            "\"target\":34962}", offset, nsize);
+        clen += snprintf(accessors + clen, sizeof(accessors) - clen,
+            ",{\"bufferView\":%d,\"componentType\":5126,\"count\":%d,"
+            "\"type\":\"VEC3\"}", nviews++, mesh->npoints);
+        offset += nsize;
+    }
+    if (mesh->tcoords) {
+        vlen += snprintf(views + vlen, sizeof(views) - vlen,
+            ",{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,"
+            "\"target\":34962}", offset, tsize);
+        clen += snprintf(accessors + clen, sizeof(accessors) - clen,
+            ",{\"bufferView\":%d,\"componentType\":5126,\"count\":%d,"
+            "\"type\":\"VEC2\"}", nviews++, mesh->npoints);
+        offset += tsize;
+    }
+    vlen += snprintf(views + vlen, sizeof(views) - vlen,
+        ",{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,"
+        "\"target\":34963}", offset, isizetotal);
+    clen += snprintf(accessors + clen, sizeof(accessors) - clen,
+        ",{\"bufferView\":%d,\"componentType\":%d,\"count\":%d,"
+        "\"type\":\"SCALAR\"}", nviews, itype, mesh->ntriangles * 3);
+    int jlen = snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"par_shapes\"},"
+        "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{%s},"
+        "\"indices\":%d}]}],\"buffers\":[{\"byteLength\":%zu}],"
+        "\"bufferViews\":[%s],\"accessors\":[%s]}",
+        attribs, nviews, binpadded, views, accessors);
+    size_t jpadded = (jlen + 3) & ~(size_t) 3;
+
+    // Emit the GLB header, the JSON chunk, and the binary chunk.
+    uint32_t header[5] = {
+        0x46546C67, // "glTF"
+        2,
+        (uint32_t) (12 + 8 + jpadded + 8 + binpadded),
+        (uint32_t) jpadded,
+        0x4E4F534A, // "JSON"
+    };
+    par_shapes__stream_write(stream, header, sizeof(header));
+    par_shapes__stream_write(stream, json, jlen);
+    par_shapes__stream_pad(stream, jlen, ' ');
+    uint32_t binheader[2] = {
+        (uint32_t) binpadded,
+        0x004E4942, // "BIN"
+    };
+    par_shapes__stream_write(stream, binheader, sizeof(binheader));
+    par_shapes__stream_write(stream, mesh->points, vec3size);
+    if (mesh->normals) {
+        par_shapes__stream_write(stream, mesh->normals, nsize);
+    }
+    if (mesh->tcoords) {
+        par_shapes__stream_write(stream, mesh->tcoords, tsize);
+    }
+    par_shapes__stream_write(stream, par_shapes__index_data(mesh),
+        isizetotal);
+    par_shapes__stream_pad(stream, binsize, 0);
+}
+
+bool par_shapes_export_binary(par_shapes_mesh const* mesh,
+    par_shapes_format format, par_shapes_write_fn write, void* userdata)
+{
+    par_shapes__stream* stream = PAR_MALLOC(par_shapes__stream, 1);
+    stream->write = write;
+    stream->userdata = userdata;
+    stream->ok = true;
+    stream->size = 0;
+    switch (format) {
+    case PAR_SHAPES_FORMAT_BLOB:
+        par_shapes__export_blob(mesh, stream);
+        break;
+    case PAR_SHAPES_FORMAT_PLY:
+        par_shapes__export_ply(mesh, stream);
+        break;
+    case PAR_SHAPES_FORMAT_GLB:
+        par_shapes__export_glb(mesh, stream);
+        break;
+    }
+    par_shapes__stream_flush(stream);
+    bool ok = stream->ok;
+    PAR_FREE(stream);
+    return ok;
+}
+
+static bool par_shapes__write_file(void const* data, size_t nbytes,
+    void* userdata)
+{
+    return fwrite(data, 1, nbytes, (FILE*) userdata) == nbytes;
+}
+
+bool par_shapes_export_file(par_shapes_mesh const* mesh,
+    par_shapes_format format, char const* filename)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = par_shapes_export_binary(mesh, format, par_shapes__write_file,
+        file);
+    return fclose(file) == 0 && ok;
+}
+
+// The built-in surfaces below are written as simple loops over their batch so
+// that compilers can vectorize them.  All but the Klein bottle provide
+// analytic normals.
+
+static bool par_shapes__sphere(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
+{
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        float phi = u[i] * PAR_PI;
+        float theta = v[i] * 2 * PAR_PI;
+        xyz[0] = cosf(theta) * sinf(phi);
+        xyz[1] = sinf(theta) * sinf(phi);
+        xyz[2] = cosf(phi);
+        par_shapes__copy3(normals, xyz);
+    }
+    return true;
+}
+
+static bool par_shapes__hemisphere(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
+{
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        float phi = u[i] * PAR_PI;
+        float theta = v[i] * PAR_PI;
+        xyz[0] = cosf(theta) * sinf(phi);
+        xyz[1] = sinf(theta) * sinf(phi);
+        xyz[2] = cosf(phi);
+        par_shapes__copy3(normals, xyz);
+    }
+    return true;
+}
+
+static bool par_shapes__plane(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
+{
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        xyz[0] = u[i];
+        xyz[1] = v[i];
+        xyz[2] = 0;
+        normals[0] = 0;
+        normals[1] = 0;
+        normals[2] = 1;
+    }
+    return true;
+}
+
+static bool par_shapes__klein(float const* uu, float const* vv, int count,
+    float* xyz, float* normals, void* userdata)
+{
+    for (int i = 0; i < count; i++, xyz += 3) {
+        float u = uu[i] * PAR_PI;
+        float v = vv[i] * 2 * PAR_PI;
+        u = u * 2;
+        if (u < PAR_PI) {
+            xyz[0] = 3 * cosf(u) * (1 + sinf(u)) + (2 * (1 - cosf(u) / 2)) *
+                cosf(u) * cosf(v);
+            xyz[2] = -8 * sinf(u) - 2 * (1 - cosf(u) / 2) * sinf(u) * cosf(v);
+        } else {
+            xyz[0] = 3 * cosf(u) * (1 + sinf(u)) + (2 * (1 - cosf(u) / 2)) *
+                cosf(v + PAR_PI);
+            xyz[2] = -8 * sinf(u);
+        }
+        xyz[1] = -2 * (1 - cosf(u) / 2) * sinf(v);
     }
-    xyz[1] = -2 * (1 - cosf(u) / 2) * sinf(v);
+    return false;
 }
 
-static void par_shapes__cylinder(float const* uv, float* xyz, void* userdata)
+static bool par_shapes__cylinder(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
 {
-    float theta = uv[1] * 2 * PAR_PI;
-    xyz[0] = sinf(theta);
-    xyz[1] = cosf(theta);
-    xyz[2] = uv[0];
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        float theta = v[i] * 2 * PAR_PI;
+        xyz[0] = sinf(theta);
+        xyz[1] = cosf(theta);
+        xyz[2] = u[i];
+        normals[0] = xyz[0];
+        normals[1] = xyz[1];
+        normals[2] = 0;
+    }
+    return true;
 }
 
-static void par_shapes__cone(float const* uv, float* xyz, void* userdata)
+static bool par_shapes__cone(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
 {
-    float r = 1.0f - uv[0];
-    float theta = uv[1] * 2 * PAR_PI;
-    xyz[0] = r * sinf(theta);
-    xyz[1] = r * cosf(theta);
-    xyz[2] = uv[0];
+    const float k = 1.0f / sqrtf(2.0f);
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        float r = 1.0f - u[i];
+        float theta = v[i] * 2 * PAR_PI;
+        float s = sinf(theta);
+        float c = cosf(theta);
+        xyz[0] = r * s;
+        xyz[1] = r * c;
+        xyz[2] = u[i];
+        normals[0] = k * s;
+        normals[1] = k * c;
+        normals[2] = k;
+    }
+    return true;
 }
 
-static void par_shapes__torus(float const* uv, float* xyz, void* userdata)
+static bool par_shapes__torus(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
 {
     float major = 1;
     float minor = *((float*) userdata);
-    float theta = uv[0] * 2 * PAR_PI;
-    float phi = uv[1] * 2 * PAR_PI;
-    float beta = major + minor * cosf(phi);
-    xyz[0] = cosf(theta) * beta;
-    xyz[1] = sinf(theta) * beta;
-    xyz[2] = sinf(phi) * minor;
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        float theta = u[i] * 2 * PAR_PI;
+        float phi = v[i] * 2 * PAR_PI;
+        float beta = major + minor * cosf(phi);
+        xyz[0] = cosf(theta) * beta;
+        xyz[1] = sinf(theta) * beta;
+        xyz[2] = sinf(phi) * minor;
+        normals[0] = cosf(theta) * cosf(phi);
+        normals[1] = sinf(theta) * cosf(phi);
+        normals[2] = sinf(phi);
+    }
+    return true;
 }
 
-static void par_shapes__trefoil(float const* uv, float* xyz, void* userdata)
+static bool par_shapes__trefoil(float const* uu, float const* vv, int count,
+    float* xyz, float* normals, void* userdata)
 {
     float minor = *((float*) userdata);
     const float a = 0.5f;
     const float b = 0.3f;
     const float c = 0.5f;
     const float d = minor * 0.1f;
-    const float u = (1 - uv[0]) * 4 * PAR_PI;
-    const float v = uv[1] * 2 * PAR_PI;
-    const float r = a + b * cos(1.5f * u);
-    const float x = r * cos(u);
-    const float y = r * sin(u);
-    const float z = c * sin(1.5f * u);
-    float q[3];
-    q[0] =
-        -1.5f * b * sin(1.5f * u) * cos(u) - (a + b * cos(1.5f * u)) * sin(u);
-    q[1] =
-        -1.5f * b * sin(1.5f * u) * sin(u) + (a + b * cos(1.5f * u)) * cos(u);
-    q[2] = 1.5f * c * cos(1.5f * u);
-    par_shapes__normalize3(q);
-    float qvn[3] = {q[1], -q[0], 0};
-    par_shapes__normalize3(qvn);
-    float ww[3];
-    par_shapes__cross3(ww, q, qvn);
-    xyz[0] = x + d * (qvn[0] * cos(v) + ww[0] * sin(v));
-    xyz[1] = y + d * (qvn[1] * cos(v) + ww[1] * sin(v));
-    xyz[2] = z + d * ww[2] * sin(v);
+    for (int i = 0; i < count; i++, xyz += 3, normals += 3) {
+        const float u = (1 - uu[i]) * 4 * PAR_PI;
+        const float v = vv[i] * 2 * PAR_PI;
+        const float r = a + b * cos(1.5f * u);
+        const float x = r * cos(u);
+        const float y = r * sin(u);
+        const float z = c * sin(1.5f * u);
+        float q[3];
+        q[0] = -1.5f * b * sin(1.5f * u) * cos(u) -
+            (a + b * cos(1.5f * u)) * sin(u);
+        q[1] = -1.5f * b * sin(1.5f * u) * sin(u) +
+            (a + b * cos(1.5f * u)) * cos(u);
+        q[2] = 1.5f * c * cos(1.5f * u);
+        par_shapes__normalize3(q);
+        float qvn[3] = {q[1], -q[0], 0};
+        par_shapes__normalize3(qvn);
+        float ww[3];
+        par_shapes__cross3(ww, q, qvn);
+        normals[0] = qvn[0] * cos(v) + ww[0] * sin(v);
+        normals[1] = qvn[1] * cos(v) + ww[1] * sin(v);
+        normals[2] = ww[2] * sin(v);
+        xyz[0] = x + d * normals[0];
+        xyz[1] = y + d * normals[1];
+        xyz[2] = z + d * normals[2];
+        par_shapes__normalize3(normals);
+    }
+    return true;
 }
 
 void par_shapes_set_epsilon_welded_normals(float epsilon) {
@@ -674,10 +1508,26 @@ void par_shapes_set_epsilon_degenerate_sphere(float epsilon) {
     par_shapes__epsilon_degenerate_sphere = epsilon;
 }
 
+void par_shapes_promote_indices(par_shapes_mesh* m)
+{
+    if (m->triangles32) {
+        return;
+    }
+    m->triangles32 = PAR_MALLOC(uint32_t, 3 * m->ntriangles);
+    for (int i = 0; i < m->ntriangles * 3; i++) {
+        m->triangles32[i] = m->triangles[i];
+    }
+    PAR_FREE(m->triangles);
+    m->triangles = 0;
+}
+
 void par_shapes_merge(par_shapes_mesh* dst, par_shapes_mesh const* src)
 {
-    PAR_SHAPES_T offset = dst->npoints;
+    uint32_t offset = dst->npoints;
     int npoints = dst->npoints + src->npoints;
+    if (src->triangles32 || par_shapes__needs_wide(npoints)) {
+        par_shapes_promote_indices(dst);
+    }
     int vecsize = sizeof(float) * 3;
     dst->points = PAR_REALLOC(float, dst->points, 3 * npoints);
     memcpy(dst->points + 3 * dst->npoints, src->points, vecsize * src->npoints);
@@ -698,23 +1548,34 @@ void par_shapes_merge(par_shapes_mesh* dst, par_shapes_mesh const* src)
         }
     }
     int ntriangles = dst->ntriangles + src->ntriangles;
-    dst->triangles = PAR_REALLOC(PAR_SHAPES_T, dst->triangles, 3 * ntriangles);
-    PAR_SHAPES_T* ptriangles = dst->triangles + 3 * dst->ntriangles;
-    PAR_SHAPES_T const* striangles = src->triangles;
-    for (int i = 0; i < src->ntriangles; i++) {
-        *ptriangles++ = offset + *striangles++;
-        *ptriangles++ = offset + *striangles++;
-        *ptriangles++ = offset + *striangles++;
+    if (dst->triangles32) {
+        dst->triangles32 = PAR_REALLOC(uint32_t, dst->triangles32,
+            3 * ntriangles);
+        uint32_t* ptriangles = dst->triangles32 + 3 * dst->ntriangles;
+        for (int i = 0; i < src->ntriangles * 3; i++) {
+            *ptriangles++ = offset + par_shapes__get_index(src, i);
+        }
+    } else {
+        dst->triangles = PAR_REALLOC(PAR_SHAPES_T, dst->triangles,
+            3 * ntriangles);
+        PAR_SHAPES_T* ptriangles = dst->triangles + 3 * dst->ntriangles;
+        PAR_SHAPES_T const* striangles = src->triangles;
+        for (int i = 0; i < src->ntriangles; i++) {
+            *ptriangles++ = offset + *striangles++;
+            *ptriangles++ = offset + *striangles++;
+            *ptriangles++ = offset + *striangles++;
+        }
     }
     dst->ntriangles = ntriangles;
 }
 
-par_shapes_mesh* par_shapes_create_disk(float radius, int slices,
-    float const* center, float const* normal)
+// Generates a disk in the XY plane that faces +Z.  Normals are written only if
+// the mesh has room for them.
+static void par_shapes__populate_disk(float radius, int slices,
+    par_shapes_mesh* mesh)
 {
-    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
     mesh->npoints = slices + 1;
-    mesh->points = PAR_MALLOC(float, 3 * mesh->npoints);
+    mesh->ntriangles = slices;
     float* points = mesh->points;
     *points++ = 0;
     *points++ = 0;
@@ -725,6 +1586,30 @@ par_shapes_mesh* par_shapes_create_disk(float radius, int slices,
         *points++ = radius * sin(theta);
         *points++ = 0;
     }
+    if (mesh->normals) {
+        float* norms = mesh->normals;
+        for (int i = 0; i < mesh->npoints; i++) {
+            *norms++ = 0;
+            *norms++ = 0;
+            *norms++ = 1;
+        }
+    }
+    for (int i = 0; i < slices; i++) {
+        par_shapes__set_index(mesh, i * 3 + 0, 0);
+        par_shapes__set_index(mesh, i * 3 + 1, 1 + i);
+        par_shapes__set_index(mesh, i * 3 + 2, 1 + (i + 1) % slices);
+    }
+}
+
+par_shapes_mesh* par_shapes_create_disk(float radius, int slices,
+    float const* center, float const* normal)
+{
+    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
+    mesh->npoints = slices + 1;
+    mesh->ntriangles = slices;
+    mesh->points = PAR_MALLOC(float, 3 * mesh->npoints);
+    par_shapes__alloc_triangles(mesh);
+    par_shapes__populate_disk(radius, slices, mesh);
     float nnormal[3] = {normal[0], normal[1], normal[2]};
     par_shapes__normalize3(nnormal);
     mesh->normals = PAR_MALLOC(float, 3 * mesh->npoints);
@@ -734,14 +1619,6 @@ par_shapes_mesh* par_shapes_create_disk(float radius, int slices,
         *norms++ = nnormal[1];
         *norms++ = nnormal[2];
     }
-    mesh->ntriangles = slices;
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, 3 * mesh->ntriangles);
-    PAR_SHAPES_T* triangles = mesh->triangles;
-    for (int i = 0; i < slices; i++) {
-        *triangles++ = 0;
-        *triangles++ = 1 + i;
-        *triangles++ = 1 + (i + 1) % slices;
-    }
     float k[3] = {0, 0, -1};
     float axis[3];
     par_shapes__cross3(axis, nnormal, k);
@@ -766,7 +1643,9 @@ void par_shapes_translate(par_shapes_mesh* m, float x, float y, float z)
     }
 }
 
-void par_shapes_rotate(par_shapes_mesh* mesh, float radians, float const* axis)
+// Builds the three columns of a matrix that rotates about a unit axis.
+static void par_shapes__rotation3(float* cols, float radians,
+    float const* axis)
 {
     float s = sinf(radians);
     float c = cosf(radians);
@@ -777,20 +1656,23 @@ void par_shapes_rotate(par_shapes_mesh* mesh, float radians, float const* axis)
     float yz = y * z;
     float zx = z * x;
     float oneMinusC = 1.0f - c;
-    float col0[3] = {
-        (((x * x) * oneMinusC) + c),
-        ((xy * oneMinusC) + (z * s)), ((zx * oneMinusC) - (y * s))
-    };
-    float col1[3] = {
-        ((xy * oneMinusC) - (z * s)),
-        (((y * y) * oneMinusC) + c), ((yz * oneMinusC) + (x * s))
-    };
-    float col2[3] = {
-        ((zx * oneMinusC) + (y * s)),
-        ((yz * oneMinusC) - (x * s)), (((z * z) * oneMinusC) + c)
-    };
-    float* p = mesh->points;
-    for (int i = 0; i < mesh->npoints; i++, p += 3) {
+    cols[0] = (((x * x) * oneMinusC) + c);
+    cols[1] = ((xy * oneMinusC) + (z * s));
+    cols[2] = ((zx * oneMinusC) - (y * s));
+    cols[3] = ((xy * oneMinusC) - (z * s));
+    cols[4] = (((y * y) * oneMinusC) + c);
+    cols[5] = ((yz * oneMinusC) + (x * s));
+    cols[6] = ((zx * oneMinusC) + (y * s));
+    cols[7] = ((yz * oneMinusC) - (x * s));
+    cols[8] = (((z * z) * oneMinusC) + c);
+}
+
+static void par_shapes__rotate3(float* p, int n, float const* cols)
+{
+    float const* col0 = cols + 0;
+    float const* col1 = cols + 3;
+    float const* col2 = cols + 6;
+    for (int i = 0; i < n; i++, p += 3) {
         float x = col0[0] * p[0] + col1[0] * p[1] + col2[0] * p[2];
         float y = col0[1] * p[0] + col1[1] * p[1] + col2[1] * p[2];
         float z = col0[2] * p[0] + col1[2] * p[1] + col2[2] * p[2];
@@ -798,16 +1680,15 @@ void par_shapes_rotate(par_shapes_mesh* mesh, float radians, float const* axis)
         p[1] = y;
         p[2] = z;
     }
-    float* n = mesh->normals;
-    if (n) {
-        for (int i = 0; i < mesh->npoints; i++, n += 3) {
-            float x = col0[0] * n[0] + col1[0] * n[1] + col2[0] * n[2];
-            float y = col0[1] * n[0] + col1[1] * n[1] + col2[1] * n[2];
-            float z = col0[2] * n[0] + col1[2] * n[1] + col2[2] * n[2];
-            n[0] = x;
-            n[1] = y;
-            n[2] = z;
-        }
+}
+
+void par_shapes_rotate(par_shapes_mesh* mesh, float radians, float const* axis)
+{
+    float cols[9];
+    par_shapes__rotation3(cols, radians, axis);
+    par_shapes__rotate3(mesh->points, mesh->npoints, cols);
+    if (mesh->normals) {
+        par_shapes__rotate3(mesh->normals, mesh->npoints, cols);
     }
 }
 
@@ -848,6 +1729,167 @@ void par_shapes_merge_and_free(par_shapes_mesh* dst, par_shapes_mesh* src)
     par_shapes_free_mesh(src);
 }
 
+// Compute a 3x3 normal matrix from the upper-left 3x3 of a column-major 4x4.
+// The columns of the cofactor matrix are cross products of the source columns,
+// which equals the inverse transpose up to a scale factor.  Unlike the true
+// inverse, this still produces sensible normals for a degenerate scale.
+static void par_shapes__normal_matrix(float* nmat, float const* mat)
+{
+    float const* c0 = mat + 0;
+    float const* c1 = mat + 4;
+    float const* c2 = mat + 8;
+    par_shapes__cross3(nmat + 0, c1, c2);
+    par_shapes__cross3(nmat + 3, c2, c0);
+    par_shapes__cross3(nmat + 6, c0, c1);
+    float det = par_shapes__dot3(c0, nmat + 0);
+    if (det < 0) {
+        for (int i = 0; i < 9; i++) {
+            nmat[i] = -nmat[i];
+        }
+    }
+}
+
+// Transform a run of points and normals.  Source and destination may alias.
+static void par_shapes__transform_range(float* dpoints, float* dnormals,
+    float const* spoints, float const* snormals, int npoints,
+    float const* mat, float const* nmat)
+{
+    for (int i = 0; i < npoints; i++) {
+        float x = spoints[i * 3 + 0];
+        float y = spoints[i * 3 + 1];
+        float z = spoints[i * 3 + 2];
+        dpoints[i * 3 + 0] = mat[0] * x + mat[4] * y + mat[8] * z + mat[12];
+        dpoints[i * 3 + 1] = mat[1] * x + mat[5] * y + mat[9] * z + mat[13];
+        dpoints[i * 3 + 2] = mat[2] * x + mat[6] * y + mat[10] * z + mat[14];
+    }
+    if (!dnormals || !snormals) {
+        return;
+    }
+    for (int i = 0; i < npoints; i++) {
+        float x = snormals[i * 3 + 0];
+        float y = snormals[i * 3 + 1];
+        float z = snormals[i * 3 + 2];
+        float* n = dnormals + i * 3;
+        n[0] = nmat[0] * x + nmat[3] * y + nmat[6] * z;
+        n[1] = nmat[1] * x + nmat[4] * y + nmat[7] * z;
+        n[2] = nmat[2] * x + nmat[5] * y + nmat[8] * z;
+        par_shapes__normalize3(n);
+    }
+}
+
+void par_shapes_transform(par_shapes_mesh* mesh, float const* mat4)
+{
+    float nmat[9];
+    par_shapes__normal_matrix(nmat, mat4);
+    par_shapes__transform_range(mesh->points, mesh->normals, mesh->points,
+        mesh->normals, mesh->npoints, mat4, nmat);
+}
+
+// Shared implementation of the batched merges.  The source for item "s" is
+// srcs[s * srcstride], so a stride of zero repeats a single instanced mesh.
+static void par_shapes__merge_transformed(par_shapes_mesh* dst,
+    par_shapes_mesh const* const* srcs, int srcstride, float const* matrices,
+    int nsrcs, int* point_offsets, int* triangle_offsets)
+{
+    // Compute the final size and the first point and face of each source.
+    int* offsets = PAR_MALLOC(int, 2 * nsrcs);
+    int npoints = dst->npoints;
+    int ntriangles = dst->ntriangles;
+    bool normals = dst->normals != 0;
+    bool tcoords = dst->tcoords != 0;
+    bool wide = dst->triangles32 != 0;
+    for (int s = 0; s < nsrcs; s++) {
+        par_shapes_mesh const* src = srcs[s * srcstride];
+        offsets[s * 2 + 0] = npoints;
+        offsets[s * 2 + 1] = ntriangles;
+        if (point_offsets) {
+            point_offsets[s] = npoints;
+        }
+        if (triangle_offsets) {
+            triangle_offsets[s] = ntriangles;
+        }
+        npoints += src->npoints;
+        ntriangles += src->ntriangles;
+        normals = normals || src->normals;
+        tcoords = tcoords || src->tcoords;
+        wide = wide || src->triangles32;
+    }
+    if (wide || par_shapes__needs_wide(npoints)) {
+        par_shapes_promote_indices(dst);
+    }
+
+    // Grow each array exactly once, zeroing attributes that dst lacked.
+    dst->points = PAR_REALLOC(float, dst->points, 3 * npoints);
+    if (normals) {
+        if (!dst->normals) {
+            dst->normals = PAR_CALLOC(float, 3 * npoints);
+        } else {
+            dst->normals = PAR_REALLOC(float, dst->normals, 3 * npoints);
+        }
+    }
+    if (tcoords) {
+        if (!dst->tcoords) {
+            dst->tcoords = PAR_CALLOC(float, 2 * npoints);
+        } else {
+            dst->tcoords = PAR_REALLOC(float, dst->tcoords, 2 * npoints);
+        }
+    }
+    if (dst->triangles32) {
+        dst->triangles32 = PAR_REALLOC(uint32_t, dst->triangles32,
+            3 * ntriangles);
+    } else {
+        dst->triangles = PAR_REALLOC(PAR_SHAPES_T, dst->triangles,
+            3 * ntriangles);
+    }
+    dst->npoints = npoints;
+    dst->ntriangles = ntriangles;
+
+    // Each source writes to a disjoint range, so they can run concurrently.
+    PAR_SHAPES__PARALLEL_FOR
+    for (int s = 0; s < nsrcs; s++) {
+        par_shapes_mesh const* src = srcs[s * srcstride];
+        int pt = offsets[s * 2 + 0];
+        int tri = offsets[s * 2 + 1];
+        float const* mat = matrices + s * 16;
+        float nmat[9];
+        par_shapes__normal_matrix(nmat, mat);
+        float* dnormals = dst->normals ? dst->normals + pt * 3 : 0;
+        par_shapes__transform_range(dst->points + pt * 3, dnormals,
+            src->points, src->normals, src->npoints, mat, nmat);
+        if (dnormals && !src->normals) {
+            memset(dnormals, 0, sizeof(float) * 3 * src->npoints);
+        }
+        if (dst->tcoords) {
+            float* dtcoords = dst->tcoords + pt * 2;
+            if (src->tcoords) {
+                memcpy(dtcoords, src->tcoords,
+                    sizeof(float) * 2 * src->npoints);
+            } else {
+                memset(dtcoords, 0, sizeof(float) * 2 * src->npoints);
+            }
+        }
+        for (int i = 0; i < src->ntriangles * 3; i++) {
+            par_shapes__set_index(dst, tri * 3 + i,
+                pt + par_shapes__get_index(src, i));
+        }
+    }
+    PAR_FREE(offsets);
+}
+
+void par_shapes_merge_transformed(par_shapes_mesh* dst,
+    par_shapes_mesh const* const* srcs, float const* matrices, int nsrcs)
+{
+    par_shapes__merge_transformed(dst, srcs, 1, matrices, nsrcs, 0, 0);
+}
+
+void par_shapes_merge_instances(par_shapes_mesh* dst,
+    par_shapes_mesh const* src, float const* matrices, int ninstances,
+    int* point_offsets, int* triangle_offsets)
+{
+    par_shapes__merge_transformed(dst, &src, 0, matrices, ninstances,
+        point_offsets, triangle_offsets);
+}
+
 void par_shapes_compute_aabb(par_shapes_mesh const* m, float* aabb)
 {
     float* points = m->points;
@@ -868,6 +1910,14 @@ void par_shapes_compute_aabb(par_shapes_mesh const* m, float* aabb)
 void par_shapes_invert(par_shapes_mesh* m, int face, int nfaces)
 {
     nfaces = nfaces ? nfaces : m->ntriangles;
+    if (m->triangles32) {
+        uint32_t* tri = m->triangles32 + face * 3;
+        for (int i = 0; i < nfaces; i++) {
+            PAR_SWAP(uint32_t, tri[0], tri[2]);
+            tri += 3;
+        }
+        return;
+    }
     PAR_SHAPES_T* tri = m->triangles + face * 3;
     for (int i = 0; i < nfaces; i++) {
         PAR_SWAP(PAR_SHAPES_T, tri[0], tri[2]);
@@ -875,302 +1925,208 @@ void par_shapes_invert(par_shapes_mesh* m, int face, int nfaces)
     }
 }
 
-par_shapes_mesh* par_shapes_create_icosahedron()
-{
-    static float verts[] = {
-        0.000,  0.000,  1.000,
-        0.894,  0.000,  0.447,
-        0.276,  0.851,  0.447,
-        -0.724,  0.526,  0.447,
-        -0.724, -0.526,  0.447,
-        0.276, -0.851,  0.447,
-        0.724,  0.526, -0.447,
-        -0.276,  0.851, -0.447,
-        -0.894,  0.000, -0.447,
-        -0.276, -0.851, -0.447,
-        0.724, -0.526, -0.447,
-        0.000,  0.000, -1.000
-    };
-    static PAR_SHAPES_T faces[] = {
-        0,1,2,
-        0,2,3,
-        0,3,4,
-        0,4,5,
-        0,5,1,
-        7,6,11,
-        8,7,11,
-        9,8,11,
-        10,9,11,
-        6,10,11,
-        6,2,1,
-        7,3,2,
-        8,4,3,
-        9,5,4,
-        10,1,5,
-        6,7,2,
-        7,8,3,
-        8,9,4,
-        9,10,5,
-        10,6,1
-    };
-    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
-    mesh->npoints = sizeof(verts) / sizeof(verts[0]) / 3;
-    mesh->points = PAR_MALLOC(float, sizeof(verts) / 4);
-    memcpy(mesh->points, verts, sizeof(verts));
-    mesh->ntriangles = sizeof(faces) / sizeof(faces[0]) / 3;
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, sizeof(faces) / 2);
-    memcpy(mesh->triangles, faces, sizeof(faces));
-    return mesh;
-}
+// Vertices and faces of the fixed-size solids.  The dodecahedron is made of
+// pentagons and the cube of quads; every other solid is made of triangles.
+static float const par_shapes__icosahedron_points[] = {
+    0.000,  0.000,  1.000,
+    0.894,  0.000,  0.447,
+    0.276,  0.851,  0.447,
+    -0.724,  0.526,  0.447,
+    -0.724, -0.526,  0.447,
+    0.276, -0.851,  0.447,
+    0.724,  0.526, -0.447,
+    -0.276,  0.851, -0.447,
+    -0.894,  0.000, -0.447,
+    -0.276, -0.851, -0.447,
+    0.724, -0.526, -0.447,
+    0.000,  0.000, -1.000
+};
 
-par_shapes_mesh* par_shapes_create_dodecahedron()
-{
-    static float verts[20 * 3] = {
-        0.607, 0.000, 0.795,
-        0.188, 0.577, 0.795,
-        -0.491, 0.357, 0.795,
-        -0.491, -0.357, 0.795,
-        0.188, -0.577, 0.795,
-        0.982, 0.000, 0.188,
-        0.304, 0.934, 0.188,
-        -0.795, 0.577, 0.188,
-        -0.795, -0.577, 0.188,
-        0.304, -0.934, 0.188,
-        0.795, 0.577, -0.188,
-        -0.304, 0.934, -0.188,
-        -0.982, 0.000, -0.188,
-        -0.304, -0.934, -0.188,
-        0.795, -0.577, -0.188,
-        0.491, 0.357, -0.795,
-        -0.188, 0.577, -0.795,
-        -0.607, 0.000, -0.795,
-        -0.188, -0.577, -0.795,
-        0.491, -0.357, -0.795,
-    };
-    static PAR_SHAPES_T pentagons[12 * 5] = {
-        0,1,2,3,4,
-        5,10,6,1,0,
-        6,11,7,2,1,
-        7,12,8,3,2,
-        8,13,9,4,3,
-        9,14,5,0,4,
-        15,16,11,6,10,
-        16,17,12,7,11,
-        17,18,13,8,12,
-        18,19,14,9,13,
-        19,15,10,5,14,
-        19,18,17,16,15
-    };
-    int npentagons = sizeof(pentagons) / sizeof(pentagons[0]) / 5;
-    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
-    int ncorners = sizeof(verts) / sizeof(verts[0]) / 3;
-    mesh->npoints = ncorners;
-    mesh->points = PAR_MALLOC(float, mesh->npoints * 3);
-    memcpy(mesh->points, verts, sizeof(verts));
-    PAR_SHAPES_T const* pentagon = pentagons;
-    mesh->ntriangles = npentagons * 3;
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, mesh->ntriangles * 3);
-    PAR_SHAPES_T* tris = mesh->triangles;
-    for (int p = 0; p < npentagons; p++, pentagon += 5) {
-        *tris++ = pentagon[0];
-        *tris++ = pentagon[1];
-        *tris++ = pentagon[2];
-        *tris++ = pentagon[0];
-        *tris++ = pentagon[2];
-        *tris++ = pentagon[3];
-        *tris++ = pentagon[0];
-        *tris++ = pentagon[3];
-        *tris++ = pentagon[4];
-    }
-    return mesh;
-}
+static PAR_SHAPES_T const par_shapes__icosahedron_faces[] = {
+    0,1,2,
+    0,2,3,
+    0,3,4,
+    0,4,5,
+    0,5,1,
+    7,6,11,
+    8,7,11,
+    9,8,11,
+    10,9,11,
+    6,10,11,
+    6,2,1,
+    7,3,2,
+    8,4,3,
+    9,5,4,
+    10,1,5,
+    6,7,2,
+    7,8,3,
+    8,9,4,
+    9,10,5,
+    10,6,1
+};
 
-par_shapes_mesh* par_shapes_create_octahedron()
-{
-    static float verts[6 * 3] = {
-        0.000, 0.000, 1.000,
-        1.000, 0.000, 0.000,
-        0.000, 1.000, 0.000,
-        -1.000, 0.000, 0.000,
-        0.000, -1.000, 0.000,
-        0.000, 0.000, -1.000
-    };
-    static PAR_SHAPES_T triangles[8 * 3] = {
-        0,1,2,
-        0,2,3,
-        0,3,4,
-        0,4,1,
-        2,1,5,
-        3,2,5,
-        4,3,5,
-        1,4,5,
-    };
-    int ntris = sizeof(triangles) / sizeof(triangles[0]) / 3;
+static float const par_shapes__dodecahedron_points[20 * 3] = {
+    0.607, 0.000, 0.795,
+    0.188, 0.577, 0.795,
+    -0.491, 0.357, 0.795,
+    -0.491, -0.357, 0.795,
+    0.188, -0.577, 0.795,
+    0.982, 0.000, 0.188,
+    0.304, 0.934, 0.188,
+    -0.795, 0.577, 0.188,
+    -0.795, -0.577, 0.188,
+    0.304, -0.934, 0.188,
+    0.795, 0.577, -0.188,
+    -0.304, 0.934, -0.188,
+    -0.982, 0.000, -0.188,
+    -0.304, -0.934, -0.188,
+    0.795, -0.577, -0.188,
+    0.491, 0.357, -0.795,
+    -0.188, 0.577, -0.795,
+    -0.607, 0.000, -0.795,
+    -0.188, -0.577, -0.795,
+    0.491, -0.357, -0.795,
+};
+
+static PAR_SHAPES_T const par_shapes__dodecahedron_faces[12 * 5] = {
+    0,1,2,3,4,
+    5,10,6,1,0,
+    6,11,7,2,1,
+    7,12,8,3,2,
+    8,13,9,4,3,
+    9,14,5,0,4,
+    15,16,11,6,10,
+    16,17,12,7,11,
+    17,18,13,8,12,
+    18,19,14,9,13,
+    19,15,10,5,14,
+    19,18,17,16,15
+};
+
+static float const par_shapes__octahedron_points[6 * 3] = {
+    0.000, 0.000, 1.000,
+    1.000, 0.000, 0.000,
+    0.000, 1.000, 0.000,
+    -1.000, 0.000, 0.000,
+    0.000, -1.000, 0.000,
+    0.000, 0.000, -1.000
+};
+
+static PAR_SHAPES_T const par_shapes__octahedron_faces[8 * 3] = {
+    0,1,2,
+    0,2,3,
+    0,3,4,
+    0,4,1,
+    2,1,5,
+    3,2,5,
+    4,3,5,
+    1,4,5,
+};
+
+static float const par_shapes__tetrahedron_points[4 * 3] = {
+    0.000, 1.333, 0,
+    0.943, 0, 0,
+    -0.471, 0, 0.816,
+    -0.471, 0, -0.816,
+};
+
+static PAR_SHAPES_T const par_shapes__tetrahedron_faces[4 * 3] = {
+    2,1,0,
+    3,2,0,
+    1,3,0,
+    1,2,3,
+};
+
+static float const par_shapes__cube_points[8 * 3] = {
+    0, 0, 0, // 0
+    0, 1, 0, // 1
+    1, 1, 0, // 2
+    1, 0, 0, // 3
+    0, 0, 1, // 4
+    0, 1, 1, // 5
+    1, 1, 1, // 6
+    1, 0, 1, // 7
+};
+
+static PAR_SHAPES_T const par_shapes__cube_faces[6 * 4] = {
+    7,6,5,4, // front
+    0,1,2,3, // back
+    6,7,3,2, // right
+    5,6,2,1, // top
+    4,5,1,0, // left
+    7,4,0,3, // bottom
+};
+
+#define PAR_SHAPES__POLYHEDRON(NAME, SIDES) \
+    poly->points = par_shapes__##NAME##_points; \
+    poly->faces = par_shapes__##NAME##_faces; \
+    poly->npoints = sizeof(par_shapes__##NAME##_points) / sizeof(float) / 3; \
+    poly->nfaces = sizeof(par_shapes__##NAME##_faces) / sizeof(PAR_SHAPES_T) / \
+        (SIDES); \
+    poly->sides = (SIDES)
+
+static bool par_shapes__get_polyhedron(par_shapes_surface surface,
+    par_shapes__polyhedron* poly)
+{
+    switch (surface) {
+    case PAR_SHAPES_SURFACE_ICOSAHEDRON:
+        PAR_SHAPES__POLYHEDRON(icosahedron, 3);
+        return true;
+    case PAR_SHAPES_SURFACE_DODECAHEDRON:
+        PAR_SHAPES__POLYHEDRON(dodecahedron, 5);
+        return true;
+    case PAR_SHAPES_SURFACE_OCTAHEDRON:
+        PAR_SHAPES__POLYHEDRON(octahedron, 3);
+        return true;
+    case PAR_SHAPES_SURFACE_TETRAHEDRON:
+        PAR_SHAPES__POLYHEDRON(tetrahedron, 3);
+        return true;
+    case PAR_SHAPES_SURFACE_CUBE:
+        PAR_SHAPES__POLYHEDRON(cube, 4);
+        return true;
+    default:
+        return false;
+    }
+}
+
+#undef PAR_SHAPES__POLYHEDRON
+
+// Allocates a fixed-size solid with 16-bit indices and populates it.
+static par_shapes_mesh* par_shapes__create_polyhedron(
+    par_shapes_surface surface)
+{
+    par_shapes_config config = {surface};
     par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
-    int ncorners = sizeof(verts) / sizeof(verts[0]) / 3;
-    mesh->npoints = ncorners;
-    mesh->points = PAR_MALLOC(float, mesh->npoints * 3);
-    memcpy(mesh->points, verts, sizeof(verts));
-    PAR_SHAPES_T const* triangle = triangles;
-    mesh->ntriangles = ntris;
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, mesh->ntriangles * 3);
-    PAR_SHAPES_T* tris = mesh->triangles;
-    for (int p = 0; p < ntris; p++) {
-        *tris++ = *triangle++;
-        *tris++ = *triangle++;
-        *tris++ = *triangle++;
-    }
+    par_shapes_get_counts(&config, &mesh->npoints, &mesh->ntriangles);
+    mesh->points = PAR_MALLOC(float, 3 * mesh->npoints);
+    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, 3 * mesh->ntriangles);
+    par_shapes_populate(&config, mesh);
     return mesh;
 }
 
-par_shapes_mesh* par_shapes_create_tetrahedron()
+par_shapes_mesh* par_shapes_create_icosahedron()
 {
-    static float verts[4 * 3] = {
-        0.000, 1.333, 0,
-        0.943, 0, 0,
-        -0.471, 0, 0.816,
-        -0.471, 0, -0.816,
-    };
-    static PAR_SHAPES_T triangles[4 * 3] = {
-        2,1,0,
-        3,2,0,
-        1,3,0,
-        1,2,3,
-    };
-    int ntris = sizeof(triangles) / sizeof(triangles[0]) / 3;
-    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
-    int ncorners = sizeof(verts) / sizeof(verts[0]) / 3;
-    mesh->npoints = ncorners;
-    mesh->points = PAR_MALLOC(float, mesh->npoints * 3);
-    memcpy(mesh->points, verts, sizeof(verts));
-    PAR_SHAPES_T const* triangle = triangles;
-    mesh->ntriangles = ntris;
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, mesh->ntriangles * 3);
-    PAR_SHAPES_T* tris = mesh->triangles;
-    for (int p = 0; p < ntris; p++) {
-        *tris++ = *triangle++;
-        *tris++ = *triangle++;
-        *tris++ = *triangle++;
-    }
-    return mesh;
+    return par_shapes__create_polyhedron(PAR_SHAPES_SURFACE_ICOSAHEDRON);
 }
 
-par_shapes_mesh* par_shapes_create_cube()
+par_shapes_mesh* par_shapes_create_dodecahedron()
 {
-    static float verts[8 * 3] = {
-        0, 0, 0, // 0
-        0, 1, 0, // 1
-        1, 1, 0, // 2
-        1, 0, 0, // 3
-        0, 0, 1, // 4
-        0, 1, 1, // 5
-        1, 1, 1, // 6
-        1, 0, 1, // 7
-    };
-    static PAR_SHAPES_T quads[6 * 4] = {
-        7,6,5,4, // front
-        0,1,2,3, // back
-        6,7,3,2, // right
-        5,6,2,1, // top
-        4,5,1,0, // left
-        7,4,0,3, // bottom
-    };
-    int nquads = sizeof(quads) / sizeof(quads[0]) / 4;
-    par_shapes_mesh* mesh = PAR_CALLOC(par_shapes_mesh, 1);
-    int ncorners = sizeof(verts) / sizeof(verts[0]) / 3;
-    mesh->npoints = ncorners;
-    mesh->points = PAR_MALLOC(float, mesh->npoints * 3);
-    memcpy(mesh->points, verts, sizeof(verts));
-    PAR_SHAPES_T const* quad = quads;
-    mesh->ntriangles = nquads * 2;
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, mesh->ntriangles * 3);
-    PAR_SHAPES_T* tris = mesh->triangles;
-    for (int p = 0; p < nquads; p++, quad += 4) {
-        *tris++ = quad[0];
-        *tris++ = quad[1];
-        *tris++ = quad[2];
-        *tris++ = quad[2];
-        *tris++ = quad[3];
-        *tris++ = quad[0];
-    }
-    return mesh;
+    return par_shapes__create_polyhedron(PAR_SHAPES_SURFACE_DODECAHEDRON);
 }
 
-typedef struct {
-    char* cmd;
-    char* arg;
-} par_shapes__command;
-
-typedef struct {
-    char const* name;
-    int weight;
-    int ncommands;
-    par_shapes__command* commands;
-} par_shapes__rule;
-
-typedef struct {
-    int pc;
-    float position[3];
-    float scale[3];
-    par_shapes_mesh* orientation;
-    par_shapes__rule* rule;
-} par_shapes__stackframe;
-
-static par_shapes__rule* par_shapes__pick_rule(const char* name,
-    par_shapes__rule* rules, int nrules)
+par_shapes_mesh* par_shapes_create_octahedron()
 {
-    par_shapes__rule* rule = 0;
-    int total = 0;
-    for (int i = 0; i < nrules; i++) {
-        rule = rules + i;
-        if (!strcmp(rule->name, name)) {
-            total += rule->weight;
-        }
-    }
-    float r = (float) rand() / RAND_MAX;
-    float t = 0;
-    for (int i = 0; i < nrules; i++) {
-        rule = rules + i;
-        if (!strcmp(rule->name, name)) {
-            t += (float) rule->weight / total;
-            if (t >= r) {
-                return rule;
-            }
-        }
-    }
-    return rule;
+    return par_shapes__create_polyhedron(PAR_SHAPES_SURFACE_OCTAHEDRON);
 }
 
-static par_shapes_mesh* par_shapes__create_turtle()
+par_shapes_mesh* par_shapes_create_tetrahedron()
 {
-    const float xaxis[] = {1, 0, 0};
-    const float yaxis[] = {0, 1, 0};
-    const float zaxis[] = {0, 0, 1};
-    par_shapes_mesh* turtle = PAR_CALLOC(par_shapes_mesh, 1);
-    turtle->npoints = 3;
-    turtle->points = PAR_CALLOC(float, turtle->npoints * 3);
-    par_shapes__copy3(turtle->points + 0, xaxis);
-    par_shapes__copy3(turtle->points + 3, yaxis);
-    par_shapes__copy3(turtle->points + 6, zaxis);
-    return turtle;
+    return par_shapes__create_polyhedron(PAR_SHAPES_SURFACE_TETRAHEDRON);
 }
 
-static par_shapes_mesh* par_shapes__apply_turtle(par_shapes_mesh* mesh,
-    par_shapes_mesh* turtle, float const* pos, float const* scale)
+par_shapes_mesh* par_shapes_create_cube()
 {
-    par_shapes_mesh* m = par_shapes_clone(mesh, 0);
-    for (int p = 0; p < m->npoints; p++) {
-        float* pt = m->points + p * 3;
-        pt[0] *= scale[0];
-        pt[1] *= scale[1];
-        pt[2] *= scale[2];
-        par_shapes__transform3(pt,
-            turtle->points + 0, turtle->points + 3, turtle->points + 6);
-        pt[0] += pos[0];
-        pt[1] += pos[1];
-        pt[2] += pos[2];
-    }
-    return m;
+    return par_shapes__create_polyhedron(PAR_SHAPES_SURFACE_CUBE);
 }
 
 void par_shapes__connect(par_shapes_mesh* scene, par_shapes_mesh* cylinder,
@@ -1192,337 +2148,628 @@ void par_shapes__connect(par_shapes_mesh* scene, par_shapes_mesh* cylinder,
 
     // Create the new triangle list.
     int ntriangles = scene->ntriangles + 2 * slices * stacks;
-    PAR_SHAPES_T* triangles = PAR_MALLOC(PAR_SHAPES_T, ntriangles * 3);
-    memcpy(triangles, scene->triangles,
-        sizeof(PAR_SHAPES_T) * scene->ntriangles * 3);
+    if (par_shapes__needs_wide(npoints)) {
+        par_shapes_promote_indices(scene);
+    }
+    if (scene->triangles32) {
+        scene->triangles32 = PAR_REALLOC(uint32_t, scene->triangles32,
+            ntriangles * 3);
+    } else {
+        scene->triangles = PAR_REALLOC(PAR_SHAPES_T, scene->triangles,
+            ntriangles * 3);
+    }
     int v = scene->npoints - (slices + 1);
-    PAR_SHAPES_T* face = triangles + scene->ntriangles * 3;
+    int f = scene->ntriangles * 3;
     for (int stack = 0; stack < stacks; stack++) {
         for (int slice = 0; slice < slices; slice++) {
             int next = slice + 1;
-            *face++ = v + slice + slices + 1;
-            *face++ = v + next;
-            *face++ = v + slice;
-            *face++ = v + slice + slices + 1;
-            *face++ = v + next + slices + 1;
-            *face++ = v + next;
+            par_shapes__set_index(scene, f++, v + slice + slices + 1);
+            par_shapes__set_index(scene, f++, v + next);
+            par_shapes__set_index(scene, f++, v + slice);
+            par_shapes__set_index(scene, f++, v + slice + slices + 1);
+            par_shapes__set_index(scene, f++, v + next + slices + 1);
+            par_shapes__set_index(scene, f++, v + next);
         }
         v += slices + 1;
     }
-    PAR_FREE(scene->triangles);
-    scene->triangles = triangles;
 
     scene->npoints = npoints;
     scene->ntriangles = ntriangles;
 }
 
-par_shapes_mesh* par_shapes_create_lsystem(char const* text, int slices,
-    int maxdepth)
+// L-system programs are compiled into a flat list of instructions, where each
+// rule owns a contiguous run.  Rules that share a name form a group, and each
+// call instruction refers to the group that it expands.
+typedef enum {
+    PAR_SHAPES__OP_NOP,
+    PAR_SHAPES__OP_SHAPE,
+    PAR_SHAPES__OP_CONNECT,
+    PAR_SHAPES__OP_CALL,
+    PAR_SHAPES__OP_ROTATE,
+    PAR_SHAPES__OP_TRANSLATE,
+    PAR_SHAPES__OP_SCALE,
+    PAR_SHAPES__OP_SCALE_ALL,
+} par_shapes__opcode;
+
+typedef struct {
+    par_shapes__opcode op;
+    int axis;
+    int group;
+    float value;
+    float rotation[9];
+} par_shapes__instruction;
+
+typedef struct {
+    char const* name;
+    int namelen;
+    int weight;
+    int group;
+    float threshold;
+    int first;
+    int ninstructions;
+} par_shapes__rule;
+
+typedef struct {
+    int first;
+    int nrules;
+} par_shapes__group;
+
+typedef struct {
+    par_shapes__instruction* code;
+    par_shapes__rule* rules;
+    par_shapes__group* groups;
+    int* members;
+    int nrules;
+    int ngroups;
+} par_shapes__program;
+
+typedef struct {
+    int pc;
+    int rule;
+    float position[3];
+    float scale[3];
+    float turtle[9];
+} par_shapes__stackframe;
+
+// Finds the next whitespace-delimited token without modifying the text.
+static char const* par_shapes__next_token(char const* text, int* len)
 {
-    char* program;
-    program = PAR_MALLOC(char, strlen(text) + 1);
+    while (*text && isspace((unsigned char) *text)) {
+        text++;
+    }
+    *len = 0;
+    while (text[*len] && !isspace((unsigned char) text[*len])) {
+        (*len)++;
+    }
+    return *len ? text : 0;
+}
 
+static bool par_shapes__token_equals(char const* token, int len,
+    char const* str)
+{
+    return (int) strlen(str) == len && !strncmp(token, str, len);
+}
+
+static int par_shapes__find_group(par_shapes__program const* program,
+    char const* name, int namelen)
+{
+    for (int g = 0; g < program->ngroups; g++) {
+        int r = program->members[program->groups[g].first];
+        par_shapes__rule const* rule = program->rules + r;
+        if (rule->namelen == namelen && !strncmp(rule->name, name, namelen)) {
+            return g;
+        }
+    }
+    return -1;
+}
+
+static void par_shapes__compile_lsystem(char const* text,
+    par_shapes__program* program)
+{
     // The first pass counts the number of rules and commands.
-    strcpy(program, text);
-    char *cmd = strtok(program, " ");
     int nrules = 1;
     int ncommands = 0;
+    int cmdlen, arglen;
+    char const* cmd = par_shapes__next_token(text, &cmdlen);
     while (cmd) {
-        char *arg = strtok(0, " ");
+        char const* arg = par_shapes__next_token(cmd + cmdlen, &arglen);
         if (!arg) {
             puts("lsystem error: unexpected end of program.");
             break;
         }
-        if (!strcmp(cmd, "rule")) {
+        if (par_shapes__token_equals(cmd, cmdlen, "rule")) {
             nrules++;
         } else {
             ncommands++;
         }
-        cmd = strtok(0, " ");
-    }
-
-    // Allocate space.
-    par_shapes__rule* rules = PAR_MALLOC(par_shapes__rule, nrules);
-    par_shapes__command* commands = PAR_MALLOC(par_shapes__command, ncommands);
-
-    // Initialize the entry rule.
-    par_shapes__rule* current_rule = &rules[0];
-    par_shapes__command* current_command = &commands[0];
-    current_rule->name = "entry";
-    current_rule->weight = 1;
-    current_rule->ncommands = 0;
-    current_rule->commands = current_command;
-
-    // The second pass fills in the structures.
-    strcpy(program, text);
-    cmd = strtok(program, " ");
+        cmd = par_shapes__next_token(arg + arglen, &cmdlen);
+    }
+    par_shapes__rule* rules = PAR_CALLOC(par_shapes__rule, nrules);
+    par_shapes__instruction* code =
+        PAR_CALLOC(par_shapes__instruction, ncommands);
+    char const** targets = PAR_CALLOC(char const*, ncommands);
+    int* targetlens = PAR_CALLOC(int, ncommands);
+
+    // The second pass fills in the rules and instructions.
+    const float axes[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    par_shapes__rule* rule = rules;
+    rule->name = "entry";
+    rule->namelen = 5;
+    rule->weight = 1;
+    int pc = 0;
+    cmd = par_shapes__next_token(text, &cmdlen);
     while (cmd) {
-        char *arg = strtok(0, " ");
-        if (!strcmp(cmd, "rule")) {
-            current_rule++;
+        char const* arg = par_shapes__next_token(cmd + cmdlen, &arglen);
+        if (!arg) {
+            break;
+        }
+        if (par_shapes__token_equals(cmd, cmdlen, "rule")) {
+            rule++;
+            rule->first = pc;
 
             // Split the argument into a rule name and weight.
-            char* dot = strchr(arg, '.');
-            if (dot) {
-                current_rule->weight = atoi(dot + 1);
-                *dot = 0;
-            } else {
-                current_rule->weight = 1;
+            char const* dot = (char const*) memchr(arg, '.', arglen);
+            rule->name = arg;
+            rule->namelen = dot ? (int) (dot - arg) : arglen;
+            rule->weight = dot ? atoi(dot + 1) : 1;
+        } else {
+            par_shapes__instruction* instr = code + pc;
+            rule->ninstructions++;
+            char op = cmd[0];
+            int axis = cmd[1] - 'x';
+            bool transform = cmdlen == 2 && axis >= 0 && axis < 3;
+            if (par_shapes__token_equals(cmd, cmdlen, "shape")) {
+                instr->op = par_shapes__token_equals(arg, arglen, "connect") ?
+                    PAR_SHAPES__OP_CONNECT : PAR_SHAPES__OP_SHAPE;
+            } else if (par_shapes__token_equals(cmd, cmdlen, "call")) {
+                instr->op = PAR_SHAPES__OP_CALL;
+                targets[pc] = arg;
+                targetlens[pc] = arglen;
+            } else if (par_shapes__token_equals(cmd, cmdlen, "sa")) {
+                instr->op = PAR_SHAPES__OP_SCALE_ALL;
+            } else if (transform && op == 'r') {
+                instr->op = PAR_SHAPES__OP_ROTATE;
+            } else if (transform && op == 't') {
+                instr->op = PAR_SHAPES__OP_TRANSLATE;
+            } else if (transform && op == 's') {
+                instr->op = PAR_SHAPES__OP_SCALE;
             }
+            instr->axis = axis;
+            instr->value = atof(arg);
+            if (instr->op == PAR_SHAPES__OP_ROTATE) {
+                float radians = instr->value * PAR_PI / 180.0;
+                par_shapes__rotation3(instr->rotation, radians, axes[axis]);
+            }
+            pc++;
+        }
+        cmd = par_shapes__next_token(arg + arglen, &cmdlen);
+    }
+
+    // Gather rules into groups, preserving program order within each group.
+    program->code = code;
+    program->rules = rules;
+    program->nrules = nrules;
+    program->groups = PAR_CALLOC(par_shapes__group, nrules);
+    program->members = PAR_MALLOC(int, nrules);
+    program->ngroups = 0;
+    for (int r = 0; r < nrules; r++) {
+        rules[r].group = par_shapes__find_group(program, rules[r].name,
+            rules[r].namelen);
+        if (rules[r].group < 0) {
+            rules[r].group = program->ngroups;
+            program->groups[program->ngroups++].first = r;
+            program->members[r] = r;
+        }
+    }
+    int nmembers = 0;
+    for (int g = 0; g < program->ngroups; g++) {
+        par_shapes__group* group = program->groups + g;
+        group->first = nmembers;
+        int total = 0;
+        for (int r = 0; r < nrules; r++) {
+            if (rules[r].group == g) {
+                program->members[nmembers++] = r;
+                total += rules[r].weight;
+            }
+        }
+        group->nrules = nmembers - group->first;
+        float t = 0;
+        for (int i = group->first; i < nmembers; i++) {
+            rule = rules + program->members[i];
+            t += (float) rule->weight / total;
+            rule->threshold = t;
+        }
+    }
 
-            current_rule->name = arg;
-            current_rule->ncommands = 0;
-            current_rule->commands = current_command;
-        } else {
-            current_rule->ncommands++;
-            current_command->cmd = cmd;
-            current_command->arg = arg;
-            current_command++;
+    // Resolve call targets now that every rule is known.
+    for (int i = 0; i < ncommands; i++) {
+        if (code[i].op == PAR_SHAPES__OP_CALL) {
+            code[i].group = par_shapes__find_group(program, targets[i],
+                targetlens[i]);
         }
-        cmd = strtok(0, " ");
     }
+    PAR_FREE(targets);
+    PAR_FREE(targetlens);
 
-    // For testing purposes, dump out the parsed program.
+    // For testing purposes, dump out the compiled program.
     #ifdef TEST_PARSE
-    for (int i = 0; i < nrules; i++) {
-        par_shapes__rule rule = rules[i];
-        printf("rule %s.%d\n", rule.name, rule.weight);
-        for (int c = 0; c < rule.ncommands; c++) {
-            par_shapes__command cmd = rule.commands[c];
-            printf("\t%s %s\n", cmd.cmd, cmd.arg);
+    for (int r = 0; r < nrules; r++) {
+        rule = rules + r;
+        printf("rule %.*s.%d group %d threshold %f\n", rule->namelen,
+            rule->name, rule->weight, rule->group, rule->threshold);
+        for (int i = 0; i < rule->ninstructions; i++) {
+            par_shapes__instruction const* instr = code + rule->first + i;
+            printf("\top %d axis %d group %d value %f\n", instr->op,
+                instr->axis, instr->group, instr->value);
         }
     }
     #endif
+}
 
-    // Instantiate the aggregated shape and the template shapes.
-    par_shapes_mesh* scene = PAR_CALLOC(par_shapes_mesh, 1);
-    par_shapes_mesh* tube = par_shapes_create_cylinder(slices, 1);
-    par_shapes_mesh* turtle = par_shapes__create_turtle();
+static void par_shapes__free_program(par_shapes__program* program)
+{
+    PAR_FREE(program->code);
+    PAR_FREE(program->rules);
+    PAR_FREE(program->groups);
+    PAR_FREE(program->members);
+}
 
-    // We're not attempting to support texture coordinates and normals
-    // with L-systems, so remove them from the template shape.
-    PAR_FREE(tube->normals);
-    PAR_FREE(tube->tcoords);
-    tube->normals = 0;
-    tube->tcoords = 0;
+static int par_shapes__pick_rule(par_shapes__program const* program,
+    int group)
+{
+    float r = (float) rand() / RAND_MAX;
+    if (group >= 0) {
+        par_shapes__group const* g = program->groups + group;
+        for (int i = 0; i < g->nrules; i++) {
+            int rule = program->members[g->first + i];
+            if (program->rules[rule].threshold >= r) {
+                return rule;
+            }
+        }
+    }
+
+    // As in the original interpreter, unmatched picks use the last rule.
+    return program->nrules - 1;
+}
+
+// Growable buffers that the L-system emits geometry into.
+typedef struct {
+    float* points;
+    uint32_t* indices;
+    int npoints;
+    int nindices;
+    int point_capacity;
+    int index_capacity;
+} par_shapes__builder;
+
+static void par_shapes__builder_reserve(par_shapes__builder* builder,
+    int npoints, int nindices)
+{
+    if (builder->npoints + npoints > builder->point_capacity) {
+        while (builder->npoints + npoints > builder->point_capacity) {
+            builder->point_capacity = PAR_MAX(64,
+                builder->point_capacity * 2);
+        }
+        builder->points = PAR_REALLOC(float, builder->points,
+            3 * builder->point_capacity);
+    }
+    if (builder->nindices + nindices > builder->index_capacity) {
+        while (builder->nindices + nindices > builder->index_capacity) {
+            builder->index_capacity = PAR_MAX(64,
+                builder->index_capacity * 2);
+        }
+        builder->indices = PAR_REALLOC(uint32_t, builder->indices,
+            builder->index_capacity);
+    }
+}
+
+// Appends a tube that has been placed by the turtle.  When connecting, the
+// bottom ring of the tube is replaced with the top ring of the previous tube.
+static void par_shapes__emit_tube(par_shapes__builder* builder,
+    par_shapes_mesh const* tube, par_shapes__stackframe const* frame,
+    int slices, bool connect)
+{
+    const int ring = slices + 1;
+    assert((!connect || builder->npoints >= ring * 2) &&
+        "Cannot connect to empty scene.");
+    int first = connect ? ring : 0;
+    int base = connect ? builder->npoints - ring : builder->npoints;
+    par_shapes__builder_reserve(builder, tube->npoints - first,
+        tube->ntriangles * 3);
+    float* dst = builder->points + builder->npoints * 3;
+    for (int p = first; p < tube->npoints; p++, dst += 3) {
+        float const* src = tube->points + p * 3;
+        dst[0] = src[0] * frame->scale[0];
+        dst[1] = src[1] * frame->scale[1];
+        dst[2] = src[2] * frame->scale[2];
+        par_shapes__transform3(dst, frame->turtle + 0, frame->turtle + 3,
+            frame->turtle + 6);
+        par_shapes__add3(dst, frame->position);
+    }
+    builder->npoints += tube->npoints - first;
+    uint32_t* indices = builder->indices + builder->nindices;
+    for (int i = 0; i < tube->ntriangles * 3; i++) {
+        indices[i] = base + par_shapes__get_index(tube, i);
+    }
+    builder->nindices += tube->ntriangles * 3;
+}
 
-    const float xaxis[] = {1, 0, 0};
-    const float yaxis[] = {0, 1, 0};
-    const float zaxis[] = {0, 0, 1};
-    const float units[] = {1, 1, 1};
+par_shapes_mesh* par_shapes_create_lsystem(char const* text, int slices,
+    int maxdepth)
+{
+    par_shapes__program program;
+    par_shapes__compile_lsystem(text, &program);
+
+    // We're not attempting to support texture coordinates and normals
+    // with L-systems, so only the points and triangles of the tube are used.
+    par_shapes_mesh* tube = par_shapes_create_cylinder(slices, 1);
+    par_shapes__builder builder = {0};
 
     // Execute the L-system program until the stack size is 0.
     par_shapes__stackframe* stack =
         PAR_CALLOC(par_shapes__stackframe, maxdepth);
     int stackptr = 0;
-    stack[0].orientation = turtle;
-    stack[0].rule = &rules[0];
-    par_shapes__copy3(stack[0].scale, units);
+    stack[0].scale[0] = stack[0].scale[1] = stack[0].scale[2] = 1;
+    stack[0].turtle[0] = stack[0].turtle[4] = stack[0].turtle[8] = 1;
     while (stackptr >= 0) {
         par_shapes__stackframe* frame = &stack[stackptr];
-        par_shapes__rule* rule = frame->rule;
-        par_shapes_mesh* turtle = frame->orientation;
-        float* position = frame->position;
-        float* scale = frame->scale;
-        if (frame->pc >= rule->ncommands) {
-            par_shapes_free_mesh(turtle);
+        par_shapes__rule const* rule = program.rules + frame->rule;
+        if (frame->pc >= rule->ninstructions) {
             stackptr--;
             continue;
         }
-
-        par_shapes__command* cmd = rule->commands + (frame->pc++);
-        #ifdef DUMP_TRACE
-        printf("%5s %5s %5s:%d  %03d\n", cmd->cmd, cmd->arg, rule->name,
-            frame->pc - 1, stackptr);
-        #endif
-
-        float value;
-        if (!strcmp(cmd->cmd, "shape")) {
-            par_shapes_mesh* m = par_shapes__apply_turtle(tube, turtle,
-                position, scale);
-            if (!strcmp(cmd->arg, "connect")) {
-                par_shapes__connect(scene, m, slices);
-            } else {
-                par_shapes_merge(scene, m);
-            }
-            par_shapes_free_mesh(m);
-        } else if (!strcmp(cmd->cmd, "call") && stackptr < maxdepth - 1) {
-            rule = par_shapes__pick_rule(cmd->arg, rules, nrules);
-            frame = &stack[++stackptr];
-            frame->rule = rule;
-            frame->orientation = par_shapes_clone(turtle, 0);
-            frame->pc = 0;
-            par_shapes__copy3(frame->scale, scale);
-            par_shapes__copy3(frame->position, position);
-            continue;
-        } else {
-            value = atof(cmd->arg);
-            if (!strcmp(cmd->cmd, "rx")) {
-                par_shapes_rotate(turtle, value * PAR_PI / 180.0, xaxis);
-            } else if (!strcmp(cmd->cmd, "ry")) {
-                par_shapes_rotate(turtle, value * PAR_PI / 180.0, yaxis);
-            } else if (!strcmp(cmd->cmd, "rz")) {
-                par_shapes_rotate(turtle, value * PAR_PI / 180.0, zaxis);
-            } else if (!strcmp(cmd->cmd, "tx")) {
-                float vec[3] = {value, 0, 0};
-                float t[3] = {
-                    par_shapes__dot3(turtle->points + 0, vec),
-                    par_shapes__dot3(turtle->points + 3, vec),
-                    par_shapes__dot3(turtle->points + 6, vec)
-                };
-                par_shapes__add3(position, t);
-            } else if (!strcmp(cmd->cmd, "ty")) {
-                float vec[3] = {0, value, 0};
-                float t[3] = {
-                    par_shapes__dot3(turtle->points + 0, vec),
-                    par_shapes__dot3(turtle->points + 3, vec),
-                    par_shapes__dot3(turtle->points + 6, vec)
-                };
-                par_shapes__add3(position, t);
-            } else if (!strcmp(cmd->cmd, "tz")) {
-                float vec[3] = {0, 0, value};
-                float t[3] = {
-                    par_shapes__dot3(turtle->points + 0, vec),
-                    par_shapes__dot3(turtle->points + 3, vec),
-                    par_shapes__dot3(turtle->points + 6, vec)
-                };
-                par_shapes__add3(position, t);
-            } else if (!strcmp(cmd->cmd, "sx")) {
-                scale[0] *= value;
-            } else if (!strcmp(cmd->cmd, "sy")) {
-                scale[1] *= value;
-            } else if (!strcmp(cmd->cmd, "sz")) {
-                scale[2] *= value;
-            } else if (!strcmp(cmd->cmd, "sa")) {
-                scale[0] *= value;
-                scale[1] *= value;
-                scale[2] *= value;
+        par_shapes__instruction const* instr =
+            program.code + rule->first + (frame->pc++);
+        float* position = frame->position;
+        float* scale = frame->scale;
+        float* turtle = frame->turtle;
+        float vec[3] = {0, 0, 0};
+        float t[3];
+        switch (instr->op) {
+        case PAR_SHAPES__OP_SHAPE:
+        case PAR_SHAPES__OP_CONNECT:
+            par_shapes__emit_tube(&builder, tube, frame, slices,
+                instr->op == PAR_SHAPES__OP_CONNECT);
+            break;
+        case PAR_SHAPES__OP_CALL:
+            if (stackptr < maxdepth - 1) {
+                par_shapes__stackframe* child = &stack[++stackptr];
+                *child = *frame;
+                child->rule = par_shapes__pick_rule(&program, instr->group);
+                child->pc = 0;
             }
+            break;
+        case PAR_SHAPES__OP_ROTATE:
+            par_shapes__rotate3(turtle, 3, instr->rotation);
+            break;
+        case PAR_SHAPES__OP_TRANSLATE:
+            vec[instr->axis] = instr->value;
+            t[0] = par_shapes__dot3(turtle + 0, vec);
+            t[1] = par_shapes__dot3(turtle + 3, vec);
+            t[2] = par_shapes__dot3(turtle + 6, vec);
+            par_shapes__add3(position, t);
+            break;
+        case PAR_SHAPES__OP_SCALE:
+            scale[instr->axis] *= instr->value;
+            break;
+        case PAR_SHAPES__OP_SCALE_ALL:
+            scale[0] *= instr->value;
+            scale[1] *= instr->value;
+            scale[2] *= instr->value;
+            break;
+        case PAR_SHAPES__OP_NOP:
+            break;
         }
     }
-    par_shapes_free_mesh(tube);
     PAR_FREE(stack);
-    PAR_FREE(program);
-    PAR_FREE(rules);
-    PAR_FREE(commands);
+    par_shapes_free_mesh(tube);
+    par_shapes__free_program(&program);
+
+    // Hand the buffers over to the mesh, narrowing the indices if possible.
+    par_shapes_mesh* scene = PAR_CALLOC(par_shapes_mesh, 1);
+    if (!builder.npoints) {
+        return scene;
+    }
+    scene->npoints = builder.npoints;
+    scene->ntriangles = builder.nindices / 3;
+    scene->points = PAR_REALLOC(float, builder.points, 3 * builder.npoints);
+    if (par_shapes__needs_wide(scene->npoints)) {
+        scene->triangles32 = PAR_REALLOC(uint32_t, builder.indices,
+            builder.nindices);
+    } else {
+        par_shapes__alloc_triangles(scene);
+        for (int i = 0; i < builder.nindices; i++) {
+            scene->triangles[i] = (PAR_SHAPES_T) builder.indices[i];
+        }
+        PAR_FREE(builder.indices);
+    }
     return scene;
 }
 
-void par_shapes_unweld(par_shapes_mesh* mesh, bool create_indices)
+// Replaces a per-point attribute with one copy per triangle corner.
+static float* par_shapes__unweld_attribute(par_shapes_mesh const* mesh,
+    float* attribute, int ncomponents)
 {
     int npoints = mesh->ntriangles * 3;
-    float* points = PAR_MALLOC(float, 3 * npoints);
-    float* dst = points;
-    PAR_SHAPES_T const* index = mesh->triangles;
+    float* expanded = PAR_MALLOC(float, ncomponents * npoints);
+    float* dst = expanded;
     for (int i = 0; i < npoints; i++) {
-        float const* src = mesh->points + 3 * (*index++);
-        *dst++ = src[0];
-        *dst++ = src[1];
-        *dst++ = src[2];
+        float const* src = attribute +
+            ncomponents * par_shapes__get_index(mesh, i);
+        for (int c = 0; c < ncomponents; c++) {
+            *dst++ = src[c];
+        }
+    }
+    PAR_FREE(attribute);
+    return expanded;
+}
+
+void par_shapes_unweld(par_shapes_mesh* mesh, bool create_indices)
+{
+    int npoints = mesh->ntriangles * 3;
+    mesh->points = par_shapes__unweld_attribute(mesh, mesh->points, 3);
+    if (mesh->normals) {
+        mesh->normals = par_shapes__unweld_attribute(mesh, mesh->normals, 3);
+    }
+    if (mesh->tcoords) {
+        mesh->tcoords = par_shapes__unweld_attribute(mesh, mesh->tcoords, 2);
     }
-    PAR_FREE(mesh->points);
-    mesh->points = points;
     mesh->npoints = npoints;
     if (create_indices) {
-        PAR_SHAPES_T* tris = PAR_MALLOC(PAR_SHAPES_T, 3 * mesh->ntriangles);
-        PAR_SHAPES_T* index = tris;
+        PAR_FREE(mesh->triangles);
+        PAR_FREE(mesh->triangles32);
+        mesh->triangles = 0;
+        mesh->triangles32 = 0;
+        par_shapes__alloc_triangles(mesh);
         for (int i = 0; i < mesh->ntriangles * 3; i++) {
-            *index++ = i;
+            par_shapes__set_index(mesh, i, i);
         }
-        PAR_FREE(mesh->triangles);
-        mesh->triangles = tris;
     }
 }
 
 void par_shapes_compute_normals(par_shapes_mesh* m)
 {
     PAR_FREE(m->normals);
-    m->normals = PAR_CALLOC(float, m->npoints * 3);
-    PAR_SHAPES_T const* triangle = m->triangles;
-    float next[3], prev[3], cp[3];
-    for (int f = 0; f < m->ntriangles; f++, triangle += 3) {
-        float const* pa = m->points + 3 * triangle[0];
-        float const* pb = m->points + 3 * triangle[1];
-        float const* pc = m->points + 3 * triangle[2];
-        par_shapes__copy3(next, pb);
-        par_shapes__subtract3(next, pa);
-        par_shapes__copy3(prev, pc);
-        par_shapes__subtract3(prev, pa);
-        par_shapes__cross3(cp, next, prev);
-        par_shapes__add3(m->normals + 3 * triangle[0], cp);
-        par_shapes__copy3(next, pc);
-        par_shapes__subtract3(next, pb);
-        par_shapes__copy3(prev, pa);
-        par_shapes__subtract3(prev, pb);
-        par_shapes__cross3(cp, next, prev);
-        par_shapes__add3(m->normals + 3 * triangle[1], cp);
-        par_shapes__copy3(next, pa);
-        par_shapes__subtract3(next, pc);
-        par_shapes__copy3(prev, pb);
-        par_shapes__subtract3(prev, pc);
-        par_shapes__cross3(cp, next, prev);
-        par_shapes__add3(m->normals + 3 * triangle[2], cp);
-    }
-    float* normal = m->normals;
-    for (int p = 0; p < m->npoints; p++, normal += 3) {
-        par_shapes__normalize3(normal);
-    }
+    m->normals = PAR_MALLOC(float, m->npoints * 3);
+    par_shapes__gather_normals(m, 0, 0, m->npoints, false, m->normals);
+}
+
+void par_shapes_compute_angle_weighted_normals(par_shapes_mesh* m)
+{
+    PAR_FREE(m->normals);
+    m->normals = PAR_MALLOC(float, m->npoints * 3);
+    par_shapes__gather_normals(m, 0, 0, m->npoints, true, m->normals);
 }
 
-static void par_shapes__subdivide(par_shapes_mesh* mesh)
-{
-    assert(mesh->npoints == mesh->ntriangles * 3 && "Must be unwelded.");
-    int ntriangles = mesh->ntriangles * 4;
-    int npoints = ntriangles * 3;
-    float* points = PAR_CALLOC(float, npoints * 3);
-    float* dpoint = points;
-    float const* spoint = mesh->points;
-    for (int t = 0; t < mesh->ntriangles; t++, spoint += 9, dpoint += 3) {
-        float const* a = spoint;
-        float const* b = spoint + 3;
-        float const* c = spoint + 6;
-        float const* p0 = dpoint;
-        float const* p1 = dpoint + 3;
-        float const* p2 = dpoint + 6;
-        par_shapes__mix3(dpoint, a, b, 0.5);
-        par_shapes__mix3(dpoint += 3, b, c, 0.5);
-        par_shapes__mix3(dpoint += 3, a, c, 0.5);
-        par_shapes__add3(dpoint += 3, a);
-        par_shapes__add3(dpoint += 3, p0);
-        par_shapes__add3(dpoint += 3, p2);
-        par_shapes__add3(dpoint += 3, p0);
-        par_shapes__add3(dpoint += 3, b);
-        par_shapes__add3(dpoint += 3, p1);
-        par_shapes__add3(dpoint += 3, p2);
-        par_shapes__add3(dpoint += 3, p1);
-        par_shapes__add3(dpoint += 3, c);
+// Open-addressed table that maps an undirected edge to its midpoint vertex.
+typedef struct {
+    uint64_t* keys;
+    uint32_t* values;
+    uint32_t mask;
+} par_shapes__edgecache;
+
+static uint32_t par_shapes__edge_midpoint(par_shapes__edgecache* cache,
+    uint32_t a, uint32_t b, uint32_t* edges, int* nedges, int npoints)
+{
+    uint64_t key = a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    uint32_t slot = (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 32);
+    while (true) {
+        slot &= cache->mask;
+        if (cache->keys[slot] == key) {
+            return cache->values[slot];
+        }
+        if (cache->keys[slot] == UINT64_MAX) {
+            break;
+        }
+        slot++;
+    }
+    edges[*nedges * 2 + 0] = a;
+    edges[*nedges * 2 + 1] = b;
+    cache->keys[slot] = key;
+    cache->values[slot] = npoints + (*nedges)++;
+    return cache->values[slot];
+}
+
+void par_shapes_subdivide(par_shapes_mesh* mesh)
+{
+    const int ntriangles = mesh->ntriangles;
+    par_shapes__edgecache cache;
+    uint32_t capacity = 1;
+    while (capacity < 6 * (uint32_t) ntriangles) {
+        capacity *= 2;
+    }
+    cache.mask = capacity - 1;
+    cache.keys = PAR_MALLOC(uint64_t, capacity);
+    cache.values = PAR_MALLOC(uint32_t, capacity);
+    memset(cache.keys, 0xff, sizeof(uint64_t) * capacity);
+
+    // Find the midpoint index of every edge, allocating new points lazily.
+    uint32_t* mids = PAR_MALLOC(uint32_t, 3 * ntriangles);
+    uint32_t* edges = PAR_MALLOC(uint32_t, 6 * ntriangles);
+    int nedges = 0;
+    for (int t = 0; t < ntriangles; t++) {
+        uint32_t a = par_shapes__get_index(mesh, t * 3 + 0);
+        uint32_t b = par_shapes__get_index(mesh, t * 3 + 1);
+        uint32_t c = par_shapes__get_index(mesh, t * 3 + 2);
+        mids[t * 3 + 0] = par_shapes__edge_midpoint(&cache, a, b, edges,
+            &nedges, mesh->npoints);
+        mids[t * 3 + 1] = par_shapes__edge_midpoint(&cache, b, c, edges,
+            &nedges, mesh->npoints);
+        mids[t * 3 + 2] = par_shapes__edge_midpoint(&cache, a, c, edges,
+            &nedges, mesh->npoints);
+    }
+    PAR_FREE(cache.keys);
+    PAR_FREE(cache.values);
+
+    // Append the midpoints and interpolate their attributes.
+    const int npoints = mesh->npoints + nedges;
+    mesh->points = PAR_REALLOC(float, mesh->points, 3 * npoints);
+    if (mesh->normals) {
+        mesh->normals = PAR_REALLOC(float, mesh->normals, 3 * npoints);
     }
-    PAR_FREE(mesh->points);
-    mesh->points = points;
+    if (mesh->tcoords) {
+        mesh->tcoords = PAR_REALLOC(float, mesh->tcoords, 2 * npoints);
+    }
+    for (int e = 0; e < nedges; e++) {
+        uint32_t a = edges[e * 2 + 0];
+        uint32_t b = edges[e * 2 + 1];
+        int m = mesh->npoints + e;
+        par_shapes__mix3(mesh->points + m * 3, mesh->points + a * 3,
+            mesh->points + b * 3, 0.5);
+        if (mesh->normals) {
+            float* n = mesh->normals + m * 3;
+            par_shapes__mix3(n, mesh->normals + a * 3, mesh->normals + b * 3,
+                0.5);
+            par_shapes__normalize3(n);
+        }
+        if (mesh->tcoords) {
+            float const* ta = mesh->tcoords + a * 2;
+            float const* tb = mesh->tcoords + b * 2;
+            mesh->tcoords[m * 2 + 0] = 0.5f * (ta[0] + tb[0]);
+            mesh->tcoords[m * 2 + 1] = 0.5f * (ta[1] + tb[1]);
+        }
+    }
+    PAR_FREE(edges);
+
+    // Replace each triangle with four, keeping the original winding.
+    par_shapes_mesh* subd = par_shapes_create_empty();
+    subd->npoints = npoints;
+    subd->ntriangles = ntriangles * 4;
+    par_shapes__alloc_triangles(subd);
+    int f = 0;
+    for (int t = 0; t < ntriangles; t++) {
+        uint32_t a = par_shapes__get_index(mesh, t * 3 + 0);
+        uint32_t b = par_shapes__get_index(mesh, t * 3 + 1);
+        uint32_t c = par_shapes__get_index(mesh, t * 3 + 2);
+        uint32_t ab = mids[t * 3 + 0];
+        uint32_t bc = mids[t * 3 + 1];
+        uint32_t ac = mids[t * 3 + 2];
+        uint32_t tris[12] = {ab, bc, ac, a, ab, ac, ab, b, bc, ac, bc, c};
+        for (int i = 0; i < 12; i++) {
+            par_shapes__set_index(subd, f++, tris[i]);
+        }
+    }
+    PAR_FREE(mids);
+    PAR_FREE(mesh->triangles);
+    PAR_FREE(mesh->triangles32);
+    mesh->triangles = subd->triangles;
+    mesh->triangles32 = subd->triangles32;
     mesh->npoints = npoints;
-    mesh->ntriangles = ntriangles;
+    mesh->ntriangles = subd->ntriangles;
+    PAR_FREE(subd);
 }
 
 par_shapes_mesh* par_shapes_create_subdivided_sphere(int nsubd)
 {
     par_shapes_mesh* mesh = par_shapes_create_icosahedron();
-    par_shapes_unweld(mesh, false);
-    PAR_FREE(mesh->triangles);
-    mesh->triangles = 0;
     while (nsubd--) {
-        par_shapes__subdivide(mesh);
+        par_shapes_subdivide(mesh);
     }
     for (int i = 0; i < mesh->npoints; i++) {
         par_shapes__normalize3(mesh->points + i * 3);
     }
-    mesh->triangles = PAR_MALLOC(PAR_SHAPES_T, 3 * mesh->ntriangles);
-    for (int i = 0; i < mesh->ntriangles * 3; i++) {
-        mesh->triangles[i] = i;
-    }
-    par_shapes_mesh* tmp = mesh;
-    mesh = par_shapes_weld(mesh, 0.01, 0);
-    par_shapes_free_mesh(tmp);
-    par_shapes_compute_normals(mesh);
+    mesh->normals = PAR_MALLOC(float, 3 * mesh->npoints);
+    memcpy(mesh->normals, mesh->points, sizeof(float) * 3 * mesh->npoints);
     return mesh;
 }
 
@@ -1559,10 +2806,21 @@ par_shapes_mesh* par_shapes_clone(par_shapes_mesh const* mesh,
     clone->points = PAR_REALLOC(float, clone->points, 3 * clone->npoints);
     memcpy(clone->points, mesh->points, sizeof(float) * 3 * clone->npoints);
     clone->ntriangles = mesh->ntriangles;
-    clone->triangles = PAR_REALLOC(PAR_SHAPES_T, clone->triangles, 3 *
-        clone->ntriangles);
-    memcpy(clone->triangles, mesh->triangles,
-        sizeof(PAR_SHAPES_T) * 3 * clone->ntriangles);
+    if (mesh->triangles32) {
+        PAR_FREE(clone->triangles);
+        clone->triangles = 0;
+        clone->triangles32 = PAR_REALLOC(uint32_t, clone->triangles32, 3 *
+            clone->ntriangles);
+        memcpy(clone->triangles32, mesh->triangles32,
+            sizeof(uint32_t) * 3 * clone->ntriangles);
+    } else {
+        PAR_FREE(clone->triangles32);
+        clone->triangles32 = 0;
+        clone->triangles = PAR_REALLOC(PAR_SHAPES_T, clone->triangles, 3 *
+            clone->ntriangles);
+        memcpy(clone->triangles, mesh->triangles,
+            sizeof(PAR_SHAPES_T) * 3 * clone->ntriangles);
+    }
     if (mesh->normals) {
         clone->normals = PAR_REALLOC(float, clone->normals, 3 * clone->npoints);
         memcpy(clone->normals, mesh->normals,
@@ -1576,258 +2834,242 @@ par_shapes_mesh* par_shapes_clone(par_shapes_mesh const* mesh,
     return clone;
 }
 
-static struct {
-    float const* points;
-    int gridsize;
-} par_shapes__sort_context;
-
-static int par_shapes__cmp1(const void *arg0, const void *arg1)
-{
-    const int g = par_shapes__sort_context.gridsize;
-
-    // Convert arg0 into a flattened grid index.
-    PAR_SHAPES_T d0 = *(const PAR_SHAPES_T*) arg0;
-    float const* p0 = par_shapes__sort_context.points + d0 * 3;
-    int i0 = (int) p0[0];
-    int j0 = (int) p0[1];
-    int k0 = (int) p0[2];
-    int index0 = i0 + g * j0 + g * g * k0;
-
-    // Convert arg1 into a flattened grid index.
-    PAR_SHAPES_T d1 = *(const PAR_SHAPES_T*) arg1;
-    float const* p1 = par_shapes__sort_context.points + d1 * 3;
-    int i1 = (int) p1[0];
-    int j1 = (int) p1[1];
-    int k1 = (int) p1[2];
-    int index1 = i1 + g * j1 + g * g * k1;
-
-    // Return the ordering.
-    if (index0 < index1) return -1;
-    if (index0 > index1) return 1;
-    return 0;
-}
+// The welder bins points into a hash grid whose cells are as large as the
+// weld radius, so each point only needs to look at its 27 neighboring cells.
+// Cell collisions cost a few extra distance tests but never cause misses.
+typedef struct {
+    float origin[3];
+    float scale[3];
+    float invcell;
+    uint32_t mask;
+    uint32_t* heads;   // First entry for each bucket, plus a sentinel
+    uint32_t* entries; // Point indices sorted by bucket, ascending within each
+} par_shapes__hashgrid;
 
-static void par_shapes__sort_points(par_shapes_mesh* mesh, int gridsize,
-    PAR_SHAPES_T* sortmap)
+static void par_shapes__hashgrid_cell(par_shapes__hashgrid const* grid,
+    float const* pt, int* cell)
 {
-    // Run qsort over a list of consecutive integers that get deferenced
-    // within the comparator function; this creates a reorder mapping.
-    for (int i = 0; i < mesh->npoints; i++) {
-        sortmap[i] = i;
-    }
-    par_shapes__sort_context.gridsize = gridsize;
-    par_shapes__sort_context.points = mesh->points;
-    qsort(sortmap, mesh->npoints, sizeof(PAR_SHAPES_T), par_shapes__cmp1);
-
-    // Apply the reorder mapping to the XYZ coordinate data.
-    float* newpts = PAR_MALLOC(float, mesh->npoints * 3);
-    PAR_SHAPES_T* invmap = PAR_MALLOC(PAR_SHAPES_T, mesh->npoints);
-    float* dstpt = newpts;
-    for (int i = 0; i < mesh->npoints; i++) {
-        invmap[sortmap[i]] = i;
-        float const* srcpt = mesh->points + 3 * sortmap[i];
-        *dstpt++ = *srcpt++;
-        *dstpt++ = *srcpt++;
-        *dstpt++ = *srcpt++;
+    for (int c = 0; c < 3; c++) {
+        float q = (pt[c] - grid->origin[c]) * grid->scale[c];
+        cell[c] = (int) (q * grid->invcell);
     }
-    PAR_FREE(mesh->points);
-    mesh->points = newpts;
-
-    // Apply the inverse reorder mapping to the triangle indices.
-    PAR_SHAPES_T* newinds = PAR_MALLOC(PAR_SHAPES_T, mesh->ntriangles * 3);
-    PAR_SHAPES_T* dstind = newinds;
-    PAR_SHAPES_T const* srcind = mesh->triangles;
-    for (int i = 0; i < mesh->ntriangles * 3; i++) {
-        *dstind++ = invmap[*srcind++];
-    }
-    PAR_FREE(mesh->triangles);
-    mesh->triangles = newinds;
+}
 
-    // Cleanup.
-    memcpy(sortmap, invmap, sizeof(PAR_SHAPES_T) * mesh->npoints);
-    PAR_FREE(invmap);
+static uint32_t par_shapes__hashgrid_bucket(par_shapes__hashgrid const* grid,
+    int i, int j, int k)
+{
+    uint32_t h = ((uint32_t) i * 73856093u) ^ ((uint32_t) j * 19349663u) ^
+        ((uint32_t) k * 83492791u);
+    return h & grid->mask;
 }
 
-static void par_shapes__weld_points(par_shapes_mesh* mesh, int gridsize,
-    float epsilon, PAR_SHAPES_T* weldmap)
+static void par_shapes__hashgrid_init(par_shapes__hashgrid* grid,
+    par_shapes_mesh const* mesh, float radius)
 {
-    // Each bin contains a "pointer" (really an index) to its first point.
-    // We add 1 because 0 is reserved to mean that the bin is empty.
-    // Since the points are spatially sorted, there's no need to store
-    // a point count in each bin.
-    PAR_SHAPES_T* bins = PAR_CALLOC(PAR_SHAPES_T,
-        gridsize * gridsize * gridsize);
-    int prev_binindex = -1;
+    // Points are measured in a space where the bounding box spans 19 units
+    // along each axis; this is the space that "epsilon" has always used.
+    const float maxcell = 19;
+    float aabb[6];
+    par_shapes_compute_aabb(mesh, aabb);
+    for (int c = 0; c < 3; c++) {
+        float extent = aabb[c + 3] - aabb[c];
+        grid->origin[c] = aabb[c];
+        grid->scale[c] = extent == 0 ? 1.0f : maxcell / extent;
+    }
+
+    // Keep cell coordinates well within integer range for tiny radii.
+    float cellsize = PAR_MAX(radius, maxcell / (1 << 20));
+    grid->invcell = 1.0f / cellsize;
+    uint32_t nbuckets = 1;
+    while (nbuckets < 2 * (uint32_t) mesh->npoints) {
+        nbuckets *= 2;
+    }
+    grid->mask = nbuckets - 1;
+
+    // Counting sort of the point indices by bucket.
+    uint32_t* bucket = PAR_MALLOC(uint32_t, mesh->npoints);
+    grid->heads = PAR_CALLOC(uint32_t, (nbuckets + 1));
+    grid->entries = PAR_MALLOC(uint32_t, mesh->npoints);
     for (int p = 0; p < mesh->npoints; p++) {
-        float const* pt = mesh->points + p * 3;
-        int i = (int) pt[0];
-        int j = (int) pt[1];
-        int k = (int) pt[2];
-        int this_binindex = i + gridsize * j + gridsize * gridsize * k;
-        if (this_binindex != prev_binindex) {
-            bins[this_binindex] = 1 + p;
-        }
-        prev_binindex = this_binindex;
+        int cell[3];
+        par_shapes__hashgrid_cell(grid, mesh->points + p * 3, cell);
+        bucket[p] = par_shapes__hashgrid_bucket(grid, cell[0], cell[1],
+            cell[2]);
+        grid->heads[bucket[p] + 1]++;
     }
-
-    // Examine all bins that intersect the epsilon-sized cube centered at each
-    // point, and check for colocated points within those bins.
-    float const* pt = mesh->points;
-    int nremoved = 0;
-    for (int p = 0; p < mesh->npoints; p++, pt += 3) {
-
-        // Skip if this point has already been welded.
-        if (weldmap[p] != p) {
-            continue;
-        }
-
-        // Build a list of bins that intersect the epsilon-sized cube.
-        int nearby[8];
-        int nbins = 0;
-        int minp[3], maxp[3];
-        for (int c = 0; c < 3; c++) {
-            minp[c] = (int) (pt[c] - epsilon);
-            maxp[c] = (int) (pt[c] + epsilon);
-        }
-        for (int i = minp[0]; i <= maxp[0]; i++) {
-            for (int j = minp[1]; j <= maxp[1]; j++) {
-                for (int k = minp[2]; k <= maxp[2]; k++) {
-                    int binindex = i + gridsize * j + gridsize * gridsize * k;
-                    PAR_SHAPES_T binvalue = *(bins + binindex);
-                    if (binvalue > 0) {
-                        if (nbins == 8) {
-                            printf("Epsilon value is too large.\n");
-                            break;
-                        }
-                        nearby[nbins++] = binindex;
+    for (uint32_t b = 0; b < nbuckets; b++) {
+        grid->heads[b + 1] += grid->heads[b];
+    }
+    uint32_t* cursor = PAR_MALLOC(uint32_t, nbuckets);
+    memcpy(cursor, grid->heads, sizeof(uint32_t) * nbuckets);
+    for (int p = 0; p < mesh->npoints; p++) {
+        grid->entries[cursor[bucket[p]]++] = p;
+    }
+    PAR_FREE(cursor);
+    PAR_FREE(bucket);
+}
+
+static void par_shapes__hashgrid_free(par_shapes__hashgrid* grid)
+{
+    PAR_FREE(grid->heads);
+    PAR_FREE(grid->entries);
+}
+
+// Finds the lowest-numbered point that lies within the weld radius of point
+// "p", which might be "p" itself.  If "targets" is non-null, only points that
+// are their own target are considered.  This only reads shared data, so it can
+// be called for many points at once.
+static uint32_t par_shapes__find_weld_target(par_shapes__hashgrid const* grid,
+    par_shapes_mesh const* mesh, float epsilon, uint32_t p,
+    uint32_t const* targets)
+{
+    float const* pt = mesh->points + p * 3;
+    uint32_t target = p;
+    int cell[3];
+    par_shapes__hashgrid_cell(grid, pt, cell);
+    for (int k = cell[2] - 1; k <= cell[2] + 1; k++) {
+        for (int j = cell[1] - 1; j <= cell[1] + 1; j++) {
+            for (int i = cell[0] - 1; i <= cell[0] + 1; i++) {
+                uint32_t b = par_shapes__hashgrid_bucket(grid, i, j, k);
+                uint32_t const* entry = grid->entries + grid->heads[b];
+                uint32_t const* end = grid->entries + grid->heads[b + 1];
+                for (; entry != end && *entry < target; entry++) {
+                    if (targets && targets[*entry] != *entry) {
+                        continue;
                     }
-                }
-            }
-        }
-
-        // Check for colocated points in each nearby bin.
-        for (int b = 0; b < nbins; b++) {
-            int binindex = nearby[b];
-            PAR_SHAPES_T binvalue = bins[binindex];
-            PAR_SHAPES_T nindex = binvalue - 1;
-            assert(nindex < mesh->npoints);
-            while (true) {
-
-                // If this isn't "self" and it's colocated, then weld it!
-                if (nindex != p && weldmap[nindex] == nindex) {
-                    float const* thatpt = mesh->points + nindex * 3;
-                    float dist2 = par_shapes__sqrdist3(thatpt, pt);
-                    if (dist2 < epsilon) {
-                        weldmap[nindex] = p;
-                        nremoved++;
+                    float const* thatpt = mesh->points + *entry * 3;
+                    float dx = (thatpt[0] - pt[0]) * grid->scale[0];
+                    float dy = (thatpt[1] - pt[1]) * grid->scale[1];
+                    float dz = (thatpt[2] - pt[2]) * grid->scale[2];
+                    if (dx * dx + dy * dy + dz * dz < epsilon) {
+                        target = *entry;
                     }
                 }
-
-                // Advance to the next point if possible.
-                if (++nindex >= mesh->npoints) {
-                    break;
-                }
-
-                // If the next point is outside the bin, then we're done.
-                float const* nextpt = mesh->points + nindex * 3;
-                int i = (int) nextpt[0];
-                int j = (int) nextpt[1];
-                int k = (int) nextpt[2];
-                int nextbinindex = i + gridsize * j + gridsize * gridsize * k;
-                if (nextbinindex != binindex) {
-                    break;
-                }
             }
         }
     }
-    PAR_FREE(bins);
-
-    // Apply the weldmap to the vertices.
-    int npoints = mesh->npoints - nremoved;
-    float* newpts = PAR_MALLOC(float, 3 * npoints);
-    float* dst = newpts;
-    PAR_SHAPES_T* condensed_map = PAR_MALLOC(PAR_SHAPES_T, mesh->npoints);
-    PAR_SHAPES_T* cmap = condensed_map;
-    float const* src = mesh->points;
-    int ci = 0;
-    for (int p = 0; p < mesh->npoints; p++, src += 3) {
-        if (weldmap[p] == p) {
-            *dst++ = src[0];
-            *dst++ = src[1];
-            *dst++ = src[2];
-            *cmap++ = ci++;
+    return target;
+}
+
+// Populates "weldmap" with the condensed index of every point and returns the
+// number of condensed points.  Survivors keep their relative order.  If "reps"
+// is non-null, it must have room for every point, and it receives the original
+// index of each survivor.
+static int par_shapes__weld_map(par_shapes_mesh const* mesh, float epsilon,
+    uint32_t* weldmap, uint32_t* reps)
+{
+    const int npoints = mesh->npoints;
+    par_shapes__hashgrid grid;
+    par_shapes__hashgrid_init(&grid, mesh, epsilon > 0 ? sqrtf(epsilon) : 0);
+
+    // Each point independently finds the point that it should weld into.
+    uint32_t* targets = PAR_MALLOC(uint32_t, npoints);
+    PAR_SHAPES__PARALLEL_FOR
+    for (int p = 0; p < npoints; p++) {
+        targets[p] = par_shapes__find_weld_target(&grid, mesh, epsilon, p, 0);
+    }
+
+    // Targets always have lower indices, so a single forward sweep assigns
+    // condensed indices to the survivors.  Welds never chain: if the nearest
+    // target was itself welded away, the point looks for the lowest survivor
+    // within its own radius and otherwise becomes a survivor.
+    int nwelded = 0;
+    for (int p = 0; p < npoints; p++) {
+        uint32_t target = targets[p];
+        if (targets[target] != target) {
+            target = par_shapes__find_weld_target(&grid, mesh, epsilon, p,
+                targets);
+            targets[p] = target;
+        }
+        if (target == (uint32_t) p) {
+            if (reps) {
+                reps[nwelded] = p;
+            }
+            weldmap[p] = nwelded++;
         } else {
-            *cmap++ = condensed_map[weldmap[p]];
+            weldmap[p] = weldmap[target];
         }
     }
-    assert(ci == npoints);
-    PAR_FREE(mesh->points);
-    memcpy(weldmap, condensed_map, mesh->npoints * sizeof(PAR_SHAPES_T));
-    PAR_FREE(condensed_map);
-    mesh->points = newpts;
-    mesh->npoints = npoints;
+    par_shapes__hashgrid_free(&grid);
+    PAR_FREE(targets);
+    return nwelded;
+}
+
+static par_shapes_mesh* par_shapes__weld(par_shapes_mesh const* mesh,
+    float epsilon, uint32_t* weldmap)
+{
+    const int npoints = mesh->npoints;
+    bool owner = false;
+    if (!weldmap) {
+        owner = true;
+        weldmap = PAR_MALLOC(uint32_t, npoints);
+    }
+    uint32_t* reps = PAR_MALLOC(uint32_t, npoints);
+    int nwelded = par_shapes__weld_map(mesh, epsilon, weldmap, reps);
+
+    // Gather the surviving vertices.
+    par_shapes_mesh* welded = PAR_CALLOC(par_shapes_mesh, 1);
+    welded->npoints = nwelded;
+    welded->points = PAR_MALLOC(float, 3 * nwelded);
+    if (mesh->normals) {
+        welded->normals = PAR_MALLOC(float, 3 * nwelded);
+    }
+    if (mesh->tcoords) {
+        welded->tcoords = PAR_MALLOC(float, 2 * nwelded);
+    }
+    PAR_SHAPES__PARALLEL_FOR
+    for (int ci = 0; ci < nwelded; ci++) {
+        const uint32_t p = reps[ci];
+        par_shapes__copy3(welded->points + ci * 3, mesh->points + p * 3);
+        if (mesh->normals) {
+            par_shapes__copy3(welded->normals + ci * 3, mesh->normals + p * 3);
+        }
+        if (mesh->tcoords) {
+            welded->tcoords[ci * 2 + 0] = mesh->tcoords[p * 2 + 0];
+            welded->tcoords[ci * 2 + 1] = mesh->tcoords[p * 2 + 1];
+        }
+    }
+    PAR_FREE(reps);
 
     // Apply the weldmap to the triangle indices and skip the degenerates.
-    PAR_SHAPES_T const* tsrc = mesh->triangles;
-    PAR_SHAPES_T* tdst = mesh->triangles;
+    welded->ntriangles = mesh->ntriangles;
+    if (mesh->triangles32) {
+        welded->triangles32 = PAR_MALLOC(uint32_t, 3 * mesh->ntriangles);
+    } else {
+        welded->triangles = PAR_MALLOC(PAR_SHAPES_T, 3 * mesh->ntriangles);
+    }
     int ntriangles = 0;
-    for (int i = 0; i < mesh->ntriangles; i++, tsrc += 3) {
-        PAR_SHAPES_T a = weldmap[tsrc[0]];
-        PAR_SHAPES_T b = weldmap[tsrc[1]];
-        PAR_SHAPES_T c = weldmap[tsrc[2]];
+    for (int i = 0; i < mesh->ntriangles; i++) {
+        uint32_t a = weldmap[par_shapes__get_index(mesh, i * 3 + 0)];
+        uint32_t b = weldmap[par_shapes__get_index(mesh, i * 3 + 1)];
+        uint32_t c = weldmap[par_shapes__get_index(mesh, i * 3 + 2)];
         if (a != b && a != c && b != c) {
-            assert(a < mesh->npoints);
-            assert(b < mesh->npoints);
-            assert(c < mesh->npoints);
-            *tdst++ = a;
-            *tdst++ = b;
-            *tdst++ = c;
+            par_shapes__set_index(welded, ntriangles * 3 + 0, a);
+            par_shapes__set_index(welded, ntriangles * 3 + 1, b);
+            par_shapes__set_index(welded, ntriangles * 3 + 2, c);
             ntriangles++;
         }
     }
-    mesh->ntriangles = ntriangles;
+    welded->ntriangles = ntriangles;
+    if (owner) {
+        PAR_FREE(weldmap);
+    }
+    return welded;
 }
 
 par_shapes_mesh* par_shapes_weld(par_shapes_mesh const* mesh, float epsilon,
-    PAR_SHAPES_T* weldmap)
+    PAR_SHAPES_T* mapping)
 {
-    par_shapes_mesh* clone = par_shapes_clone(mesh, 0);
-    float aabb[6];
-    int gridsize = 20;
-    float maxcell = gridsize - 1;
-    par_shapes_compute_aabb(clone, aabb);
-    float scale[3] = {
-        aabb[3] == aabb[0] ? 1.0f : maxcell / (aabb[3] - aabb[0]),
-        aabb[4] == aabb[1] ? 1.0f : maxcell / (aabb[4] - aabb[1]),
-        aabb[5] == aabb[2] ? 1.0f : maxcell / (aabb[5] - aabb[2]),
-    };
-    par_shapes_translate(clone, -aabb[0], -aabb[1], -aabb[2]);
-    par_shapes_scale(clone, scale[0], scale[1], scale[2]);
-    PAR_SHAPES_T* sortmap = PAR_MALLOC(PAR_SHAPES_T, mesh->npoints);
-    par_shapes__sort_points(clone, gridsize, sortmap);
-    bool owner = false;
-    if (!weldmap) {
-        owner = true;
-        weldmap = PAR_MALLOC(PAR_SHAPES_T, mesh->npoints);
+    if (!mapping) {
+        return par_shapes__weld(mesh, epsilon, 0);
     }
+    uint32_t* weldmap = PAR_MALLOC(uint32_t, mesh->npoints);
+    par_shapes_mesh* welded = par_shapes__weld(mesh, epsilon, weldmap);
     for (int i = 0; i < mesh->npoints; i++) {
-        weldmap[i] = i;
+        mapping[i] = (PAR_SHAPES_T) weldmap[i];
     }
-    par_shapes__weld_points(clone, gridsize, epsilon, weldmap);
-    if (owner) {
-        PAR_FREE(weldmap);
-    } else {
-        PAR_SHAPES_T* newmap = PAR_MALLOC(PAR_SHAPES_T, mesh->npoints);
-        for (int i = 0; i < mesh->npoints; i++) {
-            newmap[i] = weldmap[sortmap[i]];
-        }
-        memcpy(weldmap, newmap, sizeof(PAR_SHAPES_T) * mesh->npoints);
-        PAR_FREE(newmap);
-    }
-    PAR_FREE(sortmap);
-    par_shapes_scale(clone, 1.0 / scale[0], 1.0 / scale[1], 1.0 / scale[2]);
-    par_shapes_translate(clone, aabb[0], aabb[1], aabb[2]);
-    return clone;
+    PAR_FREE(weldmap);
+    return welded;
 }
 
 // -----------------------------------------------------------------------------
@@ -2100,12 +3342,14 @@ static double par__simplex_noise2(struct osn_context* ctx, double x, double y)
 void par_shapes_remove_degenerate(par_shapes_mesh* mesh, float mintriarea)
 {
     int ntriangles = 0;
-    PAR_SHAPES_T* triangles = PAR_MALLOC(PAR_SHAPES_T, mesh->ntriangles * 3);
-    PAR_SHAPES_T* dst = triangles;
-    PAR_SHAPES_T const* src = mesh->triangles;
     float next[3], prev[3], cp[3];
     float mincplen2 = (mintriarea * 2) * (mintriarea * 2);
-    for (int f = 0; f < mesh->ntriangles; f++, src += 3) {
+    for (int f = 0; f < mesh->ntriangles; f++) {
+        uint32_t src[3] = {
+            par_shapes__get_index(mesh, f * 3 + 0),
+            par_shapes__get_index(mesh, f * 3 + 1),
+            par_shapes__get_index(mesh, f * 3 + 2)
+        };
         float const* pa = mesh->points + 3 * src[0];
         float const* pb = mesh->points + 3 * src[1];
         float const* pc = mesh->points + 3 * src[2];
@@ -2116,15 +3360,13 @@ void par_shapes_remove_degenerate(par_shapes_mesh* mesh, float mintriarea)
         par_shapes__cross3(cp, next, prev);
         float cplen2 = par_shapes__dot3(cp, cp);
         if (cplen2 >= mincplen2) {
-            *dst++ = src[0];
-            *dst++ = src[1];
-            *dst++ = src[2];
+            par_shapes__set_index(mesh, ntriangles * 3 + 0, src[0]);
+            par_shapes__set_index(mesh, ntriangles * 3 + 1, src[1]);
+            par_shapes__set_index(mesh, ntriangles * 3 + 2, src[2]);
             ntriangles++;
         }
     }
     mesh->ntriangles = ntriangles;
-    PAR_FREE(mesh->triangles);
-    mesh->triangles = triangles;
 }
 
 #endif // PAR_SHAPES_IMPLEMENTATION
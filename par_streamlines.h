@@ -79,6 +79,7 @@ typedef struct {
 #define PARSL_FLAG_SPINE_LENGTHS  (1 << 2) // populates mesh.lengths
 #define PARSL_FLAG_RANDOM_OFFSETS (1 << 3) // populates mesh.random_offsets
 #define PARSL_FLAG_CURVE_GUIDES   (1 << 4) // draws control points
+#define PARSL_FLAG_SCREEN_SPACE_LOD (1 << 5) // enables culling and merging
 
 // Immutable configuration for a streamlines context.
 typedef struct {
@@ -89,6 +90,16 @@ typedef struct {
     float streamlines_seed_spacing;
     parsl_viewport streamlines_seed_viewport;
     float miter_limit;
+
+    // The following fields are used only with PARSL_FLAG_SCREEN_SPACE_LOD.
+    // The view matrix maps positions to pixels in the same order as an SVG
+    // matrix(a b c d e f) transform. Spines that fall outside of the viewport
+    // are culled, vertices closer than lod_min_pixels (default 1) to their
+    // predecessor are merged, and curves_max_flatness is measured in pixels.
+    // Retained spine sets are not affected, since their layout must be stable.
+    float view_matrix[6];
+    parsl_viewport view_viewport;
+    float lod_min_pixels;
 } parsl_config;
 
 // Client-owned list of line strips that will be tessellated.
@@ -100,12 +111,28 @@ typedef struct {
     bool closed;
 } parsl_spine_list;
 
+// Variant of parsl_spine_list for very large line sets, which allows more
+// than 65535 spines and spines with more than 65535 vertices.
+typedef struct {
+    uint32_t num_vertices;
+    uint32_t num_spines;
+    parsl_position* vertices;
+    uint32_t* spine_lengths;
+    bool closed;
+} parsl_spine_list32;
+
 // Opaque handle to a streamlines context and its memory arena.
 typedef struct parsl_context_s parsl_context;
 
 // Client function that moves a streamline particle by a single time step.
 typedef void (*parsl_advection_callback)(parsl_position* point, void* userdata);
 
+// Client function that moves an entire batch of streamline particles by a
+// single time step. The coordinates are stored in two separate arrays, which
+// makes it easy to sample the vector field with SIMD or multiple threads.
+typedef void (*parsl_advection_batch_callback)(float* x, float* y,
+    uint32_t count, void* userdata);
+
 parsl_context* parsl_create_context(parsl_config config);
 
 void parsl_destroy_context(parsl_context* ctx);
@@ -118,6 +145,42 @@ parsl_mesh* parsl_mesh_from_streamlines(parsl_context* context,
     parsl_advection_callback advect, uint32_t first_tick, uint32_t num_ticks,
     void* userdata);
 
+// Stateful variant of parsl_mesh_from_streamlines that is suitable for
+// animation. The context retains the position of every particle along with
+// its most recent num_ticks vertices, so each call only advects delta_ticks
+// steps rather than replaying the entire history from the seeds. The first
+// tick accumulates across calls, so the Nth call yields the same mesh as
+// parsl_mesh_from_streamlines with first_tick set to the sum of all deltas.
+// Changing num_ticks discards the retained vertices and replays once.
+parsl_mesh* parsl_mesh_from_streamlines_advance(parsl_context* context,
+    parsl_advection_callback advect, uint32_t delta_ticks, uint32_t num_ticks,
+    void* userdata);
+
+// Equivalent to parsl_mesh_from_streamlines, except that the callback is
+// invoked once per tick with every live particle.
+parsl_mesh* parsl_mesh_from_streamlines_batch(parsl_context* context,
+    parsl_advection_batch_callback advect, uint32_t first_tick,
+    uint32_t num_ticks, void* userdata);
+
+// Equivalent to parsl_mesh_from_streamlines_advance, except that the callback
+// is invoked once per tick with every live particle.
+parsl_mesh* parsl_mesh_from_streamlines_advance_batch(parsl_context* context,
+    parsl_advection_batch_callback advect, uint32_t delta_ticks,
+    uint32_t num_ticks, void* userdata);
+
+// Returns the streamline seeds, generating them from the seed viewport and
+// spacing if they do not exist yet. The returned array is owned by the context,
+// but it can be copied into other contexts with parsl_set_streamline_seeds to
+// avoid generating the same Poisson disk distribution repeatedly.
+parsl_position const* parsl_get_streamline_seeds(parsl_context* context,
+    uint32_t* num_seeds);
+
+// Replaces the streamline seeds with a client-provided distribution, such as a
+// cached copy from another context or the output of par_bluenoise. Any retained
+// particles from parsl_mesh_from_streamlines_advance are discarded.
+void parsl_set_streamline_seeds(parsl_context* context,
+    parsl_position const* seeds, uint32_t num_seeds);
+
 // High-level function that tessellates a series of curves into triangles,
 // where each spine is a series of chained cubic Bézier curves.
 //
@@ -148,6 +211,66 @@ parsl_mesh* parsl_mesh_from_curves_cubic(parsl_context* context,
 parsl_mesh* parsl_mesh_from_curves_quadratic(parsl_context* context,
     parsl_spine_list spines);
 
+// Variants of the above functions that accept 32-bit spine counts and lengths.
+parsl_mesh* parsl_mesh_from_lines32(parsl_context* context,
+    parsl_spine_list32 spines);
+parsl_mesh* parsl_mesh_from_curves_cubic32(parsl_context* context,
+    parsl_spine_list32 spines);
+parsl_mesh* parsl_mesh_from_curves_quadratic32(parsl_context* context,
+    parsl_spine_list32 spines);
+
+// Client-owned memory that receives generated meshes, such as a mapped GPU
+// buffer. Attributes can be interleaved by pointing them into the same buffer
+// and specifying a stride in bytes, where zero means tightly packed. Optional
+// attributes are written only if their flags are set and their pointers are
+// non-null. When indices_16bit is set, each index is written as a uint16_t,
+// which limits the mesh to 65536 vertices.
+typedef struct {
+    void* positions;
+    uint32_t positions_stride;
+    void* annotations;
+    uint32_t annotations_stride;
+    void* spine_lengths;
+    uint32_t spine_lengths_stride;
+    void* random_offsets;
+    uint32_t random_offsets_stride;
+    void* triangle_indices;
+    bool indices_16bit;
+    uint32_t max_vertices;
+    uint32_t max_indices;
+} parsl_output;
+
+// Makes all subsequent calls tessellate directly into client-owned buffers, or
+// back into the context if output is null. The descriptor is copied. While an
+// output is set, the returned mesh has null pointers and only reports counts,
+// and null is returned if the mesh does not fit into max_vertices, max_indices,
+// or 16-bit indices.
+void parsl_set_output(parsl_context* context, parsl_output const* output);
+
+// Range of the result mesh that was rewritten by parsl_update_spine, which
+// allows clients to upload only a portion of their GPU buffers. The index
+// range counts elements of triangle_indices rather than triangles.
+typedef struct {
+    uint32_t first_vertex;
+    uint32_t num_vertices;
+    uint32_t first_index;
+    uint32_t num_indices;
+} parsl_dirty_range;
+
+// Tessellates line strips like parsl_mesh_from_lines32, but also retains a
+// copy of the spines in the context so that they can be edited individually.
+parsl_mesh* parsl_mesh_from_spine_set(parsl_context* context,
+    parsl_spine_list32 spines);
+
+// Replaces the vertices of a single spine in the retained spine set and
+// re-tessellates only what has changed. If the spine keeps its length, only its
+// own vertex and index ranges are rewritten. Otherwise all subsequent spines
+// move, and the dirty range extends to the end of the mesh. If another call
+// has overwritten the mesh in the meantime, the entire set is re-tessellated.
+parsl_mesh* parsl_update_spine(parsl_context* context, uint32_t spine,
+    parsl_position const* vertices, uint32_t spine_length,
+    parsl_dirty_range* dirty);
+
 #ifdef __cplusplus
 }
 #endif
@@ -179,7 +302,14 @@ static parsl_position parsl_mul(parsl_position v, float s) {
     return (parsl_position) { v.x * s, v.y * s };
 }
 
-#define PARSL_MAX_RECURSION 16
+#define PARSL_MAX_CURVE_SEGMENTS 4096
+
+// When compiled with OpenMP, spines are tessellated across multiple threads.
+#ifdef _OPENMP
+#define PARSL__PARALLEL_FOR _Pragma("omp parallel for")
+#else
+#define PARSL__PARALLEL_FOR
+#endif
 
 #ifndef PAR_PI
 #define PAR_PI (3.14159265359)
@@ -235,14 +365,34 @@ static void* pa___growf(void* arr, int increment, int itemsize)
 
 #endif
 
+// Particle coordinates in structure-of-arrays form.
+typedef struct {
+    float* x;
+    float* y;
+} parsl__particles;
+
 struct parsl_context_s {
     parsl_config config;
     parsl_mesh result;
     parsl_position* streamline_seeds;
-    parsl_position* streamline_points;
-    parsl_spine_list streamline_spines;
-    parsl_spine_list curve_spines;
-    uint16_t guideline_start;
+    parsl__particles streamline_points;
+    parsl__particles streamline_particles;
+    parsl_position* streamline_history;
+    uint32_t streamline_tick;
+    uint32_t streamline_window;
+    uint32_t streamline_head;
+    parsl_spine_list32 streamline_spines;
+    parsl_spine_list32 curve_spines;
+    uint32_t* wide_spine_lengths;
+    uint32_t guideline_start;
+    uint32_t* spine_offsets;
+    parsl_spine_list32 spine_set;
+    bool spine_set_valid;
+    parsl_spine_list32 lod_spines;
+    parsl_output client_output;
+    bool has_client_output;
+    parsl_mesh client_mesh;
+    parsl_output sink;
 };
 
 parsl_context* parsl_create_context(parsl_config config)
@@ -260,263 +410,326 @@ void parsl_destroy_context(parsl_context* context)
     pa_free(context->result.positions);
     pa_free(context->result.random_offsets);
     pa_free(context->streamline_seeds);
-    pa_free(context->streamline_points);
+    pa_free(context->streamline_points.x);
+    pa_free(context->streamline_points.y);
+    pa_free(context->streamline_particles.x);
+    pa_free(context->streamline_particles.y);
+    pa_free(context->streamline_history);
     pa_free(context->streamline_spines.spine_lengths);
     pa_free(context->streamline_spines.vertices);
     pa_free(context->curve_spines.spine_lengths);
     pa_free(context->curve_spines.vertices);
+    pa_free(context->spine_offsets);
+    pa_free(context->wide_spine_lengths);
+    pa_free(context->spine_set.spine_lengths);
+    pa_free(context->spine_set.vertices);
+    pa_free(context->lod_spines.spine_lengths);
+    pa_free(context->lod_spines.vertices);
     PAR_FREE(context);
 }
 
-parsl_mesh* parsl_mesh_from_lines(parsl_context* context,
-    parsl_spine_list spines)
+void parsl_set_output(parsl_context* context, parsl_output const* output)
+{
+    context->has_client_output = output != NULL;
+    if (output) {
+        context->client_output = *output;
+    }
+    context->spine_set_valid = false;
+}
+
+// Returns the address of an element within one of the strided sink arrays.
+#define PARSL__ELEMENT(T, sink, array, i) ((T*) ((uint8_t*) (sink)->array + \
+    (size_t) (i) * (sink)->array##_stride))
+#define PARSL__POSITION(i) PARSL__ELEMENT(parsl_position, sink, positions, i)
+#define PARSL__ANNOTATION(i) \
+    PARSL__ELEMENT(parsl_annotation, sink, annotations, i)
+#define PARSL__LENGTH(i) PARSL__ELEMENT(float, sink, spine_lengths, i)
+#define PARSL__RANDOM(i) PARSL__ELEMENT(float, sink, random_offsets, i)
+
+// Copies indices into the sink, narrowing them if necessary. Returns the
+// position that follows the last index written.
+static uint32_t parsl__write_indices(parsl_output const* sink, uint32_t first,
+    uint32_t const* indices, uint32_t count)
+{
+    if (sink->indices_16bit) {
+        uint16_t* dst = (uint16_t*) sink->triangle_indices + first;
+        for (uint32_t i = 0; i < count; i++) {
+            dst[i] = (uint16_t) indices[i];
+        }
+    } else {
+        memcpy((uint32_t*) sink->triangle_indices + first, indices,
+            count * sizeof(uint32_t));
+    }
+    return first + count;
+}
+
+// Tessellates a single spine into its own ranges of the output arrays, which
+// makes it safe to process many spines concurrently.
+static void parsl__tessellate_spine(parsl_context const* context,
+    parsl_spine_list32 spines, uint32_t spine,
+    const parsl_position* src_position, uint32_t first_vertex,
+    uint32_t first_index)
 {
     typedef parsl_position Position;
-    typedef parsl_annotation Annotation;
+    parsl_output const* sink = &context->sink;
+    const uint32_t base_index = first_vertex;
+    uint32_t dst_vertex = first_vertex;
+    uint32_t dst_annotation = first_vertex;
+    uint32_t dst_length = first_vertex;
+    uint32_t dst_index = first_index;
+    uint32_t dst_indices[8];
 
-    parsl_mesh* mesh = &context->result;
     const bool closed = spines.closed;
     const bool wireframe = context->config.flags & PARSL_FLAG_WIREFRAME;
-    const bool has_annotations = context->config.flags & PARSL_FLAG_ANNOTATIONS;
-    const bool has_lengths = context->config.flags & PARSL_FLAG_SPINE_LENGTHS;
+    const bool has_annotations = sink->annotations != NULL;
+    const bool has_lengths = sink->spine_lengths != NULL;
     const float miter_limit = context->config.miter_limit ?
         context->config.miter_limit : (context->config.thickness * 2);
     const float miter_acos_max = +1.0;
     const float miter_acos_min = -1.0;
-    const uint32_t ind_per_tri = wireframe ? 4 : 3;
-
-    mesh->num_vertices = 0;
-    mesh->num_triangles = 0;
 
-    for (uint32_t spine = 0; spine < spines.num_spines; spine++) {
-        assert(spines.spine_lengths[spine] > 1);
-        mesh->num_vertices += 2 * spines.spine_lengths[spine];
-        mesh->num_triangles += 2 * (spines.spine_lengths[spine] - 1);
-        if (closed) {
-            mesh->num_vertices += 2;
-            mesh->num_triangles += 2;
+    const bool thin = context->guideline_start > 0 &&
+        spine >= context->guideline_start;
+    const float thickness = thin ? 1.0f : context->config.thickness;
+    const uint32_t spine_length = spines.spine_lengths[spine];
+    float dx = src_position[1].x - src_position[0].x;
+    float dy = src_position[1].y - src_position[0].y;
+    float segment_length = sqrtf(dx * dx + dy * dy);
+    float invlen = segment_length ? 1.0f / segment_length : 0.0f;
+    const float nx = -dy * invlen;
+    const float ny = dx * invlen;
+
+    const Position first_src_position = src_position[0];
+    const Position last_src_position = src_position[spine_length - 1];
+
+    float ex = nx * thickness / 2;
+    float ey = ny * thickness / 2;
+
+    if (closed) {
+        const float dx = src_position[0].x - last_src_position.x;
+        const float dy = src_position[0].y - last_src_position.y;
+        const float segment_length = sqrtf(dx * dx + dy * dy);
+        float invlen = segment_length ? 1.0f / segment_length : 0.0f;
+        const float pnx = -dy * invlen;
+        const float pny = dx * invlen;
+
+        // NOTE: sin(pi / 2 - acos(X) / 2) == sqrt(1 + X) / sqrt(2)
+        float extent = 0.5 * thickness;
+        const float dotp = (pnx * nx + pny * ny);
+        if (dotp < miter_acos_max && dotp > miter_acos_min) {
+            const float phi = acos(dotp) / 2;
+            const float theta = PAR_PI / 2 - phi;
+            extent = PAR_CLAMP(extent / sin(theta), -miter_limit,
+                miter_limit);
         }
+
+        ex = pnx + nx;
+        ey = pny + ny;
+        const float len = sqrtf(ex * ex + ey * ey);
+        invlen = len == 0.0 ? 0.0 : (1.0f / len);
+        ex *= invlen * extent;
+        ey *= invlen * extent;
     }
 
-    pa_clear(mesh->spine_lengths);
-    pa_clear(mesh->annotations);
-    pa_clear(mesh->positions);
-    pa_clear(mesh->triangle_indices);
+    PARSL__POSITION(dst_vertex)->x = src_position[0].x + ex;
+    PARSL__POSITION(dst_vertex)->y = src_position[0].y + ey;
+    PARSL__POSITION(dst_vertex + 1)->x = src_position[0].x - ex;
+    PARSL__POSITION(dst_vertex + 1)->y = src_position[0].y - ey;
+
+    float pnx = nx;
+    float pny = ny;
+
+    const Position first_dst_positions[2] = {
+        *PARSL__POSITION(dst_vertex),
+        *PARSL__POSITION(dst_vertex + 1)
+    };
+
+    src_position++;
+    dst_vertex += 2;
 
-    if (has_lengths) {
-        pa_add(mesh->spine_lengths, mesh->num_vertices);
-    }
     if (has_annotations) {
-        pa_add(mesh->annotations, mesh->num_vertices);
+        PARSL__ANNOTATION(dst_annotation)->u_along_curve = 0;
+        PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve = 0;
+        PARSL__ANNOTATION(dst_annotation)->v_across_curve = 1;
+        PARSL__ANNOTATION(dst_annotation + 1)->v_across_curve = -1;
+        PARSL__ANNOTATION(dst_annotation)->spine_to_edge_x = ex;
+        PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_x = -ex;
+        PARSL__ANNOTATION(dst_annotation)->spine_to_edge_y = ey;
+        PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_y = -ey;
+        dst_annotation += 2;
     }
 
-    pa_add(mesh->positions, mesh->num_vertices);
-    pa_add(mesh->triangle_indices, ind_per_tri * mesh->num_triangles);
+    float distance_along_spine = segment_length;
 
-    float* dst_lengths = mesh->spine_lengths;
-    Annotation* dst_annotations = mesh->annotations;
-    Position* dst_positions = mesh->positions;
-    uint32_t* dst_indices = mesh->triangle_indices;
-
-    const Position* src_position = spines.vertices;
-    uint32_t base_index = 0;
-
-    for (uint16_t spine = 0; spine < spines.num_spines; spine++) {
-        const bool thin = context->guideline_start > 0 &&
-            spine >= context->guideline_start;
-        const float thickness = thin ? 1.0f : context->config.thickness;
-        const uint16_t spine_length = spines.spine_lengths[spine];
-        float dx = src_position[1].x - src_position[0].x;
-        float dy = src_position[1].y - src_position[0].y;
-        float segment_length = sqrtf(dx * dx + dy * dy);
+    uint32_t segment_index = 1;
+    for (; segment_index < spine_length - 1; segment_index++) {
+
+        const float dx = src_position[1].x - src_position[0].x;
+        const float dy = src_position[1].y - src_position[0].y;
+        const float segment_length = sqrtf(dx * dx + dy * dy);
         float invlen = segment_length ? 1.0f / segment_length : 0.0f;
         const float nx = -dy * invlen;
         const float ny = dx * invlen;
 
-        const Position first_src_position = src_position[0];
-        const Position last_src_position = src_position[spine_length - 1];
+        // NOTE: sin(pi / 2 - acos(X) / 2) == sqrt(1 + X) / sqrt(2)
+        float extent = 0.5 * thickness;
+        const float dotp = (pnx * nx + pny * ny);
+        if (dotp < miter_acos_max && dotp > miter_acos_min) {
+            const float phi = acos(dotp) / 2;
+            const float theta = PAR_PI / 2 - phi;
+            extent = PAR_CLAMP(extent / sin(theta), -miter_limit,
+                miter_limit);
+        }
 
-        float ex = nx * thickness / 2;
-        float ey = ny * thickness / 2;
+        float ex = pnx + nx;
+        float ey = pny + ny;
+        const float len = sqrtf(ex * ex + ey * ey);
+        invlen = len == 0.0 ? 0.0 : (1.0f / len);
+        ex *= invlen * extent;
+        ey *= invlen * extent;
+
+        PARSL__POSITION(dst_vertex)->x = src_position[0].x + ex;
+        PARSL__POSITION(dst_vertex)->y = src_position[0].y + ey;
+        PARSL__POSITION(dst_vertex + 1)->x = src_position[0].x - ex;
+        PARSL__POSITION(dst_vertex + 1)->y = src_position[0].y - ey;
+        src_position++;
+        dst_vertex += 2;
 
-        if (closed) {
-            const float dx = src_position[0].x - last_src_position.x;
-            const float dy = src_position[0].y - last_src_position.y;
-            const float segment_length = sqrtf(dx * dx + dy * dy);
-            float invlen = segment_length ? 1.0f / segment_length : 0.0f;
-            const float pnx = -dy * invlen;
-            const float pny = dx * invlen;
-
-            // NOTE: sin(pi / 2 - acos(X) / 2) == sqrt(1 + X) / sqrt(2)
-            float extent = 0.5 * thickness;
-            const float dotp = (pnx * nx + pny * ny);
-            if (dotp < miter_acos_max && dotp > miter_acos_min) {
-                const float phi = acos(dotp) / 2;
-                const float theta = PAR_PI / 2 - phi;
-                extent = PAR_CLAMP(extent / sin(theta), -miter_limit,
-                    miter_limit);
-            }
+        pnx = nx;
+        pny = ny;
 
-            ex = pnx + nx;
-            ey = pny + ny;
-            const float len = sqrtf(ex * ex + ey * ey);
-            invlen = len == 0.0 ? 0.0 : (1.0f / len);
-            ex *= invlen * extent;
-            ey *= invlen * extent;
+        if (has_annotations) {
+            PARSL__ANNOTATION(dst_annotation)->u_along_curve =
+                distance_along_spine;
+            PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve =
+                distance_along_spine;
+            PARSL__ANNOTATION(dst_annotation)->v_across_curve = 1;
+            PARSL__ANNOTATION(dst_annotation + 1)->v_across_curve = -1;
+            PARSL__ANNOTATION(dst_annotation)->spine_to_edge_x = ex;
+            PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_x = -ex;
+            PARSL__ANNOTATION(dst_annotation)->spine_to_edge_y = ey;
+            PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_y = -ey;
+            dst_annotation += 2;
         }
+        distance_along_spine += segment_length;
 
-        dst_positions[0].x = src_position[0].x + ex;
-        dst_positions[0].y = src_position[0].y + ey;
-        dst_positions[1].x = src_position[0].x - ex;
-        dst_positions[1].y = src_position[0].y - ey;
+        if (wireframe) {
+            dst_indices[0] = base_index + (segment_index - 1) * 2;
+            dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
+            dst_indices[2] = base_index + (segment_index - 0) * 2;
+            dst_indices[3] = base_index + (segment_index - 1) * 2;
 
-        float pnx = nx;
-        float pny = ny;
+            dst_indices[4] = base_index + (segment_index - 0) * 2;
+            dst_indices[5] = base_index + (segment_index - 1) * 2 + 1;
+            dst_indices[6] = base_index + (segment_index - 0) * 2 + 1;
+            dst_indices[7] = base_index + (segment_index - 0) * 2;
+            dst_index = parsl__write_indices(sink, dst_index, dst_indices, 8);
+        } else {
+            dst_indices[0] = base_index + (segment_index - 1) * 2;
+            dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
+            dst_indices[2] = base_index + (segment_index - 0) * 2;
 
-        const Position first_dst_positions[2] = {
-            dst_positions[0],
-            dst_positions[1]
-        };
+            dst_indices[3] = base_index + (segment_index - 0) * 2;
+            dst_indices[4] = base_index + (segment_index - 1) * 2 + 1;
+            dst_indices[5] = base_index + (segment_index - 0) * 2 + 1;
+            dst_index = parsl__write_indices(sink, dst_index, dst_indices, 6);
+        }
+    }
 
-        src_position++;
-        dst_positions += 2;
+    ex = pnx * thickness / 2;
+    ey = pny * thickness / 2;
 
-        if (has_annotations) {
-            dst_annotations[0].u_along_curve = 0;
-            dst_annotations[1].u_along_curve = 0;
-            dst_annotations[0].v_across_curve = 1;
-            dst_annotations[1].v_across_curve = -1;
-            dst_annotations[0].spine_to_edge_x = ex;
-            dst_annotations[1].spine_to_edge_x = -ex;
-            dst_annotations[0].spine_to_edge_y = ey;
-            dst_annotations[1].spine_to_edge_y = -ey;
-            dst_annotations += 2;
+    if (closed) {
+        const float dx = first_src_position.x - src_position[0].x;
+        const float dy = first_src_position.y - src_position[0].y;
+        segment_length = sqrtf(dx * dx + dy * dy);
+        float invlen = segment_length ? 1.0f / segment_length : 0.0f;
+        const float nx = -dy * invlen;
+        const float ny = dx * invlen;
+
+        // NOTE: sin(pi / 2 - acos(X) / 2) == sqrt(1 + X) / sqrt(2)
+        float extent = 0.5 * thickness;
+        const float dotp = (pnx * nx + pny * ny);
+        if (dotp < miter_acos_max && dotp > miter_acos_min) {
+            const float phi = acos(dotp) / 2;
+            const float theta = PAR_PI / 2 - phi;
+            extent = PAR_CLAMP(extent / sin(theta), -miter_limit,
+                miter_limit);
         }
 
-        float distance_along_spine = segment_length;
-
-        uint16_t segment_index = 1;
-        for (; segment_index < spine_length - 1; segment_index++) {
-
-            const float dx = src_position[1].x - src_position[0].x;
-            const float dy = src_position[1].y - src_position[0].y;
-            const float segment_length = sqrtf(dx * dx + dy * dy);
-            float invlen = segment_length ? 1.0f / segment_length : 0.0f;
-            const float nx = -dy * invlen;
-            const float ny = dx * invlen;
-
-            // NOTE: sin(pi / 2 - acos(X) / 2) == sqrt(1 + X) / sqrt(2)
-            float extent = 0.5 * thickness;
-            const float dotp = (pnx * nx + pny * ny);
-            if (dotp < miter_acos_max && dotp > miter_acos_min) {
-                const float phi = acos(dotp) / 2;
-                const float theta = PAR_PI / 2 - phi;
-                extent = PAR_CLAMP(extent / sin(theta), -miter_limit,
-                    miter_limit);
-            }
+        ex = pnx + nx;
+        ey = pny + ny;
+        const float len = sqrtf(ex * ex + ey * ey);
+        invlen = len == 0.0 ? 0.0 : (1.0f / len);
+        ex *= invlen * extent;
+        ey *= invlen * extent;
+    }
 
-            float ex = pnx + nx;
-            float ey = pny + ny;
-            const float len = sqrtf(ex * ex + ey * ey);
-            invlen = len == 0.0 ? 0.0 : (1.0f / len);
-            ex *= invlen * extent;
-            ey *= invlen * extent;
-
-            dst_positions[0].x = src_position[0].x + ex;
-            dst_positions[0].y = src_position[0].y + ey;
-            dst_positions[1].x = src_position[0].x - ex;
-            dst_positions[1].y = src_position[0].y - ey;
-            src_position++;
-            dst_positions += 2;
-
-            pnx = nx;
-            pny = ny;
-
-            if (has_annotations) {
-                dst_annotations[0].u_along_curve = distance_along_spine;
-                dst_annotations[1].u_along_curve = distance_along_spine;
-                dst_annotations[0].v_across_curve = 1;
-                dst_annotations[1].v_across_curve = -1;
-                dst_annotations[0].spine_to_edge_x = ex;
-                dst_annotations[1].spine_to_edge_x = -ex;
-                dst_annotations[0].spine_to_edge_y = ey;
-                dst_annotations[1].spine_to_edge_y = -ey;
-                dst_annotations += 2;
-            }
-            distance_along_spine += segment_length;
-
-            if (wireframe) {
-                dst_indices[0] = base_index + (segment_index - 1) * 2;
-                dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[2] = base_index + (segment_index - 0) * 2;
-                dst_indices[3] = base_index + (segment_index - 1) * 2;
-
-                dst_indices[4] = base_index + (segment_index - 0) * 2;
-                dst_indices[5] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[6] = base_index + (segment_index - 0) * 2 + 1;
-                dst_indices[7] = base_index + (segment_index - 0) * 2;
-                dst_indices += 8;
-            } else {
-                dst_indices[0] = base_index + (segment_index - 1) * 2;
-                dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[2] = base_index + (segment_index - 0) * 2;
-
-                dst_indices[3] = base_index + (segment_index - 0) * 2;
-                dst_indices[4] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[5] = base_index + (segment_index - 0) * 2 + 1;
-                dst_indices += 6;
-            }
-        }
+    PARSL__POSITION(dst_vertex)->x = src_position[0].x + ex;
+    PARSL__POSITION(dst_vertex)->y = src_position[0].y + ey;
+    PARSL__POSITION(dst_vertex + 1)->x = src_position[0].x - ex;
+    PARSL__POSITION(dst_vertex + 1)->y = src_position[0].y - ey;
+    src_position++;
+    dst_vertex += 2;
 
-        ex = pnx * thickness / 2;
-        ey = pny * thickness / 2;
+    pnx = nx;
+    pny = ny;
 
-        if (closed) {
-            const float dx = first_src_position.x - src_position[0].x;
-            const float dy = first_src_position.y - src_position[0].y;
-            segment_length = sqrtf(dx * dx + dy * dy);
-            float invlen = segment_length ? 1.0f / segment_length : 0.0f;
-            const float nx = -dy * invlen;
-            const float ny = dx * invlen;
-
-            // NOTE: sin(pi / 2 - acos(X) / 2) == sqrt(1 + X) / sqrt(2)
-            float extent = 0.5 * thickness;
-            const float dotp = (pnx * nx + pny * ny);
-            if (dotp < miter_acos_max && dotp > miter_acos_min) {
-                const float phi = acos(dotp) / 2;
-                const float theta = PAR_PI / 2 - phi;
-                extent = PAR_CLAMP(extent / sin(theta), -miter_limit,
-                    miter_limit);
-            }
+    if (has_annotations) {
+        PARSL__ANNOTATION(dst_annotation)->u_along_curve = distance_along_spine;
+        PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve =
+            distance_along_spine;
+        PARSL__ANNOTATION(dst_annotation)->v_across_curve = 1;
+        PARSL__ANNOTATION(dst_annotation + 1)->v_across_curve = -1;
+        PARSL__ANNOTATION(dst_annotation)->spine_to_edge_x = ex;
+        PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_x = -ex;
+        PARSL__ANNOTATION(dst_annotation)->spine_to_edge_y = ey;
+        PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_y = -ey;
+        dst_annotation += 2;
+    }
 
-            ex = pnx + nx;
-            ey = pny + ny;
-            const float len = sqrtf(ex * ex + ey * ey);
-            invlen = len == 0.0 ? 0.0 : (1.0f / len);
-            ex *= invlen * extent;
-            ey *= invlen * extent;
-        }
+    if (wireframe) {
+        dst_indices[0] = base_index + (segment_index - 1) * 2;
+        dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
+        dst_indices[2] = base_index + (segment_index - 0) * 2;
+        dst_indices[3] = base_index + (segment_index - 1) * 2;
+
+        dst_indices[4] = base_index + (segment_index - 0) * 2;
+        dst_indices[5] = base_index + (segment_index - 1) * 2 + 1;
+        dst_indices[6] = base_index + (segment_index - 0) * 2 + 1;
+        dst_indices[7] = base_index + (segment_index - 0) * 2;
+        dst_index = parsl__write_indices(sink, dst_index, dst_indices, 8);
+    } else {
+        dst_indices[0] = base_index + (segment_index - 1) * 2;
+        dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
+        dst_indices[2] = base_index + (segment_index - 0) * 2;
+
+        dst_indices[3] = base_index + (segment_index - 0) * 2;
+        dst_indices[4] = base_index + (segment_index - 1) * 2 + 1;
+        dst_indices[5] = base_index + (segment_index - 0) * 2 + 1;
+        dst_index = parsl__write_indices(sink, dst_index, dst_indices, 6);
+    }
 
-        dst_positions[0].x = src_position[0].x + ex;
-        dst_positions[0].y = src_position[0].y + ey;
-        dst_positions[1].x = src_position[0].x - ex;
-        dst_positions[1].y = src_position[0].y - ey;
-        src_position++;
-        dst_positions += 2;
+    if (closed) {
+        segment_index++;
+        distance_along_spine += segment_length;
 
-        pnx = nx;
-        pny = ny;
+        *PARSL__POSITION(dst_vertex) = first_dst_positions[0];
+        *PARSL__POSITION(dst_vertex + 1) = first_dst_positions[1];
+        dst_vertex += 2;
 
         if (has_annotations) {
-            dst_annotations[0].u_along_curve = distance_along_spine;
-            dst_annotations[1].u_along_curve = distance_along_spine;
-            dst_annotations[0].v_across_curve = 1;
-            dst_annotations[1].v_across_curve = -1;
-            dst_annotations[0].spine_to_edge_x = ex;
-            dst_annotations[1].spine_to_edge_x = -ex;
-            dst_annotations[0].spine_to_edge_y = ey;
-            dst_annotations[1].spine_to_edge_y = -ey;
-            dst_annotations += 2;
+            PARSL__ANNOTATION(dst_annotation)->u_along_curve =
+                distance_along_spine;
+            PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve =
+                distance_along_spine;
+            PARSL__ANNOTATION(dst_annotation)->v_across_curve = 1;
+            PARSL__ANNOTATION(dst_annotation + 1)->v_across_curve = -1;
+            PARSL__ANNOTATION(dst_annotation)->spine_to_edge_x = ex;
+            PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_x = -ex;
+            PARSL__ANNOTATION(dst_annotation)->spine_to_edge_y = ey;
+            PARSL__ANNOTATION(dst_annotation + 1)->spine_to_edge_y = -ey;
+            dst_annotation += 2;
         }
 
         if (wireframe) {
@@ -529,7 +742,7 @@ parsl_mesh* parsl_mesh_from_lines(parsl_context* context,
             dst_indices[5] = base_index + (segment_index - 1) * 2 + 1;
             dst_indices[6] = base_index + (segment_index - 0) * 2 + 1;
             dst_indices[7] = base_index + (segment_index - 0) * 2;
-            dst_indices += 8;
+            dst_index = parsl__write_indices(sink, dst_index, dst_indices, 8);
         } else {
             dst_indices[0] = base_index + (segment_index - 1) * 2;
             dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
@@ -538,503 +751,766 @@ parsl_mesh* parsl_mesh_from_lines(parsl_context* context,
             dst_indices[3] = base_index + (segment_index - 0) * 2;
             dst_indices[4] = base_index + (segment_index - 1) * 2 + 1;
             dst_indices[5] = base_index + (segment_index - 0) * 2 + 1;
-            dst_indices += 6;
+            dst_index = parsl__write_indices(sink, dst_index, dst_indices, 6);
         }
+    }
 
-        if (closed) {
-            segment_index++;
-            distance_along_spine += segment_length;
-
-            dst_positions[0] = first_dst_positions[0];
-            dst_positions[1] = first_dst_positions[1];
-            dst_positions += 2;
-
-            if (has_annotations) {
-                dst_annotations[0].u_along_curve = distance_along_spine;
-                dst_annotations[1].u_along_curve = distance_along_spine;
-                dst_annotations[0].v_across_curve = 1;
-                dst_annotations[1].v_across_curve = -1;
-                dst_annotations[0].spine_to_edge_x = ex;
-                dst_annotations[1].spine_to_edge_x = -ex;
-                dst_annotations[0].spine_to_edge_y = ey;
-                dst_annotations[1].spine_to_edge_y = -ey;
-                dst_annotations += 2;
-            }
 
-            if (wireframe) {
-                dst_indices[0] = base_index + (segment_index - 1) * 2;
-                dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[2] = base_index + (segment_index - 0) * 2;
-                dst_indices[3] = base_index + (segment_index - 1) * 2;
-
-                dst_indices[4] = base_index + (segment_index - 0) * 2;
-                dst_indices[5] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[6] = base_index + (segment_index - 0) * 2 + 1;
-                dst_indices[7] = base_index + (segment_index - 0) * 2;
-                dst_indices += 8;
-            } else {
-                dst_indices[0] = base_index + (segment_index - 1) * 2;
-                dst_indices[1] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[2] = base_index + (segment_index - 0) * 2;
-
-                dst_indices[3] = base_index + (segment_index - 0) * 2;
-                dst_indices[4] = base_index + (segment_index - 1) * 2 + 1;
-                dst_indices[5] = base_index + (segment_index - 0) * 2 + 1;
-                dst_indices += 6;
+    const uint32_t nverts = spine_length + (closed ? 1 : 0);
+
+    if (has_lengths) {
+        for (uint32_t i = 0; i < nverts; i++) {
+            *PARSL__LENGTH(dst_length) = distance_along_spine;
+            *PARSL__LENGTH(dst_length + 1) = distance_along_spine;
+            dst_length += 2;
+        }
+    }
+
+    // Go back through the curve and fix up the U coordinates.
+    if (has_annotations) {
+        const float invlength = 1.0f / distance_along_spine;
+        const float invcount = 1.0f / spine_length;
+        switch (context->config.u_mode) {
+        case PAR_U_MODE_DISTANCE:
+            break;
+        case PAR_U_MODE_NORMALIZED_DISTANCE:
+            dst_annotation -= nverts * 2;
+            for (uint32_t i = 0; i < nverts; i++) {
+                PARSL__ANNOTATION(dst_annotation)->u_along_curve *= invlength;
+                PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve *=
+                    invlength;
+                dst_annotation += 2;
+            }
+            break;
+        case PAR_U_MODE_SEGMENT_INDEX:
+            dst_annotation -= nverts * 2;
+            for (uint32_t i = 0; i < nverts; i++) {
+                PARSL__ANNOTATION(dst_annotation)->u_along_curve = i;
+                PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve = i;
+                dst_annotation += 2;
             }
+            break;
+        case PAR_U_MODE_SEGMENT_FRACTION:
+            dst_annotation -= nverts * 2;
+            for (uint32_t i = 0; i < nverts; i++) {
+                PARSL__ANNOTATION(dst_annotation)->u_along_curve = invcount * i;
+                PARSL__ANNOTATION(dst_annotation + 1)->u_along_curve =
+                    invcount * i;
+                dst_annotation += 2;
+            }
+            break;
         }
+    }
+}
 
-        base_index += spine_length * 2 + (closed ? 2  : 0);
+// Copies 16-bit spine lengths into a 32-bit list owned by the context.
+static parsl_spine_list32 parsl__widen_spines(parsl_context* context,
+    parsl_spine_list spines)
+{
+    pa_clear(context->wide_spine_lengths);
+    pa_add(context->wide_spine_lengths, spines.num_spines);
+    for (uint32_t spine = 0; spine < spines.num_spines; spine++) {
+        context->wide_spine_lengths[spine] = spines.spine_lengths[spine];
+    }
+    return (parsl_spine_list32) {
+        .num_vertices = spines.num_vertices,
+        .num_spines = spines.num_spines,
+        .vertices = spines.vertices,
+        .spine_lengths = context->wide_spine_lengths,
+        .closed = spines.closed,
+    };
+}
 
-        const uint16_t nverts = spine_length + (closed ? 1 : 0);
+parsl_mesh* parsl_mesh_from_lines(parsl_context* context,
+    parsl_spine_list spines)
+{
+    return parsl_mesh_from_lines32(context,
+        parsl__widen_spines(context, spines));
+}
 
-        if (has_lengths) {
-            for (uint16_t i = 0; i < nverts; i++) {
-                dst_lengths[0] = distance_along_spine;
-                dst_lengths[1] = distance_along_spine;
-                dst_lengths += 2;
-            }
+// Points the sink at either the client output or the result arrays, leaving out
+// any attributes that are disabled.
+static void parsl__init_sink(parsl_context* context)
+{
+    parsl_mesh* mesh = &context->result;
+    parsl_output* sink = &context->sink;
+    const uint32_t flags = context->config.flags;
+    if (context->has_client_output) {
+        *sink = context->client_output;
+    } else {
+        *sink = (parsl_output) {
+            .positions = mesh->positions,
+            .annotations = mesh->annotations,
+            .spine_lengths = mesh->spine_lengths,
+            .random_offsets = mesh->random_offsets,
+            .triangle_indices = mesh->triangle_indices,
+        };
+    }
+    if (!(flags & PARSL_FLAG_ANNOTATIONS)) {
+        sink->annotations = NULL;
+    }
+    if (!(flags & PARSL_FLAG_SPINE_LENGTHS)) {
+        sink->spine_lengths = NULL;
+    }
+    if (!(flags & PARSL_FLAG_RANDOM_OFFSETS)) {
+        sink->random_offsets = NULL;
+    }
+    if (!sink->positions_stride) {
+        sink->positions_stride = sizeof(parsl_position);
+    }
+    if (!sink->annotations_stride) {
+        sink->annotations_stride = sizeof(parsl_annotation);
+    }
+    if (!sink->spine_lengths_stride) {
+        sink->spine_lengths_stride = sizeof(float);
+    }
+    if (!sink->random_offsets_stride) {
+        sink->random_offsets_stride = sizeof(float);
+    }
+    assert(sink->positions && sink->triangle_indices);
+}
+
+// Prefix-sums the source and destination vertex counts, which determines where
+// each spine reads and writes, and then resizes the result arrays. Each spine
+// emits two fewer triangles than vertices, so the index offsets can be derived
+// from these. Existing content in the result arrays is preserved. Returns false
+// if the mesh does not fit into the client output.
+static bool parsl__layout_spines(parsl_context* context,
+    parsl_spine_list32 spines)
+{
+    parsl_mesh* mesh = &context->result;
+    const bool closed = spines.closed;
+    const bool wireframe = context->config.flags & PARSL_FLAG_WIREFRAME;
+    const bool has_annotations = context->config.flags & PARSL_FLAG_ANNOTATIONS;
+    const bool has_lengths = context->config.flags & PARSL_FLAG_SPINE_LENGTHS;
+    const bool has_random = context->config.flags & PARSL_FLAG_RANDOM_OFFSETS;
+    const uint32_t ind_per_tri = wireframe ? 4 : 3;
+    const uint32_t num_spines = spines.num_spines;
+
+    mesh->num_vertices = 0;
+    mesh->num_triangles = 0;
+
+    pa_clear(context->spine_offsets);
+    pa_add(context->spine_offsets, 2 * num_spines);
+    uint32_t* src_offsets = context->spine_offsets;
+    uint32_t* dst_offsets = context->spine_offsets + num_spines;
+    uint32_t num_src_vertices = 0;
+
+    for (uint32_t spine = 0; spine < num_spines; spine++) {
+        assert(spines.spine_lengths[spine] > 1);
+        src_offsets[spine] = num_src_vertices;
+        dst_offsets[spine] = mesh->num_vertices;
+        num_src_vertices += spines.spine_lengths[spine];
+        mesh->num_vertices += 2 * spines.spine_lengths[spine];
+        mesh->num_triangles += 2 * (spines.spine_lengths[spine] - 1);
+        if (closed) {
+            mesh->num_vertices += 2;
+            mesh->num_triangles += 2;
         }
+    }
 
-        // Go back through the curve and fix up the U coordinates.
-        if (has_annotations) {
-            const float invlength = 1.0f / distance_along_spine;
-            const float invcount = 1.0f / spine_length;
-            switch (context->config.u_mode) {
-            case PAR_U_MODE_DISTANCE:
-                break;
-            case PAR_U_MODE_NORMALIZED_DISTANCE:
-                dst_annotations -= nverts * 2;
-                for (uint16_t i = 0; i < nverts; i++) {
-                    dst_annotations[0].u_along_curve *= invlength;
-                    dst_annotations[1].u_along_curve *= invlength;
-                    dst_annotations += 2;
-                }
-                break;
-            case PAR_U_MODE_SEGMENT_INDEX:
-                dst_annotations -= nverts * 2;
-                for (uint16_t i = 0; i < nverts; i++) {
-                    dst_annotations[0].u_along_curve = i;
-                    dst_annotations[1].u_along_curve = i;
-                    dst_annotations += 2;
-                }
-                break;
-            case PAR_U_MODE_SEGMENT_FRACTION:
-                dst_annotations -= nverts * 2;
-                for (uint16_t i = 0; i < nverts; i++) {
-                    dst_annotations[0].u_along_curve = invcount * i;
-                    dst_annotations[1].u_along_curve = invcount * i;
-                    dst_annotations += 2;
-                }
-                break;
-            }
+    assert(num_src_vertices == spines.num_vertices);
+
+    if (context->has_client_output) {
+        const parsl_output* output = &context->client_output;
+        const uint32_t num_indices = ind_per_tri * mesh->num_triangles;
+        if (mesh->num_vertices > output->max_vertices ||
+            num_indices > output->max_indices ||
+            (output->indices_16bit && mesh->num_vertices > 65536)) {
+            return false;
         }
+        parsl__init_sink(context);
+        return true;
     }
 
-    assert(src_position - spines.vertices == spines.num_vertices);
-    assert(dst_positions - mesh->positions == mesh->num_vertices);
-    assert(dst_indices - mesh->triangle_indices ==
-        mesh->num_triangles * ind_per_tri);
+    pa_clear(mesh->spine_lengths);
+    pa_clear(mesh->annotations);
+    pa_clear(mesh->positions);
+    pa_clear(mesh->triangle_indices);
+    pa_clear(mesh->random_offsets);
 
-    if (context->config.flags & PARSL_FLAG_RANDOM_OFFSETS) {
-        pa_clear(mesh->random_offsets);
+    if (has_lengths) {
+        pa_add(mesh->spine_lengths, mesh->num_vertices);
+    }
+    if (has_annotations) {
+        pa_add(mesh->annotations, mesh->num_vertices);
+    }
+    if (has_random) {
         pa_add(mesh->random_offsets, mesh->num_vertices);
-        float* pvertex = mesh->random_offsets;
-        for (uint16_t spine = 0; spine < spines.num_spines; spine++) {
-            const uint16_t num_segments = spines.spine_lengths[spine];
+    }
+
+    pa_add(mesh->positions, mesh->num_vertices);
+    pa_add(mesh->triangle_indices, ind_per_tri * mesh->num_triangles);
+    parsl__init_sink(context);
+    return true;
+}
+
+// Tessellates the given range of spines according to the current layout.
+static void parsl__tessellate_spines(parsl_context* context,
+    parsl_spine_list32 spines, uint32_t first_spine, uint32_t end_spine)
+{
+    const bool wireframe = context->config.flags & PARSL_FLAG_WIREFRAME;
+    const uint32_t ind_per_tri = wireframe ? 4 : 3;
+    const uint32_t* src_offsets = context->spine_offsets;
+    const uint32_t* dst_offsets = context->spine_offsets + spines.num_spines;
+
+    PARSL__PARALLEL_FOR
+    for (uint32_t spine = first_spine; spine < end_spine; spine++) {
+        const uint32_t dst = dst_offsets[spine];
+        const uint32_t first_triangle = dst - 2 * spine;
+        parsl__tessellate_spine(context, spines, spine,
+            spines.vertices + src_offsets[spine], dst,
+            first_triangle * ind_per_tri);
+    }
+}
+
+// Assigns the given random offset to every vertex of a spine.
+static void parsl__fill_random_offset(parsl_context* context,
+    uint32_t num_spines, uint32_t spine, float r)
+{
+    parsl_output const* sink = &context->sink;
+    const uint32_t* dst_offsets = context->spine_offsets + num_spines;
+    const uint32_t end = spine + 1 < num_spines ? dst_offsets[spine + 1] :
+        context->result.num_vertices;
+    for (uint32_t vertex = dst_offsets[spine]; vertex < end; vertex++) {
+        *PARSL__RANDOM(vertex) = r;
+    }
+}
+
+// Returns the mesh that describes the most recent tessellation. When writing to
+// a client output, this only holds the counts.
+static parsl_mesh* parsl__current_mesh(parsl_context* context)
+{
+    if (!context->has_client_output) {
+        return &context->result;
+    }
+    context->client_mesh = (parsl_mesh) {
+        .num_vertices = context->result.num_vertices,
+        .num_triangles = context->result.num_triangles,
+    };
+    return &context->client_mesh;
+}
+
+static parsl_mesh* parsl__mesh_from_lines(parsl_context* context,
+    parsl_spine_list32 spines)
+{
+    context->spine_set_valid = false;
+    if (!parsl__layout_spines(context, spines)) {
+        return NULL;
+    }
+    parsl__tessellate_spines(context, spines, 0, spines.num_spines);
+    if (context->sink.random_offsets) {
+        for (uint32_t spine = 0; spine < spines.num_spines; spine++) {
             const float r = (float) rand() / RAND_MAX;
-            for (uint16_t segment = 0; segment < num_segments; segment++) {
-                *pvertex++ = r;
+            parsl__fill_random_offset(context, spines.num_spines, spine, r);
+        }
+    }
+    return parsl__current_mesh(context);
+}
+
+// Maps a position to pixels using the SVG-style view matrix of the config.
+static parsl_position parsl__to_screen(float const* m, parsl_position p)
+{
+    return (parsl_position) {
+        m[0] * p.x + m[2] * p.y + m[4],
+        m[1] * p.x + m[3] * p.y + m[5]
+    };
+}
+
+// Returns the largest factor by which the view matrix stretches an axis.
+static float parsl__view_scale(parsl_config const* config)
+{
+    float const* m = config->view_matrix;
+    const float sx = m[0] * m[0] + m[1] * m[1];
+    const float sy = m[2] * m[2] + m[3] * m[3];
+    return sqrtf(PAR_MAX(sx, sy));
+}
+
+// Culls spines whose bounds are entirely outside the view viewport, and merges
+// interior vertices that are closer than lod_min_pixels to the previously kept
+// vertex on screen. Endpoints are always kept. Returns a reduced copy of the
+// spines that is owned by the context.
+static parsl_spine_list32 parsl__reduce_spines(parsl_context* context,
+    parsl_spine_list32 spines)
+{
+    const parsl_config* config = &context->config;
+    float const* m = config->view_matrix;
+    const parsl_viewport vp = config->view_viewport;
+    const float vp_left = PAR_MIN(vp.left, vp.right);
+    const float vp_right = PAR_MAX(vp.left, vp.right);
+    const float vp_top = PAR_MIN(vp.top, vp.bottom);
+    const float vp_bottom = PAR_MAX(vp.top, vp.bottom);
+    const float min_pixels = config->lod_min_pixels ? config->lod_min_pixels :
+        1.0f;
+    const float min_pixels_squared = min_pixels * min_pixels;
+    const float miter_limit = config->miter_limit ? config->miter_limit :
+        (config->thickness * 2);
+    const float margin = PAR_MAX(PAR_MAX(config->thickness, 1.0f) / 2,
+        miter_limit);
+    const uint32_t guideline_start = context->guideline_start;
+    uint32_t num_culled_curves = 0;
+
+    parsl_spine_list32* reduced = &context->lod_spines;
+    reduced->num_vertices = 0;
+    reduced->num_spines = 0;
+    reduced->closed = spines.closed;
+    pa_clear(reduced->vertices);
+    pa_clear(reduced->spine_lengths);
+
+    const parsl_position* src = spines.vertices;
+    for (uint32_t spine = 0; spine < spines.num_spines; spine++) {
+        const uint32_t spine_length = spines.spine_lengths[spine];
+        const parsl_position* next = src + spine_length;
+
+        // Transform the world-space bounds of the spine into screen space.
+        parsl_position lo = src[0], hi = src[0];
+        for (uint32_t i = 1; i < spine_length; i++) {
+            lo.x = PAR_MIN(lo.x, src[i].x);
+            lo.y = PAR_MIN(lo.y, src[i].y);
+            hi.x = PAR_MAX(hi.x, src[i].x);
+            hi.y = PAR_MAX(hi.y, src[i].y);
+        }
+        lo.x -= margin;
+        lo.y -= margin;
+        hi.x += margin;
+        hi.y += margin;
+        const parsl_position corners[4] = {
+            parsl__to_screen(m, lo),
+            parsl__to_screen(m, (parsl_position) {hi.x, lo.y}),
+            parsl__to_screen(m, (parsl_position) {lo.x, hi.y}),
+            parsl__to_screen(m, hi),
+        };
+        parsl_position screen_lo = corners[0], screen_hi = corners[0];
+        for (int i = 1; i < 4; i++) {
+            screen_lo.x = PAR_MIN(screen_lo.x, corners[i].x);
+            screen_lo.y = PAR_MIN(screen_lo.y, corners[i].y);
+            screen_hi.x = PAR_MAX(screen_hi.x, corners[i].x);
+            screen_hi.y = PAR_MAX(screen_hi.y, corners[i].y);
+        }
+        if (screen_hi.x < vp_left || screen_lo.x > vp_right ||
+            screen_hi.y < vp_top || screen_lo.y > vp_bottom) {
+            num_culled_curves += spine < guideline_start ? 1 : 0;
+            src = next;
+            continue;
+        }
+
+        // Merge sub-pixel segments.
+        uint32_t num_kept = 1;
+        pa_push(reduced->vertices, src[0]);
+        parsl_position previous = parsl__to_screen(m, src[0]);
+        for (uint32_t i = 1; i < spine_length - 1; i++) {
+            const parsl_position p = parsl__to_screen(m, src[i]);
+            const parsl_position delta = parsl__sub(p, previous);
+            if (parsl__dot(delta, delta) >= min_pixels_squared) {
+                pa_push(reduced->vertices, src[i]);
+                previous = p;
+                num_kept++;
             }
         }
+        pa_push(reduced->vertices, src[spine_length - 1]);
+        num_kept++;
+
+        pa_push(reduced->spine_lengths, num_kept);
+        reduced->num_vertices += num_kept;
+        reduced->num_spines++;
+        src = next;
+    }
+
+    if (guideline_start > 0) {
+        context->guideline_start = guideline_start - num_culled_curves;
+    }
+
+    return *reduced;
+}
+
+parsl_mesh* parsl_mesh_from_lines32(parsl_context* context,
+    parsl_spine_list32 spines)
+{
+    if (context->config.flags & PARSL_FLAG_SCREEN_SPACE_LOD) {
+        spines = parsl__reduce_spines(context, spines);
     }
+    return parsl__mesh_from_lines(context, spines);
+}
 
+parsl_mesh* parsl_mesh_from_spine_set(parsl_context* context,
+    parsl_spine_list32 spines)
+{
+    parsl_spine_list32* set = &context->spine_set;
+    set->num_vertices = spines.num_vertices;
+    set->num_spines = spines.num_spines;
+    set->closed = spines.closed;
+    pa_clear(set->vertices);
+    pa_add(set->vertices, spines.num_vertices);
+    memcpy(set->vertices, spines.vertices,
+        spines.num_vertices * sizeof(parsl_position));
+    pa_clear(set->spine_lengths);
+    pa_add(set->spine_lengths, spines.num_spines);
+    memcpy(set->spine_lengths, spines.spine_lengths,
+        spines.num_spines * sizeof(uint32_t));
+    parsl_mesh* mesh = parsl__mesh_from_lines(context, *set);
+    context->spine_set_valid = mesh != NULL;
     return mesh;
 }
 
-// This function is designed to be called in two passes. In the first pass, the
-// points pointer is null, so this simply determines the number of required
-// points to fulfill the flatness criterion. On the second pass, points is
-// non-null it actually writes out the point positions.
-static void parsl__tesselate_cubic(
-    parsl_position* points, uint32_t* num_points,
-    float x0, float y0, float x1, float y1,
-    float x2, float y2, float x3, float y3,
-    float max_flatness_squared, int recursion_depth)
+parsl_mesh* parsl_update_spine(parsl_context* context, uint32_t spine,
+    parsl_position const* vertices, uint32_t spine_length,
+    parsl_dirty_range* dirty)
 {
-    float dx0 = x1-x0;
-    float dy0 = y1-y0;
-    float dx1 = x2-x1;
-    float dy1 = y2-y1;
-    float dx2 = x3-x2;
-    float dy2 = y3-y2;
-    float dx = x3-x0;
-    float dy = y3-y0;
-    float longlen = (float) (sqrt(dx0*dx0 + dy0*dy0) + sqrt(dx1*dx1 + dy1*dy1) +
-        sqrt(dx2*dx2 + dy2*dy2));
-    float shortlen = (float) sqrt(dx*dx+dy*dy);
-    float flatness_squared = longlen*longlen - shortlen*shortlen;
-
-    if (recursion_depth > PARSL_MAX_RECURSION) {
-        return;
+    parsl_spine_list32* set = &context->spine_set;
+    parsl_mesh* mesh = &context->result;
+    const uint32_t num_spines = set->num_spines;
+    const bool wireframe = context->config.flags & PARSL_FLAG_WIREFRAME;
+    const uint32_t ind_per_tri = wireframe ? 4 : 3;
+    assert(spine < num_spines);
+    assert(spine_length > 1);
+    const uint32_t old_length = set->spine_lengths[spine];
+
+    // The result mesh was overwritten by some other call, so start over.
+    const bool rebuilt = !context->spine_set_valid;
+    if (rebuilt) {
+        if (!parsl__mesh_from_lines(context, *set)) {
+            return NULL;
+        }
+        context->spine_set_valid = true;
     }
 
-    if (flatness_squared > max_flatness_squared) {
-        const float x01 = (x0+x1) / 2;
-        const float y01 = (y0+y1) / 2;
-        const float x12 = (x1+x2) / 2;
-        const float y12 = (y1+y2) / 2;
-        const float x23 = (x2+x3) / 2;
-        const float y23 = (y2+y3) / 2;
-        const float xa = (x01+x12) / 2;
-        const float ya = (y01+y12) / 2;
-        const float xb = (x12+x23) / 2;
-        const float yb = (y12+y23) / 2;
-        const float mx = (xa+xb) / 2;
-        const float my = (ya+yb) / 2;
-        parsl__tesselate_cubic(points, num_points, x0,y0, x01,y01, xa,ya, mx,my,
-            max_flatness_squared, recursion_depth + 1);
-        parsl__tesselate_cubic(points, num_points, mx,my, xb,yb, x23,y23, x3,y3,
-            max_flatness_squared, recursion_depth + 1);
-        return;
+    const bool has_random = context->sink.random_offsets != NULL;
+    const uint32_t* dst_offsets = context->spine_offsets + num_spines;
+    const uint32_t src_begin = context->spine_offsets[spine];
+    const uint32_t src_end = src_begin + old_length;
+    const uint32_t num_trailing = set->num_vertices - src_end;
+    const uint32_t end_spine = old_length == spine_length ? spine + 1 :
+        num_spines;
+
+    // Retain the random offsets of every spine that will be re-tessellated.
+    float* randoms = NULL;
+    if (has_random) {
+        parsl_output const* sink = &context->sink;
+        randoms = PAR_MALLOC(float, (end_spine - spine));
+        for (uint32_t i = spine; i < end_spine; i++) {
+            randoms[i - spine] = *PARSL__RANDOM(dst_offsets[i]);
+        }
     }
 
-    int n = *num_points;
-    if (points) {
-        points[n].x = x3;
-        points[n].y = y3;
+    // Splice the new vertices into the retained copy of the spines. When the
+    // length changes, all subsequent spines move, so the layout is redone.
+    if (spine_length > old_length) {
+        set->num_vertices += spine_length - old_length;
+        pa_clear(set->vertices);
+        pa_add(set->vertices, set->num_vertices);
     }
-    *num_points = n + 1;
+    if (spine_length != old_length) {
+        memmove(set->vertices + src_begin + spine_length,
+            set->vertices + src_end, num_trailing * sizeof(parsl_position));
+        set->num_vertices = src_begin + spine_length + num_trailing;
+        set->spine_lengths[spine] = spine_length;
+        if (!parsl__layout_spines(context, *set)) {
+            context->spine_set_valid = false;
+            PAR_FREE(randoms);
+            return NULL;
+        }
+        dst_offsets = context->spine_offsets + num_spines;
+    }
+    memcpy(set->vertices + src_begin, vertices,
+        spine_length * sizeof(parsl_position));
+
+    parsl__tessellate_spines(context, *set, spine, end_spine);
+
+    if (has_random) {
+        for (uint32_t i = spine; i < end_spine; i++) {
+            parsl__fill_random_offset(context, num_spines, i,
+                randoms[i - spine]);
+        }
+        PAR_FREE(randoms);
+    }
+
+    if (dirty && rebuilt) {
+        dirty->first_vertex = 0;
+        dirty->num_vertices = mesh->num_vertices;
+        dirty->first_index = 0;
+        dirty->num_indices = mesh->num_triangles * ind_per_tri;
+    } else if (dirty) {
+        const uint32_t first_vertex = dst_offsets[spine];
+        const uint32_t end_vertex = end_spine < num_spines ?
+            dst_offsets[end_spine] : mesh->num_vertices;
+        dirty->first_vertex = first_vertex;
+        dirty->num_vertices = end_vertex - first_vertex;
+        dirty->first_index = (first_vertex - 2 * spine) * ind_per_tri;
+        dirty->num_indices = (end_vertex - 2 * end_spine) * ind_per_tri -
+            dirty->first_index;
+    }
+
+    return parsl__current_mesh(context);
 }
 
-// This function is designed to be called in two passes. In the first pass, the
-// points pointer is null, so this simply determines the number of required
-// points to fulfill the flatness criterion. On the second pass, points is
-// non-null it actually writes out the point positions.
-static void parsl__tesselate_quadratic(
-    parsl_position* points, uint32_t* num_points,
-    float x0, float y0, float x1, float y1, float x2, float y2,
-    float max_flatness_squared, int recursion_depth)
+// Wang's formula gives the number of uniform parametric segments that keeps a
+// polynomial curve within max_flatness of its flattened form. It only needs
+// the largest second difference of the control points, where degree_factor is
+// d * (d - 1) / 8 for a curve of degree d.
+static uint32_t parsl__wang(parsl_position dd0, parsl_position dd1,
+    float degree_factor, float max_flatness)
 {
-    const float mx = (x0 + 2 * x1 + x2) / 4;
-    const float my = (y0 + 2 * y1 + y2) / 4;
-    const float dx = (x0 + x2) / 2 - mx;
-    const float dy = (y0 + y2) / 2 - my;
-    const float flatness_squared = dx * dx + dy * dy;
+    const float m2 = PAR_MAX(parsl__dot(dd0, dd0), parsl__dot(dd1, dd1));
+    const float n = ceilf(sqrtf(degree_factor * sqrtf(m2) / max_flatness));
+    return n < 1 ? 1 : n > PARSL_MAX_CURVE_SEGMENTS ?
+        PARSL_MAX_CURVE_SEGMENTS : (uint32_t) n;
+}
 
-    if (recursion_depth++ > PARSL_MAX_RECURSION) {
+// Gathers the four control points of the given piecewise curve within a spine
+// of chained cubics. The first control point of every subsequent curve is
+// computed via reflection over the endpoint.
+static void parsl__cubic_controls(const parsl_position* spine,
+    uint32_t piecewise, parsl_position* controls)
+{
+    if (piecewise == 0) {
+        memcpy(controls, spine, 4 * sizeof(parsl_position));
         return;
     }
+    const parsl_position* psource = spine + 2 + piecewise * 2;
+    const parsl_position p1 = psource[-1];
+    const parsl_position previous_c2 = psource[-2];
+    controls[0] = p1;
+    controls[1] = parsl__sub(p1, parsl__sub(previous_c2, p1));
+    controls[2] = psource[0];
+    controls[3] = psource[1];
+}
 
-    if (flatness_squared > max_flatness_squared) {
-        parsl__tesselate_quadratic(points, num_points, x0,y0,
-            (x0 + x1) / 2.0f, (y0 + y1) / 2.0f,
-            mx, my,
-            max_flatness_squared, recursion_depth);
-        parsl__tesselate_quadratic(points, num_points, mx,my,
-            (x1 + x2) / 2.0f, (y1 + y2) / 2.0f,
-            x2, y2,
-            max_flatness_squared, recursion_depth);
-        return;
-    }
+// Gathers the three control points of the given piecewise curve within a
+// spine of chained quadratics.
+static void parsl__quadratic_controls(const parsl_position* spine,
+    uint32_t piecewise, parsl_position* controls)
+{
+    memcpy(controls, spine + piecewise * 2, 3 * sizeof(parsl_position));
+}
 
-    int n = *num_points;
-    if (points) {
-        points[n].x = x2;
-        points[n].y = y2;
+// Flattens a spine of chained Bézier curves in a single non-recursive pass.
+// The number of segments in each curve is computed up front, so this writes
+// the starting point followed by the end of each segment. It returns the number
+// of points and can be called with a null target to simply count them.
+static uint32_t parsl__flatten_spine(const parsl_position* spine,
+    uint32_t spine_length, bool cubic, float max_flatness,
+    parsl_position* target)
+{
+    const uint32_t num_piecewise = cubic ? 1 + (spine_length - 4) / 2 :
+        1 + (spine_length - 3) / 2;
+    uint32_t num_points = 1;
+    if (target) {
+        target[0] = spine[0];
     }
-    *num_points = n + 1;
+    for (uint32_t piecewise = 0; piecewise < num_piecewise; piecewise++) {
+        parsl_position p[4];
+        uint32_t num_segments;
+        if (cubic) {
+            parsl__cubic_controls(spine, piecewise, p);
+            const parsl_position dd0 = parsl__add(parsl__sub(p[0], p[1]),
+                parsl__sub(p[2], p[1]));
+            const parsl_position dd1 = parsl__add(parsl__sub(p[1], p[2]),
+                parsl__sub(p[3], p[2]));
+            num_segments = parsl__wang(dd0, dd1, 0.75f, max_flatness);
+        } else {
+            parsl__quadratic_controls(spine, piecewise, p);
+            const parsl_position dd0 = parsl__add(parsl__sub(p[0], p[1]),
+                parsl__sub(p[2], p[1]));
+            num_segments = parsl__wang(dd0, dd0, 0.25f, max_flatness);
+        }
+        if (target) {
+            parsl_position* dst = target + num_points;
+            const float dt = 1.0f / num_segments;
+            if (cubic) {
+                for (uint32_t i = 1; i < num_segments; i++) {
+                    const float t = i * dt;
+                    const float s = 1 - t;
+                    const float b0 = s * s * s;
+                    const float b1 = 3 * s * s * t;
+                    const float b2 = 3 * s * t * t;
+                    const float b3 = t * t * t;
+                    dst[i - 1].x = b0 * p[0].x + b1 * p[1].x + b2 * p[2].x +
+                        b3 * p[3].x;
+                    dst[i - 1].y = b0 * p[0].y + b1 * p[1].y + b2 * p[2].y +
+                        b3 * p[3].y;
+                }
+                dst[num_segments - 1] = p[3];
+            } else {
+                for (uint32_t i = 1; i < num_segments; i++) {
+                    const float t = i * dt;
+                    const float s = 1 - t;
+                    const float b0 = s * s;
+                    const float b1 = 2 * s * t;
+                    const float b2 = t * t;
+                    dst[i - 1].x = b0 * p[0].x + b1 * p[1].x + b2 * p[2].x;
+                    dst[i - 1].y = b0 * p[0].y + b1 * p[1].y + b2 * p[2].y;
+                }
+                dst[num_segments - 1] = p[2];
+            }
+        }
+        num_points += num_segments;
+    }
+    return num_points;
 }
 
-parsl_mesh* parsl_mesh_from_curves_cubic(parsl_context* context,
-    parsl_spine_list source_spines)
+// Flattens all source spines into the curve spines of the context, leaving room
+// for the given number of guide points at the end. The spine lengths array
+// must already be allocated. Returns a pointer to the first guide point.
+static parsl_position* parsl__flatten_curves(parsl_context* context,
+    parsl_spine_list32 source_spines, bool cubic, uint32_t num_guide_points)
 {
     float max_flatness = context->config.curves_max_flatness;
     if (max_flatness == 0) {
         max_flatness = 1.0f;
     }
-    const float max_flatness_squared = max_flatness * max_flatness;
-    parsl_spine_list* target_spines = &context->curve_spines;
+    if (context->config.flags & PARSL_FLAG_SCREEN_SPACE_LOD) {
+        max_flatness /= parsl__view_scale(&context->config);
+    }
+    parsl_spine_list32* target_spines = &context->curve_spines;
+    const uint32_t num_spines = source_spines.num_spines;
+
+    // First pass: determine the number of required vertices, and prefix-sum
+    // them to find where each spine reads and writes.
+    pa_clear(context->spine_offsets);
+    pa_add(context->spine_offsets, 2 * num_spines);
+    uint32_t* src_offsets = context->spine_offsets;
+    uint32_t* dst_offsets = context->spine_offsets + num_spines;
+    uint32_t num_src_points = 0;
+    uint32_t num_dst_points = 0;
+    for (uint32_t spine = 0; spine < num_spines; spine++) {
+        const uint32_t spine_length = source_spines.spine_lengths[spine];
+        assert(spine_length >= (cubic ? 4 : 3));
+        assert((spine_length % 2) == (cubic ? 0 : 1));
+        src_offsets[spine] = num_src_points;
+        dst_offsets[spine] = num_dst_points;
+        const uint32_t num_points = parsl__flatten_spine(
+            source_spines.vertices + num_src_points, spine_length, cubic,
+            max_flatness, NULL);
+        target_spines->spine_lengths[spine] = num_points;
+        num_src_points += spine_length;
+        num_dst_points += num_points;
+    }
+
+    // Allocate memory.
+    target_spines->num_vertices = num_dst_points + num_guide_points;
+    pa_clear(target_spines->vertices);
+    pa_add(target_spines->vertices, target_spines->num_vertices);
+
+    // Second pass: write out the data.
+    parsl_position* vertices = target_spines->vertices;
+    PARSL__PARALLEL_FOR
+    for (uint32_t spine = 0; spine < num_spines; spine++) {
+        parsl__flatten_spine(source_spines.vertices + src_offsets[spine],
+            source_spines.spine_lengths[spine], cubic, max_flatness,
+            vertices + dst_offsets[spine]);
+    }
+
+    return vertices + num_dst_points;
+}
+
+parsl_mesh* parsl_mesh_from_curves_cubic(parsl_context* context,
+    parsl_spine_list source_spines)
+{
+    return parsl_mesh_from_curves_cubic32(context,
+        parsl__widen_spines(context, source_spines));
+}
+
+parsl_mesh* parsl_mesh_from_curves_cubic32(parsl_context* context,
+    parsl_spine_list32 source_spines)
+{
+    parsl_spine_list32* target_spines = &context->curve_spines;
     const bool has_guides = context->config.flags & PARSL_FLAG_CURVE_GUIDES;
+    const uint32_t nsrcspines = source_spines.num_spines;
 
     // Determine the number of spines in the target list.
-    target_spines->num_spines = source_spines.num_spines;
+    target_spines->num_spines = nsrcspines;
+    uint32_t num_guide_points = 0;
     if (has_guides) {
-        for (uint32_t spine = 0; spine < source_spines.num_spines; spine++) {
+        for (uint32_t spine = 0; spine < nsrcspines; spine++) {
             uint32_t spine_length = source_spines.spine_lengths[spine];
             uint32_t num_piecewise = 1 + (spine_length - 4) / 2;
             target_spines->num_spines += num_piecewise * 2;
+            num_guide_points += num_piecewise * 4;
         }
     }
     pa_clear(target_spines->spine_lengths);
     pa_add(target_spines->spine_lengths, target_spines->num_spines);
 
-    // First pass: determine the number of required vertices.
-    uint32_t total_required_spine_points = 0;
-    const parsl_position* psource = source_spines.vertices;
-    for (uint32_t spine = 0; spine < source_spines.num_spines; spine++) {
-
-        // Source vertices look like: P1 C1 C2 P2 [C2 P2]*
-        uint32_t spine_length = source_spines.spine_lengths[spine];
-        assert(spine_length >= 4);
-        assert((spine_length % 2) == 0);
-        uint32_t num_piecewise = 1 + (spine_length - 4) / 2;
-
-        // First piecewise curve.
-        uint32_t num_required_spine_points = 1;
-        parsl__tesselate_cubic(NULL, &num_required_spine_points,
-            psource[0].x, psource[0].y, psource[1].x, psource[1].y,
-            psource[2].x, psource[2].y, psource[3].x, psource[3].y,
-            max_flatness_squared, 0);
-        psource += 4;
-
-        // Subsequent piecewise curves.
-        for (uint32_t piecewise = 1; piecewise < num_piecewise; piecewise++) {
-            parsl_position p1 = psource[-1];
-            parsl_position previous_c2 = psource[-2];
-            parsl_position c1 = parsl__sub(p1, parsl__sub(previous_c2, p1));
-            parsl_position c2 = psource[0];
-            parsl_position p2 = psource[1];
-            parsl__tesselate_cubic(NULL, &num_required_spine_points,
-                p1.x, p1.y, c1.x, c1.y, c2.x, c2.y, p2.x, p2.y,
-                max_flatness_squared, 0);
-            psource += 2;
-        }
-
-        target_spines->spine_lengths[spine] = num_required_spine_points;
-        total_required_spine_points += num_required_spine_points;
-    }
-
     if (has_guides) {
-        uint32_t nsrcspines = source_spines.num_spines;
-        uint16_t* guide_lengths = &target_spines->spine_lengths[nsrcspines];
-        for (uint32_t spine = 0; spine < nsrcspines; spine++) {
-            uint32_t spine_length = source_spines.spine_lengths[spine];
-            uint32_t num_piecewise = 1 + (spine_length - 4) / 2;
-            for (uint32_t pw = 0; pw < num_piecewise; pw++) {
-                guide_lengths[0] = 2;
-                guide_lengths[1] = 2;
-                guide_lengths += 2;
-                total_required_spine_points += 4;
-            }
+        uint32_t* guide_lengths = &target_spines->spine_lengths[nsrcspines];
+        for (uint32_t i = nsrcspines; i < target_spines->num_spines; i++) {
+            *guide_lengths++ = 2;
         }
     }
 
-    // Allocate memory.
-    target_spines->num_vertices = total_required_spine_points;
-    pa_clear(target_spines->vertices);
-    pa_add(target_spines->vertices, total_required_spine_points);
-
-    // Second pass: write out the data.
-    psource = source_spines.vertices;
-    parsl_position* ptarget = target_spines->vertices;
-    for (uint32_t spine = 0; spine < source_spines.num_spines; spine++) {
-
-        // Source vertices look like: P1 C1 C2 P2 [C2 P2]*
-        uint32_t spine_length = source_spines.spine_lengths[spine];
-        uint32_t num_piecewise = 1 + (spine_length - 4) / 2;
-
-        __attribute__((unused))
-        parsl_position* target_spine_start = ptarget;
-
-        // First piecewise curve.
-        ptarget[0].x = psource[0].x;
-        ptarget[0].y = psource[0].y;
-        ptarget++;
-        uint32_t num_written_points = 0;
-        parsl__tesselate_cubic(ptarget, &num_written_points,
-            psource[0].x, psource[0].y, psource[1].x, psource[1].y,
-            psource[2].x, psource[2].y, psource[3].x, psource[3].y,
-            max_flatness_squared, 0);
-        psource += 4;
-        ptarget += num_written_points;
-
-        // Subsequent piecewise curves.
-        for (uint32_t piecewise = 1; piecewise < num_piecewise; piecewise++) {
-            parsl_position p1 = psource[-1];
-            parsl_position previous_c2 = psource[-2];
-            parsl_position c1 = parsl__sub(p1, parsl__sub(previous_c2, p1));
-            parsl_position c2 = psource[0];
-            parsl_position p2 = psource[1];
-            num_written_points = 0;
-            parsl__tesselate_cubic(ptarget, &num_written_points,
-                p1.x, p1.y, c1.x, c1.y, c2.x, c2.y, p2.x, p2.y,
-                max_flatness_squared, 0);
-            psource += 2;
-            ptarget += num_written_points;
-        }
-
-        __attribute__((unused))
-        uint32_t num_written = ptarget - target_spine_start;
-        assert(num_written == (uint32_t) target_spines->spine_lengths[spine]);
-    }
+    parsl_position* ptarget = parsl__flatten_curves(context, source_spines,
+        true, num_guide_points);
 
     // Source vertices look like: P1 C1 C2 P2 [C2 P2]*
     if (has_guides) {
-        uint32_t nsrcspines = source_spines.num_spines;
         context->guideline_start = nsrcspines;
-        psource = source_spines.vertices;
+        const parsl_position* psource = source_spines.vertices;
         for (uint32_t spine = 0; spine < nsrcspines; spine++) {
             uint32_t spine_length = source_spines.spine_lengths[spine];
             uint32_t num_piecewise = 1 + (spine_length - 4) / 2;
-            *ptarget++ = psource[0];
-            *ptarget++ = psource[1];
-            *ptarget++ = psource[2];
-            *ptarget++ = psource[3];
-            psource += 4;
-            for (uint32_t pw = 1; pw < num_piecewise; pw++) {
-                parsl_position p1 = psource[-1];
-                parsl_position previous_c2 = psource[-2];
-                parsl_position c1 = parsl__sub(p1, parsl__sub(previous_c2, p1));
-                parsl_position c2 = psource[0];
-                parsl_position p2 = psource[1];
-                *ptarget++ = p1;
-                *ptarget++ = c1;
-                *ptarget++ = p2;
-                *ptarget++ = c2;
-                psource += 2;
+            for (uint32_t pw = 0; pw < num_piecewise; pw++) {
+                parsl_position p[4];
+                parsl__cubic_controls(psource, pw, p);
+                *ptarget++ = p[0];
+                *ptarget++ = p[1];
+                *ptarget++ = pw ? p[3] : p[2];
+                *ptarget++ = pw ? p[2] : p[3];
             }
+            psource += spine_length;
         }
     }
 
-    assert(ptarget - target_spines->vertices == total_required_spine_points);
-    parsl_mesh_from_lines(context, context->curve_spines);
+    assert(ptarget - target_spines->vertices == target_spines->num_vertices);
+    parsl_mesh* mesh = parsl_mesh_from_lines32(context, context->curve_spines);
     context->guideline_start = 0;
-    return &context->result;
+    return mesh;
 }
 
 parsl_mesh* parsl_mesh_from_curves_quadratic(parsl_context* context,
     parsl_spine_list source_spines)
 {
-    float max_flatness = context->config.curves_max_flatness;
-    if (max_flatness == 0) {
-        max_flatness = 1.0f;
-    }
-    const float max_flatness_squared = max_flatness * max_flatness;
-    parsl_spine_list* target_spines = &context->curve_spines;
+    return parsl_mesh_from_curves_quadratic32(context,
+        parsl__widen_spines(context, source_spines));
+}
+
+parsl_mesh* parsl_mesh_from_curves_quadratic32(parsl_context* context,
+    parsl_spine_list32 source_spines)
+{
+    parsl_spine_list32* target_spines = &context->curve_spines;
     const bool has_guides = context->config.flags & PARSL_FLAG_CURVE_GUIDES;
+    const uint32_t nsrcspines = source_spines.num_spines;
 
-    // Determine the number of spines in the target list.
-    target_spines->num_spines = source_spines.num_spines;
+    // Determine the number of spines in the target list. Each guide spine is
+    // simply a copy of its source spine.
+    target_spines->num_spines = nsrcspines;
+    uint32_t num_guide_points = 0;
     if (has_guides) {
-        target_spines->num_spines += source_spines.num_spines;
+        target_spines->num_spines += nsrcspines;
+        num_guide_points = source_spines.num_vertices;
     }
     pa_clear(target_spines->spine_lengths);
     pa_add(target_spines->spine_lengths, target_spines->num_spines);
 
-    // First pass: determine the number of required vertices.
-    uint32_t total_required_spine_points = 0;
-    const parsl_position* psource = source_spines.vertices;
-    for (uint32_t spine = 0; spine < source_spines.num_spines; spine++) {
-
-        // Source vertices look like: PT C PT [C PT]*
-        uint32_t spine_length = source_spines.spine_lengths[spine];
-        assert(spine_length >= 3);
-        assert((spine_length % 2) == 1);
-        uint32_t num_piecewise = 1 + (spine_length - 3) / 2;
-
-        // First piecewise curve.
-        uint32_t num_required_spine_points = 1;
-        parsl__tesselate_quadratic(NULL, &num_required_spine_points,
-            psource[0].x, psource[0].y, psource[1].x, psource[1].y,
-            psource[2].x, psource[2].y,  max_flatness_squared, 0);
-        psource += 3;
-
-        // Subsequent piecewise curves.
-        for (uint32_t piecewise = 1; piecewise < num_piecewise; piecewise++) {
-            parsl_position p1 = psource[-1];
-            parsl_position c1 = psource[0];
-            parsl_position p2 = psource[1];
-            parsl__tesselate_quadratic(NULL, &num_required_spine_points,
-                p1.x, p1.y, c1.x, c1.y, p2.x, p2.y,  max_flatness_squared, 0);
-            psource += 2;
-        }
-
-        target_spines->spine_lengths[spine] = num_required_spine_points;
-        total_required_spine_points += num_required_spine_points;
-    }
-
     if (has_guides) {
-        uint32_t nsrcspines = source_spines.num_spines;
-        uint16_t* guide_lengths = &target_spines->spine_lengths[nsrcspines];
-        for (uint32_t spine = 0; spine < nsrcspines; spine++) {
-            uint32_t spine_length = source_spines.spine_lengths[spine];
-            uint32_t num_piecewise = 1 + (spine_length - 3) / 2;
-            guide_lengths[0] = 3 + (num_piecewise - 1) * 2;
-            total_required_spine_points += guide_lengths[0];
-            guide_lengths++;
-        }
+        memcpy(&target_spines->spine_lengths[nsrcspines],
+            source_spines.spine_lengths, nsrcspines * sizeof(uint32_t));
     }
 
-    // Allocate memory.
-    target_spines->num_vertices = total_required_spine_points;
-    pa_clear(target_spines->vertices);
-    pa_add(target_spines->vertices, total_required_spine_points);
-
-    // Second pass: write out the data.
-    psource = source_spines.vertices;
-    parsl_position* ptarget = target_spines->vertices;
-    for (uint32_t spine = 0; spine < source_spines.num_spines; spine++) {
-
-        // Source vertices look like: PT C PT [C PT]*
-        uint32_t spine_length = source_spines.spine_lengths[spine];
-        uint32_t num_piecewise = 1 + (spine_length - 3) / 2;
-
-        __attribute__((unused))
-        parsl_position* target_spine_start = ptarget;
-
-        // First piecewise curve.
-        ptarget[0].x = psource[0].x;
-        ptarget[0].y = psource[0].y;
-        ptarget++;
-        uint32_t num_written_points = 0;
-        parsl__tesselate_quadratic(ptarget, &num_written_points,
-            psource[0].x, psource[0].y, psource[1].x, psource[1].y,
-            psource[2].x, psource[2].y, max_flatness_squared, 0);
-        psource += 3;
-        ptarget += num_written_points;
-
-        // Subsequent piecewise curves.
-        for (uint32_t piecewise = 1; piecewise < num_piecewise; piecewise++) {
-            parsl_position p1 = psource[-1];
-            parsl_position c1 = psource[0];
-            parsl_position p2 = psource[1];
-            num_written_points = 0;
-            parsl__tesselate_quadratic(ptarget, &num_written_points,
-                p1.x, p1.y, c1.x, c1.y, p2.x, p2.y, max_flatness_squared, 0);
-            psource += 2;
-            ptarget += num_written_points;
-        }
-
-        __attribute__((unused))
-        uint32_t num_written = ptarget - target_spine_start;
-        assert(num_written == (uint32_t) target_spines->spine_lengths[spine]);
-    }
+    parsl_position* ptarget = parsl__flatten_curves(context, source_spines,
+        false, num_guide_points);
 
     // Source vertices look like: PT C PT [C PT]*
     if (has_guides) {
-        uint32_t nsrcspines = source_spines.num_spines;
         context->guideline_start = nsrcspines;
-        psource = source_spines.vertices;
-        for (uint32_t spine = 0; spine < nsrcspines; spine++) {
-            uint32_t spine_length = source_spines.spine_lengths[spine];
-            uint32_t num_piecewise = 1 + (spine_length - 3) / 2;
-            *ptarget++ = psource[0];
-            *ptarget++ = psource[1];
-            *ptarget++ = psource[2];
-            psource += 3;
-            for (uint32_t pw = 1; pw < num_piecewise; pw++) {
-                *ptarget++ = psource[0];
-                *ptarget++ = psource[1];
-                psource += 2;
-            }
-        }
+        memcpy(ptarget, source_spines.vertices,
+            source_spines.num_vertices * sizeof(parsl_position));
+        ptarget += source_spines.num_vertices;
     }
 
-    assert(ptarget - target_spines->vertices == total_required_spine_points);
-    parsl_mesh_from_lines(context, context->curve_spines);
+    assert(ptarget - target_spines->vertices == target_spines->num_vertices);
+    parsl_mesh* mesh = parsl_mesh_from_lines32(context, context->curve_spines);
     context->guideline_start = 0;
-    return &context->result;
+    return mesh;
 }
 
 static unsigned int par__randhash(unsigned int seed) {
@@ -1164,7 +1640,7 @@ static parsl_position* par__generate_pts(float width, float height,
         }
     }
 
-    pa___n(result) = nsamples * 2;
+    pa___n(result) = nsamples;
 
     PAR_FREE(grid);
     PAR_FREE(actives);
@@ -1174,9 +1650,7 @@ static parsl_position* par__generate_pts(float width, float height,
 #undef GRIDF
 #undef GRIDI
 
-parsl_mesh* parsl_mesh_from_streamlines(parsl_context* context,
-    parsl_advection_callback advect, uint32_t first_tick, uint32_t num_ticks,
-    void* userdata)
+static void parsl__generate_seeds(parsl_context* context)
 {
     const int seed = 42;
     const parsl_viewport vp = context->config.streamlines_seed_viewport;
@@ -1193,19 +1667,34 @@ parsl_mesh* parsl_mesh_from_streamlines(parsl_context* context,
             context->streamline_seeds[p].y += vp.top;
         }
     }
+}
 
-    uint32_t num_points = pa_count(context->streamline_seeds);
-    pa_clear(context->streamline_points);
-    pa_add(context->streamline_points, num_points);
+parsl_position const* parsl_get_streamline_seeds(parsl_context* context,
+    uint32_t* num_seeds)
+{
+    parsl__generate_seeds(context);
+    *num_seeds = pa_count(context->streamline_seeds);
+    return context->streamline_seeds;
+}
 
-    parsl_position* points = context->streamline_points;
-    memcpy(points, context->streamline_seeds,
-        num_points * sizeof(parsl_position));
+void parsl_set_streamline_seeds(parsl_context* context,
+    parsl_position const* seeds, uint32_t num_seeds)
+{
+    pa_clear(context->streamline_seeds);
+    pa_add(context->streamline_seeds, num_seeds);
+    memcpy(context->streamline_seeds, seeds,
+        num_seeds * sizeof(parsl_position));
+    context->streamline_window = 0;
+}
 
+// Allocates one spine of num_ticks vertices per seed and returns the vertices.
+static parsl_position* parsl__alloc_streamline_spines(parsl_context* context,
+    uint32_t num_points, uint32_t num_ticks)
+{
     context->streamline_spines.num_spines = num_points;
     pa_clear(context->streamline_spines.spine_lengths);
     pa_add(context->streamline_spines.spine_lengths, num_points);
-    uint16_t* lengths = context->streamline_spines.spine_lengths;
+    uint32_t* lengths = context->streamline_spines.spine_lengths;
     for (uint32_t i = 0; i < num_points; i++) {
         lengths[i] = num_ticks;
     }
@@ -1213,24 +1702,156 @@ parsl_mesh* parsl_mesh_from_streamlines(parsl_context* context,
     context->streamline_spines.num_vertices = num_points * num_ticks;
     pa_clear(context->streamline_spines.vertices);
     pa_add(context->streamline_spines.vertices, num_points * num_ticks);
-    parsl_position* vertices = context->streamline_spines.vertices;
+    return context->streamline_spines.vertices;
+}
+
+// Copies the seeds into the given particles.
+static void parsl__reset_particles(parsl_context* context,
+    parsl__particles* particles)
+{
+    const uint32_t num_points = pa_count(context->streamline_seeds);
+    pa_clear(particles->x);
+    pa_clear(particles->y);
+    pa_add(particles->x, num_points);
+    pa_add(particles->y, num_points);
+    for (uint32_t i = 0; i < num_points; i++) {
+        particles->x[i] = context->streamline_seeds[i].x;
+        particles->y[i] = context->streamline_seeds[i].y;
+    }
+}
+
+typedef struct {
+    parsl_advection_callback advect;
+    void* userdata;
+} parsl__pointwise;
+
+// Adapts a single-particle callback to the batch interface.
+static void parsl__pointwise_batch(float* x, float* y, uint32_t count,
+    void* userdata)
+{
+    parsl__pointwise* pointwise = (parsl__pointwise*) userdata;
+    for (uint32_t i = 0; i < count; i++) {
+        parsl_position point = { x[i], y[i] };
+        pointwise->advect(&point, pointwise->userdata);
+        x[i] = point.x;
+        y[i] = point.y;
+    }
+}
+
+parsl_mesh* parsl_mesh_from_streamlines(parsl_context* context,
+    parsl_advection_callback advect, uint32_t first_tick, uint32_t num_ticks,
+    void* userdata)
+{
+    parsl__pointwise pointwise = { advect, userdata };
+    return parsl_mesh_from_streamlines_batch(context, parsl__pointwise_batch,
+        first_tick, num_ticks, &pointwise);
+}
+
+parsl_mesh* parsl_mesh_from_streamlines_batch(parsl_context* context,
+    parsl_advection_batch_callback advect, uint32_t first_tick,
+    uint32_t num_ticks, void* userdata)
+{
+    parsl__generate_seeds(context);
+
+    const uint32_t num_points = pa_count(context->streamline_seeds);
+    parsl__particles* points = &context->streamline_points;
+    parsl__reset_particles(context, points);
+
+    parsl_position* vertices = parsl__alloc_streamline_spines(context,
+        num_points, num_ticks);
 
     for (uint32_t tick = 0; tick < first_tick; tick++) {
-        for (uint32_t i = 0; i < num_points; i++) {
-            advect(&points[i], userdata);
+        advect(points->x, points->y, num_points, userdata);
+    }
+
+    for (uint32_t tick = 0; tick < num_ticks; ++tick) {
+        advect(points->x, points->y, num_points, userdata);
+        parsl_position* pvertex = vertices + tick;
+        for (uint32_t i = 0; i < num_points; i++, pvertex += num_ticks) {
+            pvertex->x = points->x[i];
+            pvertex->y = points->y[i];
         }
     }
 
-    parsl_position* pvertices = vertices;
-    for (uint32_t i = 0; i < num_points; i++) {
-        for (uint32_t tick = 0; tick < num_ticks; ++tick) {
-            advect(&points[i], userdata);
-            *pvertices++ = points[i];
+    return parsl_mesh_from_lines32(context, context->streamline_spines);
+}
+
+// Moves every retained particle forward by the given number of ticks. Only the
+// final streamline_window positions of each particle are recorded, and they
+// overwrite the oldest slots of its ring buffer.
+static void parsl__advance_particles(parsl_context* context,
+    parsl_advection_batch_callback advect, uint32_t num_steps, void* userdata)
+{
+    const uint32_t window = context->streamline_window;
+    const uint32_t num_points = pa_count(context->streamline_seeds);
+    const uint32_t num_skipped = num_steps > window ? num_steps - window : 0;
+    const uint32_t num_recorded = num_steps - num_skipped;
+    parsl__particles* particles = &context->streamline_particles;
+
+    for (uint32_t tick = 0; tick < num_skipped; tick++) {
+        advect(particles->x, particles->y, num_points, userdata);
+    }
+
+    uint32_t slot = context->streamline_head;
+    for (uint32_t tick = 0; tick < num_recorded; tick++) {
+        advect(particles->x, particles->y, num_points, userdata);
+        parsl_position* history = context->streamline_history + slot;
+        for (uint32_t i = 0; i < num_points; i++, history += window) {
+            history->x = particles->x[i];
+            history->y = particles->y[i];
         }
+        slot = slot + 1 == window ? 0 : slot + 1;
+    }
+
+    context->streamline_head = slot;
+}
+
+parsl_mesh* parsl_mesh_from_streamlines_advance(parsl_context* context,
+    parsl_advection_callback advect, uint32_t delta_ticks, uint32_t num_ticks,
+    void* userdata)
+{
+    parsl__pointwise pointwise = { advect, userdata };
+    return parsl_mesh_from_streamlines_advance_batch(context,
+        parsl__pointwise_batch, delta_ticks, num_ticks, &pointwise);
+}
+
+parsl_mesh* parsl_mesh_from_streamlines_advance_batch(parsl_context* context,
+    parsl_advection_batch_callback advect, uint32_t delta_ticks,
+    uint32_t num_ticks, void* userdata)
+{
+    parsl__generate_seeds(context);
+
+    const uint32_t num_points = pa_count(context->streamline_seeds);
+    uint32_t num_steps = delta_ticks;
+
+    // Start over from the seeds if this is the first call or if the window
+    // size has changed. This replays the current first tick exactly once.
+    if (context->streamline_window != num_ticks) {
+        parsl__reset_particles(context, &context->streamline_particles);
+        pa_clear(context->streamline_history);
+        pa_add(context->streamline_history, num_points * num_ticks);
+        context->streamline_window = num_ticks;
+        context->streamline_head = 0;
+        num_steps += context->streamline_tick + num_ticks;
+    }
+
+    parsl__advance_particles(context, advect, num_steps, userdata);
+    context->streamline_tick += delta_ticks;
+
+    // Unroll each ring buffer into a spine, oldest vertex first.
+    parsl_position* vertices = parsl__alloc_streamline_spines(context,
+        num_points, num_ticks);
+    const uint32_t head = context->streamline_head;
+    const uint32_t tail = num_ticks - head;
+    for (uint32_t i = 0; i < num_points; i++) {
+        const parsl_position* history = context->streamline_history +
+            i * num_ticks;
+        memcpy(vertices, history + head, tail * sizeof(parsl_position));
+        memcpy(vertices + tail, history, head * sizeof(parsl_position));
+        vertices += num_ticks;
     }
 
-    parsl_mesh_from_lines(context, context->streamline_spines);
-    return &context->result;
+    return parsl_mesh_from_lines32(context, context->streamline_spines);
 }
 
 #endif // PAR_STREAMLINES_IMPLEMENTATION
@@ -0,0 +1,45 @@
+#include "describe.h"
+
+#define PAR_SHAPES_IMPLEMENTATION
+#include "par_shapes.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static const char* format_names[] = { "blob", "ply", "glb" };
+
+static const par_shapes_format formats[] = {
+    PAR_SHAPES_FORMAT_BLOB, PAR_SHAPES_FORMAT_PLY, PAR_SHAPES_FORMAT_GLB
+};
+
+static double elapsed_seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+    describe("par_shapes_export_file") {
+        it("should report the time taken by each format") {
+            for (int n = 100; n <= 400; n *= 2) {
+                par_shapes_mesh* m = par_shapes_create_parametric_sphere(n, n);
+                clock_t start = clock();
+                par_shapes_export(m, "bench_shapes.obj");
+                printf("        %6d points: obj %.3fs", m->npoints,
+                    elapsed_seconds(start));
+                remove("bench_shapes.obj");
+                for (int i = 0; i < 3; i++) {
+                    start = clock();
+                    assert_ok(par_shapes_export_file(m, formats[i],
+                        "bench_shapes.out"));
+                    printf(", %s %.3fs", format_names[i],
+                        elapsed_seconds(start));
+                    remove("bench_shapes.out");
+                }
+                printf("\n");
+                par_shapes_free_mesh(m);
+            }
+        }
+    }
+    return assert_failures();
+}
@@ -0,0 +1,166 @@
+#include "describe.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+// Count every allocation made by the library.
+static int num_allocations;
+
+#define PAR_MALLOC(T, N) (num_allocations++, (T*) malloc((N) * sizeof(T)))
+#define PAR_CALLOC(T, N) (num_allocations++, (T*) calloc((N) * sizeof(T), 1))
+#define PAR_REALLOC(T, BUF, N) \
+    (num_allocations++, (T*) realloc(BUF, sizeof(T) * (N)))
+#define PAR_FREE(BUF) free(BUF)
+
+#define PAR_STREAMLINES_IMPLEMENTATION
+#include "par_streamlines.h"
+
+#define NUM_FLAG_COMBINATIONS 16
+#define MIN_SEGMENTS_PER_RUN 10000
+#define MAX_SEGMENTS 1000000
+
+typedef enum { LINES, CUBIC, QUADRATIC, STREAMLINES } bench_kind;
+
+static const char* kind_names[] = {
+    "lines", "cubic", "quadratic", "streamlines"
+};
+
+typedef struct {
+    parsl_spine_list spines;
+    parsl_position* seeds;
+    uint32_t num_seeds;
+    uint32_t num_ticks;
+} bench_input;
+
+static double elapsed_seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Fixed advection field: a slow swirl around the origin.
+static void swirl(parsl_position* point, void* userdata)
+{
+    const float x = point->x, y = point->y;
+    point->x += 0.01f * (-y + 0.1f * x);
+    point->y += 0.01f * (x - 0.1f * y);
+}
+
+// Generates wavy spines with 100 segments (or piecewise curves) each, or one
+// streamline seed per 100 segments on a regular grid.
+static bench_input create_input(bench_kind kind, uint32_t num_segments)
+{
+    bench_input input = {0};
+    const uint32_t num_spines = num_segments / 100;
+    if (kind == STREAMLINES) {
+        input.num_seeds = num_spines;
+        input.num_ticks = 101;
+        input.seeds = malloc(num_spines * sizeof(parsl_position));
+        for (uint32_t i = 0; i < num_spines; i++) {
+            input.seeds[i].x = (float) (i % 100) / 50 - 1;
+            input.seeds[i].y = (float) (i / 100) / 50 - 1;
+        }
+        return input;
+    }
+    const uint32_t spine_length = kind == LINES ? 101 : kind == CUBIC ?
+        4 + 99 * 2 : 3 + 99 * 2;
+    parsl_spine_list* spines = &input.spines;
+    spines->num_spines = num_spines;
+    spines->num_vertices = num_spines * spine_length;
+    spines->spine_lengths = malloc(num_spines * sizeof(uint16_t));
+    spines->vertices = malloc(spines->num_vertices * sizeof(parsl_position));
+    parsl_position* vertex = spines->vertices;
+    for (uint32_t spine = 0; spine < num_spines; spine++) {
+        spines->spine_lengths[spine] = spine_length;
+        for (uint32_t i = 0; i < spine_length; i++, vertex++) {
+            vertex->x = i * 0.5f;
+            vertex->y = spine * 4.0f + ((i % 4) == 1 ? 1.0f : 0.0f);
+        }
+    }
+    return input;
+}
+
+static void free_input(bench_input input)
+{
+    free(input.spines.spine_lengths);
+    free(input.spines.vertices);
+    free(input.seeds);
+}
+
+static parsl_mesh* run(parsl_context* ctx, bench_kind kind, bench_input input)
+{
+    switch (kind) {
+    case LINES:
+        return parsl_mesh_from_lines(ctx, input.spines);
+    case CUBIC:
+        return parsl_mesh_from_curves_cubic(ctx, input.spines);
+    case QUADRATIC:
+        return parsl_mesh_from_curves_quadratic(ctx, input.spines);
+    case STREAMLINES:
+        return parsl_mesh_from_streamlines(ctx, swirl, 0, input.num_ticks,
+            NULL);
+    }
+    return NULL;
+}
+
+typedef struct {
+    double min_rate;
+    double max_rate;
+    int first_allocations;
+    int steady_allocations;
+} bench_result;
+
+// Runs every flag combination. Each context is warmed up with two calls so that
+// its arrays reach their final capacity, and subsequent calls are timed.
+static bench_result bench(bench_kind kind, uint32_t num_segments)
+{
+    bench_result result = { .min_rate = 1e30 };
+    bench_input input = create_input(kind, num_segments);
+    const uint32_t num_runs = num_segments < MIN_SEGMENTS_PER_RUN ?
+        MIN_SEGMENTS_PER_RUN / num_segments : 1;
+    for (uint32_t flags = 0; flags < NUM_FLAG_COMBINATIONS; flags++) {
+        parsl_context* ctx = parsl_create_context((parsl_config) {
+            .thickness = 0.2f,
+            .flags = flags,
+            .curves_max_flatness = 0.1f,
+        });
+        if (kind == STREAMLINES) {
+            parsl_set_streamline_seeds(ctx, input.seeds, input.num_seeds);
+        }
+        num_allocations = 0;
+        run(ctx, kind, input);
+        result.first_allocations = PAR_MAX(result.first_allocations,
+            num_allocations);
+        run(ctx, kind, input);
+        num_allocations = 0;
+        uint64_t num_vertices = 0;
+        clock_t start = clock();
+        for (uint32_t i = 0; i < num_runs; i++) {
+            num_vertices += run(ctx, kind, input)->num_vertices;
+        }
+        const double seconds = PAR_MAX(elapsed_seconds(start), 1e-6);
+        result.steady_allocations += num_allocations;
+        result.min_rate = PAR_MIN(result.min_rate, num_vertices / seconds);
+        result.max_rate = PAR_MAX(result.max_rate, num_vertices / seconds);
+        parsl_destroy_context(ctx);
+    }
+    free_input(input);
+    return result;
+}
+
+int main()
+{
+    for (int kind = LINES; kind <= STREAMLINES; kind++) {
+        describe(kind_names[kind]) {
+            it("should not allocate once the context is warm") {
+                for (uint32_t n = 1000; n <= MAX_SEGMENTS; n *= 10) {
+                    bench_result r = bench(kind, n);
+                    printf("        %7u segments: %5.1f - %5.1f M verts/s, "
+                        "%d allocations\n", n, r.min_rate / 1e6,
+                        r.max_rate / 1e6, r.first_allocations);
+                    assert_equal(r.steady_allocations, 0);
+                }
+            }
+        }
+    }
+    return assert_failures();
+}
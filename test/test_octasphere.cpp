@@ -301,6 +301,360 @@ int main()
             generate_gltf("octasphere.gltf", "octasphere.bin", num_vertices, num_indices,
                     minpos, maxpos);
         }
+
+        it("should match 16-bit indices when using 32-bit indices") {
+            par_octasphere_config config = {
+                .corner_radius = 0.1,
+                .width = 1.2,
+                .height = 1.2,
+                .depth = 0.3,
+                .num_subdivisions = 4,
+            };
+            uint32_t num_indices;
+            uint32_t num_vertices;
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+
+            par_octasphere_mesh narrow = {};
+            narrow.positions = (float*)malloc(num_vertices * 12);
+            narrow.indices = (uint16_t*)malloc(num_indices * 2);
+            par_octasphere_populate(&config, &narrow);
+
+            config.indices_mode = PAR_OCTASPHERE_INDICES_32;
+            par_octasphere_mesh wide = {};
+            wide.positions = (float*)malloc(num_vertices * 12);
+            wide.indices32 = (uint32_t*)malloc(num_indices * 4);
+            par_octasphere_populate(&config, &wide);
+
+            assert_equal(wide.num_indices, narrow.num_indices);
+            assert_equal(wide.num_vertices, narrow.num_vertices);
+            bool same = true;
+            for (uint32_t i = 0; i < wide.num_indices; i++) {
+                same = same && wide.indices32[i] == narrow.indices[i];
+            }
+            assert_ok(same);
+
+            free(narrow.positions);
+            free(narrow.indices);
+            free(wide.positions);
+            free(wide.indices32);
+        }
+
+        it("should allow more subdivisions with 32-bit indices") {
+            par_octasphere_config config = {
+                .corner_radius = 0.4,
+                .width = 1.2,
+                .height = 1.2,
+                .depth = 1.2,
+                .num_subdivisions = 8,
+                .indices_mode = PAR_OCTASPHERE_INDICES_32,
+            };
+            uint32_t num_indices;
+            uint32_t num_vertices;
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+            assert_equal(num_vertices, 8 * 257 * 258 / 2);
+
+            par_octasphere_mesh octasphere = {};
+            octasphere.positions = (float*)malloc(num_vertices * 12);
+            octasphere.indices32 = (uint32_t*)malloc(num_indices * 4);
+            par_octasphere_populate(&config, &octasphere);
+            assert_ok(octasphere.num_indices <= num_indices);
+            uint32_t max_index = 0;
+            for (uint32_t i = 0; i < octasphere.num_indices; i++) {
+                max_index = PARO_MAX(max_index, octasphere.indices32[i]);
+            }
+            assert_equal(max_index, num_vertices - 1);
+            free(octasphere.positions);
+            free(octasphere.indices32);
+
+            config.num_subdivisions = 100;
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+            assert_equal(num_vertices, 8 * 4097 * 4098 / 2);
+            config.indices_mode = PAR_OCTASPHERE_INDICES_16;
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+            assert_equal(num_vertices, 8 * 33 * 34 / 2);
+        }
+
+        it("should pack a batch into a single mesh") {
+            par_octasphere_config configs[3] = {
+                {.corner_radius = 1, .num_subdivisions = 2},
+                {.corner_radius = 0.1, .width = 1.2, .height = 1.2, .depth = 0.3,
+                 .num_subdivisions = 3},
+                {.corner_radius = 0.5, .width = 3, .num_subdivisions = 1},
+            };
+            uint32_t index_offsets[4];
+            uint32_t vertex_offsets[4];
+            par_octasphere_get_batch_offsets(configs, 3, index_offsets, vertex_offsets);
+            const uint32_t num_indices = index_offsets[3];
+            const uint32_t num_vertices = vertex_offsets[3];
+
+            par_octasphere_mesh batch = {};
+            batch.positions = (float*)malloc(num_vertices * 12);
+            batch.normals = (float*)malloc(num_vertices * 12);
+            batch.indices = (uint16_t*)malloc(num_indices * 2);
+            par_octasphere_populate_batch(configs, 3, index_offsets, vertex_offsets, NULL, &batch);
+            assert_equal(batch.num_indices, num_indices);
+            assert_equal(batch.num_vertices, num_vertices);
+
+            bool same = true;
+            for (int i = 0; i < 3; i++) {
+                uint32_t expected_indices, expected_vertices;
+                par_octasphere_get_counts(&configs[i], &expected_indices, &expected_vertices);
+                same = same && index_offsets[i + 1] - index_offsets[i] == expected_indices;
+                same = same && vertex_offsets[i + 1] - vertex_offsets[i] == expected_vertices;
+                par_octasphere_mesh single = {};
+                single.positions = (float*)malloc(expected_vertices * 12);
+                single.indices = (uint16_t*)malloc(expected_indices * 2);
+                par_octasphere_populate(&configs[i], &single);
+                same = same && !memcmp(single.positions, batch.positions + vertex_offsets[i] * 3,
+                                       single.num_vertices * 12);
+                for (uint32_t j = 0; j < single.num_indices; j++) {
+                    const uint32_t index = batch.indices[index_offsets[i] + j];
+                    same = same && index == single.indices[j] + vertex_offsets[i];
+                }
+                free(single.positions);
+                free(single.indices);
+            }
+            assert_ok(same);
+
+            free(batch.positions);
+            free(batch.normals);
+            free(batch.indices);
+        }
+
+        it("should populate from a cached unit sphere") {
+            const par_octasphere_config unit_config = {.corner_radius = 1, .num_subdivisions = 3};
+            uint32_t num_indices;
+            uint32_t num_vertices;
+            par_octasphere_get_counts(&unit_config, &num_indices, &num_vertices);
+            par_octasphere_mesh unit_sphere = {};
+            unit_sphere.positions = (float*)malloc(num_vertices * 12);
+            unit_sphere.texcoords = (float*)malloc(num_vertices * 8);
+            unit_sphere.indices = (uint16_t*)malloc(num_indices * 2);
+            par_octasphere_populate(&unit_config, &unit_sphere);
+
+            par_octasphere_config configs[3] = {
+                {.corner_radius = 2, .num_subdivisions = 3},
+                {.corner_radius = 0.4, .width = 1.2, .height = 1.2, .depth = 1.2,
+                 .num_subdivisions = 3},
+                {.corner_radius = 0.5, .height = 3, .num_subdivisions = 3},
+            };
+            bool same = true;
+            for (int i = 0; i < 3; i++) {
+                par_octasphere_get_counts(&configs[i], &num_indices, &num_vertices);
+                par_octasphere_mesh meshes[2] = {};
+                for (int j = 0; j < 2; j++) {
+                    meshes[j].positions = (float*)malloc(num_vertices * 12);
+                    meshes[j].normals = (float*)malloc(num_vertices * 12);
+                    meshes[j].texcoords = (float*)malloc(num_vertices * 8);
+                    meshes[j].indices = (uint16_t*)malloc(num_indices * 2);
+                }
+                par_octasphere_populate(&configs[i], &meshes[0]);
+                par_octasphere_populate_cached(&unit_sphere, &configs[i], &meshes[1]);
+                same = same && meshes[0].num_indices == meshes[1].num_indices;
+                same = same && meshes[0].num_vertices == meshes[1].num_vertices;
+                same = same && !memcmp(meshes[0].positions, meshes[1].positions,
+                                       num_vertices * 12);
+                same = same && !memcmp(meshes[0].normals, meshes[1].normals, num_vertices * 12);
+                same = same && !memcmp(meshes[0].texcoords, meshes[1].texcoords,
+                                       num_vertices * 8);
+                same = same && !memcmp(meshes[0].indices, meshes[1].indices,
+                                       meshes[0].num_indices * 2);
+                for (int j = 0; j < 2; j++) {
+                    free(meshes[j].positions);
+                    free(meshes[j].normals);
+                    free(meshes[j].texcoords);
+                    free(meshes[j].indices);
+                }
+            }
+            assert_ok(same);
+
+            uint32_t index_offsets[4];
+            uint32_t vertex_offsets[4];
+            par_octasphere_get_batch_offsets(configs, 3, index_offsets, vertex_offsets);
+            par_octasphere_mesh batches[2] = {};
+            for (int j = 0; j < 2; j++) {
+                batches[j].positions = (float*)malloc(vertex_offsets[3] * 12);
+                batches[j].indices = (uint16_t*)malloc(index_offsets[3] * 2);
+            }
+            par_octasphere_populate_batch(configs, 3, index_offsets, vertex_offsets, NULL,
+                                          &batches[0]);
+            par_octasphere_populate_batch(configs, 3, index_offsets, vertex_offsets,
+                                          &unit_sphere, &batches[1]);
+            assert_ok(!memcmp(batches[0].positions, batches[1].positions,
+                              vertex_offsets[3] * 12));
+            assert_ok(!memcmp(batches[0].indices, batches[1].indices, index_offsets[3] * 2));
+            for (int j = 0; j < 2; j++) {
+                free(batches[j].positions);
+                free(batches[j].indices);
+            }
+
+            // The unit sphere has 16-bit indices, so it must be ignored for 32-bit configs.
+            for (int i = 0; i < 3; i++) {
+                configs[i].indices_mode = PAR_OCTASPHERE_INDICES_32;
+            }
+            for (int j = 0; j < 2; j++) {
+                batches[j].positions = (float*)malloc(vertex_offsets[3] * 12);
+                batches[j].indices32 = (uint32_t*)malloc(index_offsets[3] * 4);
+            }
+            par_octasphere_populate_batch(configs, 3, index_offsets, vertex_offsets, NULL,
+                                          &batches[0]);
+            par_octasphere_populate_batch(configs, 3, index_offsets, vertex_offsets,
+                                          &unit_sphere, &batches[1]);
+            assert_ok(!memcmp(batches[0].positions, batches[1].positions,
+                              vertex_offsets[3] * 12));
+            assert_ok(!memcmp(batches[0].indices32, batches[1].indices32, index_offsets[3] * 4));
+            for (int j = 0; j < 2; j++) {
+                free(batches[j].positions);
+                free(batches[j].indices32);
+            }
+
+            free(unit_sphere.positions);
+            free(unit_sphere.texcoords);
+            free(unit_sphere.indices);
+        }
+
+        it("should write interleaved vertices") {
+            struct vertex {
+                float position[3];
+                float normal[3];
+                float texcoord[2];
+            };
+            par_octasphere_config config = {
+                .corner_radius = 0.4,
+                .width = 1.2,
+                .height = 1.2,
+                .depth = 1.2,
+                .num_subdivisions = 3,
+            };
+            uint32_t num_indices;
+            uint32_t num_vertices;
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+
+            par_octasphere_mesh packed = {};
+            packed.positions = (float*)malloc(num_vertices * 12);
+            packed.normals = (float*)malloc(num_vertices * 12);
+            packed.texcoords = (float*)malloc(num_vertices * 8);
+            packed.indices = (uint16_t*)malloc(num_indices * 2);
+            par_octasphere_populate(&config, &packed);
+
+            vertex* vertices = (vertex*)malloc(num_vertices * sizeof(vertex));
+            par_octasphere_mesh interleaved = {};
+            interleaved.positions = vertices[0].position;
+            interleaved.normals = vertices[0].normal;
+            interleaved.texcoords = vertices[0].texcoord;
+            interleaved.indices = (uint16_t*)malloc(num_indices * 2);
+            interleaved.positions_stride = sizeof(vertex);
+            interleaved.normals_stride = sizeof(vertex);
+            interleaved.texcoords_stride = sizeof(vertex);
+            par_octasphere_populate(&config, &interleaved);
+            assert_equal(interleaved.num_indices, packed.num_indices);
+
+            bool same = true;
+            for (uint32_t i = 0; i < num_vertices; i++) {
+                same = same && !memcmp(vertices[i].position, packed.positions + i * 3, 12);
+                same = same && !memcmp(vertices[i].normal, packed.normals + i * 3, 12);
+                same = same && !memcmp(vertices[i].texcoord, packed.texcoords + i * 2, 8);
+            }
+            assert_ok(same);
+            assert_ok(!memcmp(interleaved.indices, packed.indices, packed.num_indices * 2));
+
+            free(vertices);
+            free(interleaved.indices);
+            free(packed.positions);
+            free(packed.normals);
+            free(packed.texcoords);
+            free(packed.indices);
+        }
+
+        it("should encode octahedral normals") {
+            par_octasphere_config config = {
+                .corner_radius = 0.5,
+                .width = 2,
+                .num_subdivisions = 4,
+            };
+            uint32_t num_indices;
+            uint32_t num_vertices;
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+            par_octasphere_mesh octasphere = {};
+            octasphere.positions = (float*)malloc(num_vertices * 12);
+            octasphere.normals = (float*)malloc(num_vertices * 12);
+            octasphere.octahedral_normals = (int16_t*)malloc(num_vertices * 4);
+            octasphere.indices = (uint16_t*)malloc(num_indices * 2);
+            par_octasphere_populate(&config, &octasphere);
+
+            float max_error = 0;
+            for (uint32_t i = 0; i < num_vertices; i++) {
+                float x = octasphere.octahedral_normals[i * 2 + 0] / 32767.0f;
+                float y = octasphere.octahedral_normals[i * 2 + 1] / 32767.0f;
+                float z = 1 - fabsf(x) - fabsf(y);
+                if (z < 0) {
+                    const float folded_x = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+                    const float folded_y = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+                    x = folded_x;
+                    y = folded_y;
+                }
+                const float length = sqrtf(x * x + y * y + z * z);
+                const float* expected = octasphere.normals + i * 3;
+                max_error = PARO_MAX(max_error, fabsf(x / length - expected[0]));
+                max_error = PARO_MAX(max_error, fabsf(y / length - expected[1]));
+                max_error = PARO_MAX(max_error, fabsf(z / length - expected[2]));
+            }
+            assert_ok(max_error < 0.001f);
+
+            free(octasphere.positions);
+            free(octasphere.normals);
+            free(octasphere.octahedral_normals);
+            free(octasphere.indices);
+        }
+
+        it("should update positions while keeping the topology") {
+            const par_octasphere_config unit_config = {.corner_radius = 1, .num_subdivisions = 3};
+            uint32_t num_indices;
+            uint32_t num_vertices;
+            par_octasphere_get_counts(&unit_config, &num_indices, &num_vertices);
+            par_octasphere_mesh unit_sphere = {};
+            unit_sphere.positions = (float*)malloc(num_vertices * 12);
+            unit_sphere.indices = (uint16_t*)malloc(num_indices * 2);
+            par_octasphere_populate(&unit_config, &unit_sphere);
+
+            par_octasphere_config config = {
+                .corner_radius = 0.1,
+                .width = 1.2,
+                .height = 1.2,
+                .depth = 0.3,
+                .num_subdivisions = 3,
+            };
+            par_octasphere_get_counts(&config, &num_indices, &num_vertices);
+            par_octasphere_mesh meshes[2] = {};
+            for (int j = 0; j < 2; j++) {
+                meshes[j].positions = (float*)malloc(num_vertices * 12);
+                meshes[j].indices = (uint16_t*)malloc(num_indices * 2);
+            }
+            par_octasphere_populate(&config, &meshes[0]);
+
+            config.width = 2.5;
+            config.corner_radius = 0.2;
+            assert_ok(par_octasphere_update_positions(&unit_sphere, &config, &meshes[0]));
+            par_octasphere_populate(&config, &meshes[1]);
+            assert_equal(meshes[0].num_indices, meshes[1].num_indices);
+            assert_ok(!memcmp(meshes[0].positions, meshes[1].positions, num_vertices * 12));
+            assert_ok(!memcmp(meshes[0].indices, meshes[1].indices, num_indices * 2));
+
+            config.width = config.height = config.depth = 0;
+            assert_ok(par_octasphere_update_positions(&unit_sphere, &config, &meshes[0]));
+            par_octasphere_populate(&config, &meshes[1]);
+            assert_ok(!memcmp(meshes[0].positions, meshes[1].positions, num_vertices * 12));
+
+            config.width = 2;
+            assert_ok(!par_octasphere_update_positions(&unit_sphere, &config, &meshes[1]));
+
+            for (int j = 0; j < 2; j++) {
+                free(meshes[j].positions);
+                free(meshes[j].indices);
+            }
+            free(unit_sphere.positions);
+            free(unit_sphere.indices);
+        }
     }
 
     return assert_failures();
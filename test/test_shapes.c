@@ -3,11 +3,52 @@
 #define PAR_SHAPES_IMPLEMENTATION
 #include "par_shapes.h"
 
+#define CGLTF_IMPLEMENTATION
+#include "cgltf.h"
+
 #include <fcntl.h>
 #include <unistd.h>
 
 #define STRINGIFY(A) #A
 
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} membuf;
+
+static bool write_membuf(void const* data, size_t nbytes, void* userdata)
+{
+    membuf* buf = (membuf*) userdata;
+    if (buf->size + nbytes > buf->capacity) {
+        buf->capacity = (buf->size + nbytes) * 2;
+        buf->data = realloc(buf->data, buf->capacity);
+    }
+    memcpy(buf->data + buf->size, data, nbytes);
+    buf->size += nbytes;
+    return true;
+}
+
+static bool wavy_surface(float const* u, float const* v, int count,
+    float* xyz, float* normals, void* userdata)
+{
+    for (int i = 0; i < count; i++) {
+        xyz[i * 3 + 0] = u[i];
+        xyz[i * 3 + 1] = v[i];
+        xyz[i * 3 + 2] = 0.1f * sinf(u[i] * 6.0f);
+    }
+    return false;
+}
+
+static void custom_sphere(float const* uv, float* xyz, void* userdata)
+{
+    float phi = uv[0] * 3.14159265f;
+    float theta = uv[1] * 2 * 3.14159265f;
+    xyz[0] = cosf(theta) * sinf(phi);
+    xyz[1] = sinf(theta) * sinf(phi);
+    xyz[2] = cosf(phi);
+}
+
 int main()
 {
     describe("cylinders and spheres") {
@@ -51,6 +92,133 @@ int main()
         }
     }
 
+    describe("par_shapes_create_parametric_batch") {
+        it("should use analytic normals from built-in surfaces") {
+            par_shapes_mesh* m = par_shapes_create_parametric_sphere(20, 20);
+            for (int i = 0; i < m->npoints * 3; i++) {
+                assert_ok(m->normals[i] == m->points[i]);
+            }
+            par_shapes_free_mesh(m);
+        }
+        it("should compute normals when the callback does not") {
+            par_shapes_mesh* m = par_shapes_create_parametric_batch(
+                wavy_surface, 10, 12, 0);
+            assert_equal(m->npoints, 11 * 13);
+            assert_ok(m->normals);
+            assert_ok(m->tcoords[m->npoints * 2 - 1] == 1.0f);
+            for (int i = 0; i < m->npoints; i++) {
+                assert_ok(m->normals[i * 3 + 2] > 0.5f);
+            }
+            par_shapes_free_mesh(m);
+        }
+    }
+
+    describe("par_shapes_populate") {
+        it("should match the allocating generators") {
+            par_shapes_config config = {PAR_SHAPES_SURFACE_SPHERE, 12, 13};
+            int npoints, ntriangles;
+            assert_ok(par_shapes_get_counts(&config, &npoints, &ntriangles));
+            par_shapes_mesh* a = par_shapes_create_parametric_sphere(12, 13);
+            assert_equal(npoints, a->npoints);
+            assert_equal(ntriangles, a->ntriangles);
+            float points[14 * 13 * 3];
+            float normals[14 * 13 * 3];
+            float tcoords[14 * 13 * 2];
+            PAR_SHAPES_T triangles[12 * 12 * 2 * 3];
+            par_shapes_mesh b = {0};
+            b.points = points;
+            b.normals = normals;
+            b.tcoords = tcoords;
+            b.triangles = triangles;
+            assert_ok(par_shapes_populate(&config, &b));
+            assert_equal(b.npoints, npoints);
+            assert_equal(b.ntriangles, ntriangles);
+            assert_ok(!memcmp(a->points, points, sizeof(points)));
+            assert_ok(!memcmp(a->normals, normals, sizeof(normals)));
+            assert_ok(!memcmp(a->tcoords, tcoords, sizeof(tcoords)));
+            assert_ok(!memcmp(a->triangles, triangles, sizeof(triangles)));
+            par_shapes_free_mesh(a);
+        }
+        it("should reject invalid configs and narrow indices") {
+            int npoints, ntriangles;
+            par_shapes_config bad = {PAR_SHAPES_SURFACE_TORUS, 2, 3, 0.5};
+            assert_ok(!par_shapes_get_counts(&bad, &npoints, &ntriangles));
+            par_shapes_config big = {PAR_SHAPES_SURFACE_PLANE, 300, 300};
+            par_shapes_config config_plane_small = {PAR_SHAPES_SURFACE_PLANE,
+                2, 2};
+            assert_ok(par_shapes_get_counts(&big, &npoints, &ntriangles));
+            float* points = PAR_MALLOC(float, npoints * 3);
+            PAR_SHAPES_T* triangles = PAR_MALLOC(PAR_SHAPES_T, ntriangles * 3);
+            par_shapes_mesh m = {0};
+            m.points = points;
+            assert_ok(!par_shapes_populate(&config_plane_small, &m));
+            m.triangles = triangles;
+            assert_ok(!par_shapes_populate(&big, &m));
+            PAR_FREE(triangles);
+            m.triangles = 0;
+            m.triangles32 = PAR_MALLOC(uint32_t, ntriangles * 3);
+            assert_ok(par_shapes_populate(&big, &m));
+            assert_equal((int) m.triangles32[ntriangles * 3 - 1],
+                npoints - 301 - 1);
+            PAR_FREE(points);
+            PAR_FREE(m.triangles32);
+        }
+        it("should generate fixed-size solids and disks") {
+            par_shapes_mesh* solids[] = {
+                par_shapes_create_icosahedron(),
+                par_shapes_create_dodecahedron(),
+                par_shapes_create_octahedron(),
+                par_shapes_create_tetrahedron(),
+                par_shapes_create_cube(),
+            };
+            par_shapes_surface surfaces[] = {
+                PAR_SHAPES_SURFACE_ICOSAHEDRON,
+                PAR_SHAPES_SURFACE_DODECAHEDRON,
+                PAR_SHAPES_SURFACE_OCTAHEDRON,
+                PAR_SHAPES_SURFACE_TETRAHEDRON,
+                PAR_SHAPES_SURFACE_CUBE,
+            };
+            float points[20 * 3];
+            uint32_t triangles[36 * 3];
+            for (int i = 0; i < 5; i++) {
+                par_shapes_config config = {surfaces[i]};
+                int npoints, ntriangles;
+                assert_ok(par_shapes_get_counts(&config, &npoints,
+                    &ntriangles));
+                assert_equal(npoints, solids[i]->npoints);
+                assert_equal(ntriangles, solids[i]->ntriangles);
+                par_shapes_mesh m = {0};
+                m.points = points;
+                m.triangles32 = triangles;
+                assert_ok(par_shapes_populate(&config, &m));
+                assert_ok(!memcmp(solids[i]->points, points,
+                    sizeof(float) * 3 * npoints));
+                for (int j = 0; j < ntriangles * 3; j++) {
+                    assert_ok(triangles[j] == solids[i]->triangles[j]);
+                }
+                par_shapes_free_mesh(solids[i]);
+            }
+            par_shapes_config disk = {PAR_SHAPES_SURFACE_DISK, 12, 0, 2};
+            int npoints, ntriangles;
+            assert_ok(par_shapes_get_counts(&disk, &npoints, &ntriangles));
+            assert_equal(npoints, 13);
+            assert_equal(ntriangles, 12);
+            float normals[13 * 3];
+            par_shapes_mesh m = {0};
+            m.points = points;
+            m.normals = normals;
+            m.triangles32 = triangles;
+            assert_ok(par_shapes_populate(&disk, &m));
+            for (int i = 1; i < npoints; i++) {
+                float const* p = points + i * 3;
+                assert_ok(fabsf(p[0] * p[0] + p[1] * p[1] - 4) < 0.001f);
+                assert_ok(normals[i * 3 + 2] == 1);
+            }
+            disk.slices = 2;
+            assert_ok(!par_shapes_get_counts(&disk, &npoints, &ntriangles));
+        }
+    }
+
     describe("par_shapes_create_plane") {
         it("should not have NaN's") {
             par_shapes_mesh* m = par_shapes_create_plane(5, 6);
@@ -125,6 +293,63 @@ int main()
             par_shapes_free_mesh(m);
 
         }
+        it("should generate a binary blob") {
+            par_shapes_mesh* m = par_shapes_create_torus(7, 10, 0.5);
+            membuf buf = {0};
+            assert_ok(par_shapes_export_binary(m, PAR_SHAPES_FORMAT_BLOB,
+                write_membuf, &buf));
+            uint32_t const* header = (uint32_t const*) buf.data;
+            assert_ok(!memcmp(buf.data, "PARS", 4));
+            assert_equal((int) header[2], m->npoints);
+            assert_equal((int) header[3], m->ntriangles);
+            int flags = 3 | (int) (sizeof(PAR_SHAPES_T) << 8);
+            assert_equal((int) header[4], flags);
+            size_t isize = sizeof(PAR_SHAPES_T) * 3 * m->ntriangles;
+            size_t expected = 20 + sizeof(float) * 8 * m->npoints +
+                ((isize + 3) & ~3);
+            assert_equal((int) buf.size, (int) expected);
+            float const* points = (float const*) (buf.data + 20);
+            assert_ok(!memcmp(points, m->points, 12 * m->npoints));
+            free(buf.data);
+            par_shapes_free_mesh(m);
+        }
+        it("should generate a binary PLY file") {
+            par_shapes_mesh* m = par_shapes_create_cube();
+            membuf buf = {0};
+            assert_ok(par_shapes_export_binary(m, PAR_SHAPES_FORMAT_PLY,
+                write_membuf, &buf));
+            char const* end = strstr(buf.data, "end_header\n");
+            assert_ok(end);
+            size_t hlen = end + 11 - buf.data;
+            assert_equal((int) (buf.size - hlen),
+                m->npoints * 12 + m->ntriangles * 13);
+            assert_ok(par_shapes_export_file(m, PAR_SHAPES_FORMAT_PLY,
+                "build/test_shapes_cube.ply"));
+            free(buf.data);
+            par_shapes_free_mesh(m);
+        }
+        it("should generate a valid GLB file") {
+            par_shapes_mesh* m = par_shapes_create_trefoil_knot(20, 100, 0.5);
+            membuf buf = {0};
+            assert_ok(par_shapes_export_binary(m, PAR_SHAPES_FORMAT_GLB,
+                write_membuf, &buf));
+            assert_equal((int) (buf.size % 4), 0);
+            cgltf_options options = {0};
+            cgltf_data* data = 0;
+            assert_equal(cgltf_parse(&options, buf.data, buf.size, &data),
+                cgltf_result_success);
+            assert_equal(cgltf_load_buffers(&options, data, 0),
+                cgltf_result_success);
+            assert_equal(cgltf_validate(data), cgltf_result_success);
+            assert_equal((int) data->meshes[0].primitives[0].attributes_count,
+                3);
+            assert_equal((int) data->accessors[3].count, m->ntriangles * 3);
+            cgltf_free(data);
+            assert_ok(par_shapes_export_file(m, PAR_SHAPES_FORMAT_GLB,
+                "build/test_shapes_trefoil.glb"));
+            free(buf.data);
+            par_shapes_free_mesh(m);
+        }
     }
 
     describe("par_shapes_merge") {
@@ -140,6 +365,144 @@ int main()
             par_shapes_free_mesh(a);
             par_shapes_free_mesh(b);
         }
+        it("should promote to 32-bit indices when needed") {
+            par_shapes_mesh* a, *b;
+            a = par_shapes_create_empty();
+            b = par_shapes_create_plane(100, 100);
+            int ninstances = 8;
+            for (int i = 0; i < ninstances; i++) {
+                par_shapes_merge(a, b);
+            }
+            assert_equal(a->npoints, b->npoints * ninstances);
+            assert_null(a->triangles);
+            assert_ok(a->triangles32);
+            int last = a->ntriangles * 3 - 1;
+            int expected = b->triangles[b->ntriangles * 3 - 1] +
+                b->npoints * (ninstances - 1);
+            assert_equal((int) a->triangles32[last], expected);
+            par_shapes_mesh* c = par_shapes_clone(a, 0);
+            par_shapes_merge(c, b);
+            assert_ok(c->triangles32);
+            assert_equal(c->ntriangles, a->ntriangles + b->ntriangles);
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+            par_shapes_free_mesh(c);
+        }
+        it("should support large subdivided spheres") {
+            par_shapes_mesh* m = par_shapes_create_subdivided_sphere(6);
+            assert_equal(m->npoints, 10 * 4096 + 2);
+            assert_equal(m->ntriangles, 20 * 4096);
+            par_shapes_free_mesh(m);
+        }
+        it("should support very deep subdivided spheres") {
+            par_shapes_mesh* m = par_shapes_create_subdivided_sphere(8);
+            assert_equal(m->npoints, 10 * 65536 + 2);
+            assert_equal(m->ntriangles, 20 * 65536);
+            assert_ok(m->triangles32);
+            par_shapes_free_mesh(m);
+        }
+    }
+
+    describe("par_shapes_subdivide") {
+        it("should share midpoints between neighboring triangles") {
+            par_shapes_mesh* m = par_shapes_create_cube();
+            int npoints = m->npoints;
+            int ntriangles = m->ntriangles;
+            par_shapes_subdivide(m);
+            assert_equal(m->ntriangles, ntriangles * 4);
+            // The cube has 12 triangles and 18 unique edges.
+            assert_equal(m->npoints, npoints + 18);
+            par_shapes_free_mesh(m);
+        }
+        it("should interpolate texture coordinates") {
+            par_shapes_mesh* m = par_shapes_create_plane(1, 1);
+            par_shapes_subdivide(m);
+            assert_equal(m->npoints, 9);
+            assert_equal(m->ntriangles, 8);
+            for (int i = 0; i < m->npoints; i++) {
+                float const* p = m->points + i * 3;
+                float const* t = m->tcoords + i * 2;
+                assert_ok(p[0] == t[0] && p[1] == t[1]);
+                assert_ok(m->normals[i * 3 + 2] == 1);
+            }
+            par_shapes_free_mesh(m);
+        }
+    }
+
+    describe("par_shapes_weld") {
+        it("should recover shared vertices of an unwelded mesh") {
+            par_shapes_mesh* a = par_shapes_create_subdivided_sphere(3);
+            par_shapes_mesh* b = par_shapes_clone(a, 0);
+            par_shapes_unweld(b, true);
+            assert_equal(b->npoints, a->ntriangles * 3);
+            PAR_SHAPES_T* mapping = PAR_MALLOC(PAR_SHAPES_T, b->npoints);
+            par_shapes_mesh* c = par_shapes_weld(b, 0.01, mapping);
+            assert_equal(c->npoints, a->npoints);
+            assert_equal(c->ntriangles, a->ntriangles);
+            for (int i = 0; i < b->npoints; i++) {
+                float const* src = b->points + i * 3;
+                float const* dst = c->points + mapping[i] * 3;
+                assert_ok(src[0] == dst[0]);
+                assert_ok(src[1] == dst[1]);
+                assert_ok(src[2] == dst[2]);
+                float const* src_normal = b->normals + i * 3;
+                float const* dst_normal = c->normals + mapping[i] * 3;
+                assert_ok(src_normal[0] == dst_normal[0]);
+                assert_ok(src_normal[1] == dst_normal[1]);
+                assert_ok(src_normal[2] == dst_normal[2]);
+            }
+            PAR_FREE(mapping);
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+            par_shapes_free_mesh(c);
+        }
+        it("should weld meshes with 32-bit indices") {
+            par_shapes_mesh* a = par_shapes_create_empty();
+            par_shapes_mesh* b = par_shapes_create_plane(200, 200);
+            par_shapes_merge(a, b);
+            par_shapes_merge(a, b);
+            assert_ok(a->triangles32);
+            par_shapes_mesh* c = par_shapes_weld(a, 0.0001, 0);
+            assert_equal(c->npoints, b->npoints);
+            assert_equal(c->ntriangles, a->ntriangles);
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+            par_shapes_free_mesh(c);
+        }
+        it("should not chain welds beyond epsilon") {
+            // Epsilon is measured where the bounding box spans 19 units, so
+            // a distant point makes the chain's spacing exactly 0.05.
+            par_shapes_mesh* a = par_shapes_create_empty();
+            a->npoints = 41;
+            a->points = PAR_CALLOC(float, 3 * a->npoints);
+            for (int i = 0; i < 40; i++) {
+                a->points[i * 3] = i * 0.05f;
+            }
+            a->points[40 * 3] = 19;
+            PAR_SHAPES_T* mapping = PAR_MALLOC(PAR_SHAPES_T, a->npoints);
+            par_shapes_mesh* b = par_shapes_weld(a, 0.01, mapping);
+            assert_ok(b->npoints >= 13);
+            for (int i = 0; i < a->npoints; i++) {
+                float dx = a->points[i * 3] - b->points[mapping[i] * 3];
+                assert_ok(dx * dx < 0.01f);
+            }
+            PAR_FREE(mapping);
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+        }
+        it("should compute accurate welded normals on dense surfaces") {
+            par_shapes_mesh* m = par_shapes_create_parametric(custom_sphere,
+                128, 128, 0);
+            int nbad = 0;
+            for (int i = 0; i < m->npoints; i++) {
+                float const* p = m->points + i * 3;
+                float const* n = m->normals + i * 3;
+                float d = p[0] * n[0] + p[1] * n[1] + p[2] * n[2];
+                nbad += d < cosf(8 * 3.14159265f / 180);
+            }
+            assert_equal(nbad, 0);
+            par_shapes_free_mesh(m);
+        }
     }
 
     describe("transforms") {
@@ -189,6 +552,122 @@ int main()
             }
             par_shapes_free_mesh(a);
         }
+        it("should match individual transforms with a single matrix") {
+            par_shapes_mesh* a = par_shapes_create_torus(10, 15, 0.2);
+            par_shapes_mesh* b = par_shapes_clone(a, 0);
+            par_shapes_scale(a, 2, 3, 0.5);
+            par_shapes_translate(a, 1, -2, 3);
+            float mat[16] = {
+                2, 0, 0, 0,
+                0, 3, 0, 0,
+                0, 0, 0.5, 0,
+                1, -2, 3, 1,
+            };
+            par_shapes_transform(b, mat);
+            for (int i = 0; i < a->npoints * 3; i++) {
+                assert_ok(fabs(a->points[i] - b->points[i]) < 0.0001);
+                assert_ok(fabs(a->normals[i] - b->normals[i]) < 0.0001);
+            }
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+        }
+        it("should handle degenerate scale in a matrix") {
+            par_shapes_mesh* a = par_shapes_create_cone(15, 3);
+            float mat[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+            par_shapes_transform(a, mat);
+            for (int i = 0; i < a->npoints * 3; i++) {
+                assert_ok(a->normals[i] == (i % 3 == 2 ? 1.0f : 0.0f));
+            }
+            par_shapes_free_mesh(a);
+        }
+        it("should merge many transformed meshes at once") {
+            par_shapes_mesh const* srcs[3];
+            par_shapes_mesh* a = par_shapes_create_cube();
+            par_shapes_mesh* b = par_shapes_create_plane(3, 3);
+            srcs[0] = a;
+            srcs[1] = b;
+            srcs[2] = a;
+            float mats[48] = {0};
+            for (int i = 0; i < 3; i++) {
+                mats[i * 16 + 0] = mats[i * 16 + 5] = 1;
+                mats[i * 16 + 10] = mats[i * 16 + 15] = 1;
+                mats[i * 16 + 12] = i * 2;
+            }
+            par_shapes_mesh* c = par_shapes_create_empty();
+            par_shapes_merge_transformed(c, srcs, mats, 3);
+            assert_equal(c->npoints, a->npoints * 2 + b->npoints);
+            assert_equal(c->ntriangles, a->ntriangles * 2 + b->ntriangles);
+            assert_ok(c->tcoords && c->normals);
+            int last = a->npoints + b->npoints;
+            assert_ok(c->points[last * 3] == a->points[0] + 4);
+            assert_equal(c->triangles[c->ntriangles * 3 - 1],
+                last + a->triangles[a->ntriangles * 3 - 1]);
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+            par_shapes_free_mesh(c);
+        }
+    }
+
+    describe("par_shapes_merge_instances") {
+        it("should place transformed copies of one mesh") {
+            const int ninstances = 500;
+            par_shapes_mesh* rock = par_shapes_create_rock(1, 2);
+            float* mats = PAR_CALLOC(float, 16 * ninstances);
+            for (int i = 0; i < ninstances; i++) {
+                float* m = mats + i * 16;
+                m[0] = m[5] = m[10] = m[15] = 1;
+                m[12] = i;
+            }
+            int* ptoffsets = PAR_MALLOC(int, ninstances);
+            int* trioffsets = PAR_MALLOC(int, ninstances);
+            par_shapes_mesh* forest = par_shapes_create_plane(1, 1);
+            int nplane = forest->npoints;
+            par_shapes_merge_instances(forest, rock, mats, ninstances,
+                ptoffsets, trioffsets);
+            assert_equal(forest->npoints, nplane + rock->npoints * ninstances);
+            assert_ok(forest->triangles32);
+            for (int i = 0; i < ninstances; i++) {
+                assert_equal(ptoffsets[i], nplane + i * rock->npoints);
+                assert_equal(trioffsets[i], 2 + i * rock->ntriangles);
+                float const* p = forest->points + ptoffsets[i] * 3;
+                assert_ok(p[0] == rock->points[0] + i);
+                int f = trioffsets[i] * 3;
+                assert_equal((int) forest->triangles32[f],
+                    ptoffsets[i] + rock->triangles[0]);
+            }
+            PAR_FREE(mats);
+            PAR_FREE(ptoffsets);
+            PAR_FREE(trioffsets);
+            par_shapes_free_mesh(rock);
+            par_shapes_free_mesh(forest);
+        }
+    }
+
+    describe("par_shapes_compute_normals") {
+        it("should be independent of tessellation when angle weighted") {
+            par_shapes_mesh* m = par_shapes_create_cube();
+            par_shapes_compute_angle_weighted_normals(m);
+            for (int i = 0; i < m->npoints; i++) {
+                float const* p = m->points + i * 3;
+                float const* n = m->normals + i * 3;
+                for (int c = 0; c < 3; c++) {
+                    float expected = (p[c] - 0.5f) * 2.0f / sqrtf(3.0f);
+                    assert_ok(fabs(n[c] - expected) < 0.0001);
+                }
+            }
+            par_shapes_free_mesh(m);
+        }
+        it("should produce unit normals for large meshes") {
+            par_shapes_mesh* m = par_shapes_create_subdivided_sphere(5);
+            par_shapes_compute_normals(m);
+            for (int i = 0; i < m->npoints; i++) {
+                float const* p = m->points + i * 3;
+                float const* n = m->normals + i * 3;
+                float d = p[0] * n[0] + p[1] * n[1] + p[2] * n[2];
+                assert_ok(d > 0.99);
+            }
+            par_shapes_free_mesh(m);
+        }
     }
 
     describe("misc shapes") {
@@ -300,6 +779,26 @@ int main()
             par_shapes_export(mesh, "build/lsystem.obj");
             par_shapes_free_mesh(mesh);
         }
+        it("should accept any whitespace between tokens") {
+            char const* spaced = "sx 2 call limb rule limb.3 shape tube "
+                "tz 1 rx 10 shape connect call limb rule limb.1 sa 0.5 "
+                "call limb";
+            char const* multiline = "sx 2\tcall limb\n"
+                "rule limb.3\n  shape tube tz 1 rx 10\n  shape connect\n"
+                "  call limb\n"
+                "rule limb.1\n  sa 0.5\r\n  call limb\n";
+            srand(7);
+            par_shapes_mesh* a = par_shapes_create_lsystem(spaced, 6, 40);
+            srand(7);
+            par_shapes_mesh* b = par_shapes_create_lsystem(multiline, 6, 40);
+            assert_ok(a->npoints > 0);
+            assert_equal(a->npoints, b->npoints);
+            assert_equal(a->ntriangles, b->ntriangles);
+            assert_ok(!memcmp(a->points, b->points,
+                sizeof(float) * 3 * a->npoints));
+            par_shapes_free_mesh(a);
+            par_shapes_free_mesh(b);
+        }
     }
 
     return assert_failures();
@@ -0,0 +1,766 @@
+#include "describe.h"
+
+#define PAR_STREAMLINES_IMPLEMENTATION
+#include "par_streamlines.h"
+
+typedef struct {
+    int num_calls;
+} advection_stats;
+
+static void swirl(parsl_position* point, void* userdata)
+{
+    advection_stats* stats = (advection_stats*) userdata;
+    const float x = point->x;
+    const float y = point->y;
+    point->x += 0.05f * -y + 0.01f * x;
+    point->y += 0.05f * x;
+    stats->num_calls++;
+}
+
+typedef struct {
+    int num_calls;
+    uint32_t max_count;
+} batch_stats;
+
+static void swirl_batch(float* x, float* y, uint32_t count, void* userdata)
+{
+    batch_stats* stats = (batch_stats*) userdata;
+    for (uint32_t i = 0; i < count; i++) {
+        const float px = x[i];
+        const float py = y[i];
+        x[i] += 0.05f * -py + 0.01f * px;
+        y[i] += 0.05f * px;
+    }
+    stats->num_calls++;
+    stats->max_count = count > stats->max_count ? count : stats->max_count;
+}
+
+static float distance_to_polyline(parsl_position p,
+    parsl_position const* points, uint32_t npoints, uint32_t stride)
+{
+    float result = INFINITY;
+    for (uint32_t i = 0; i + 1 < npoints; i++) {
+        const parsl_position a = points[i * stride];
+        const parsl_position b = points[(i + 1) * stride];
+        const float abx = b.x - a.x, aby = b.y - a.y;
+        const float apx = p.x - a.x, apy = p.y - a.y;
+        const float ab2 = abx * abx + aby * aby;
+        float t = ab2 ? (apx * abx + apy * aby) / ab2 : 0;
+        t = t < 0 ? 0 : t > 1 ? 1 : t;
+        const float dx = apx - t * abx, dy = apy - t * aby;
+        const float d = sqrtf(dx * dx + dy * dy);
+        result = d < result ? d : result;
+    }
+    return result;
+}
+
+static parsl_config streamlines_config()
+{
+    return (parsl_config) {
+        .thickness = 0.02f,
+        .flags = PARSL_FLAG_ANNOTATIONS,
+        .streamlines_seed_spacing = 0.5f,
+        .streamlines_seed_viewport = { -2, -2, 2, 2 },
+    };
+}
+
+static bool same_mesh(parsl_mesh const* a, parsl_mesh const* b)
+{
+    return a->num_vertices == b->num_vertices &&
+        a->num_triangles == b->num_triangles &&
+        !memcmp(a->positions, b->positions,
+            a->num_vertices * sizeof(parsl_position)) &&
+        !memcmp(a->annotations, b->annotations,
+            a->num_vertices * sizeof(parsl_annotation)) &&
+        !memcmp(a->triangle_indices, b->triangle_indices,
+            a->num_triangles * 3 * sizeof(uint32_t));
+}
+
+int main()
+{
+    describe("parsl_mesh_from_lines") {
+
+        it("should keep each spine within its own vertex range") {
+            parsl_context* ctx = parsl_create_context((parsl_config) {
+                .thickness = 1,
+                .flags = PARSL_FLAG_SPINE_LENGTHS,
+            });
+            parsl_position vertices[] = {
+                {0, 0}, {1, 0},
+                {0, 1}, {1, 1}, {2, 2}, {3, 1},
+                {0, 3}, {2, 3}, {2, 5},
+            };
+            uint16_t spine_lengths[] = {2, 4, 3};
+            parsl_mesh* mesh = parsl_mesh_from_lines(ctx, (parsl_spine_list) {
+                .num_vertices = 9,
+                .num_spines = 3,
+                .vertices = vertices,
+                .spine_lengths = spine_lengths,
+                .closed = true,
+            });
+            assert_equal(mesh->num_vertices, 24);
+            assert_equal(mesh->num_triangles, 18);
+            const uint32_t first_vertex[] = {0, 6, 16, 24};
+            const uint32_t first_triangle[] = {0, 4, 12, 18};
+            for (int spine = 0; spine < 3; spine++) {
+                const uint32_t begin = first_triangle[spine] * 3;
+                const uint32_t end = first_triangle[spine + 1] * 3;
+                for (uint32_t i = begin; i < end; i++) {
+                    const uint32_t index = mesh->triangle_indices[i];
+                    assert_ok(index >= first_vertex[spine]);
+                    assert_ok(index < first_vertex[spine + 1]);
+                }
+            }
+            assert_ok(fabsf(mesh->spine_lengths[0] - 2.0f) < 0.001f);
+            assert_ok(fabsf(mesh->spine_lengths[23] - 6.828f) < 0.001f);
+            parsl_destroy_context(ctx);
+        }
+    }
+
+    describe("parsl_mesh_from_lines32") {
+
+        it("should accept more than 65535 spines") {
+            const uint32_t num_spines = 70000;
+            parsl_position* vertices = malloc(sizeof(parsl_position) *
+                num_spines * 2);
+            uint32_t* spine_lengths = malloc(sizeof(uint32_t) * num_spines);
+            for (uint32_t i = 0; i < num_spines; i++) {
+                vertices[i * 2 + 0] = (parsl_position) {0, i};
+                vertices[i * 2 + 1] = (parsl_position) {1, i};
+                spine_lengths[i] = 2;
+            }
+            parsl_context* ctx = parsl_create_context((parsl_config) {
+                .thickness = 0.5f,
+            });
+            parsl_mesh* mesh = parsl_mesh_from_lines32(ctx,
+                (parsl_spine_list32) {
+                    .num_vertices = num_spines * 2,
+                    .num_spines = num_spines,
+                    .vertices = vertices,
+                    .spine_lengths = spine_lengths,
+                });
+            assert_equal(mesh->num_vertices, num_spines * 4);
+            assert_equal(mesh->num_triangles, num_spines * 2);
+            const parsl_position last = mesh->positions[num_spines * 4 - 1];
+            assert_ok(fabsf(last.x - 1) < 0.001f);
+            assert_ok(fabsf(last.y - (num_spines - 1.25f)) < 0.01f);
+            parsl_destroy_context(ctx);
+            free(spine_lengths);
+            free(vertices);
+        }
+
+        it("should accept spines with more than 65535 vertices") {
+            const uint32_t num_vertices = 100000;
+            parsl_position* vertices = malloc(sizeof(parsl_position) *
+                num_vertices);
+            for (uint32_t i = 0; i < num_vertices; i++) {
+                vertices[i] = (parsl_position) {i * 0.01f, (i % 2) * 0.01f};
+            }
+            uint32_t spine_length = num_vertices;
+            parsl_context* ctx = parsl_create_context((parsl_config) {
+                .thickness = 0.001f,
+                .flags = PARSL_FLAG_ANNOTATIONS,
+                .u_mode = PAR_U_MODE_SEGMENT_INDEX,
+            });
+            parsl_mesh* mesh = parsl_mesh_from_lines32(ctx,
+                (parsl_spine_list32) {
+                    .num_vertices = num_vertices,
+                    .num_spines = 1,
+                    .vertices = vertices,
+                    .spine_lengths = &spine_length,
+                });
+            assert_equal(mesh->num_vertices, num_vertices * 2);
+            const float last_u = mesh->annotations[num_vertices * 2 - 1]
+                .u_along_curve;
+            assert_ok(last_u == num_vertices - 1);
+            parsl_destroy_context(ctx);
+            free(vertices);
+        }
+
+        it("should match the 16-bit curve functions") {
+            parsl_position vertices[] = {
+                {0, 0}, {1, 2}, {3, 2}, {4, 0}, {6, -3}, {8, 0},
+            };
+            uint16_t lengths16[] = {6};
+            uint32_t lengths32[] = {6};
+            parsl_config config = { .thickness = 0.1f,
+                .curves_max_flatness = 0.01f };
+            parsl_context* ctx16 = parsl_create_context(config);
+            parsl_context* ctx32 = parsl_create_context(config);
+            parsl_mesh* mesh16 = parsl_mesh_from_curves_cubic(ctx16,
+                (parsl_spine_list) { 6, 1, vertices, lengths16 });
+            parsl_mesh* mesh32 = parsl_mesh_from_curves_cubic32(ctx32,
+                (parsl_spine_list32) { 6, 1, vertices, lengths32 });
+            assert_ok(mesh16->num_vertices > 20);
+            assert_equal(mesh16->num_vertices, mesh32->num_vertices);
+            assert_ok(!memcmp(mesh16->positions, mesh32->positions,
+                mesh16->num_vertices * sizeof(parsl_position)));
+            parsl_destroy_context(ctx16);
+            parsl_destroy_context(ctx32);
+        }
+    }
+
+    describe("parsl_update_spine") {
+
+        parsl_position vertices[] = {
+            {0, 0}, {1, 0}, {2, 1},
+            {0, 2}, {1, 3},
+            {0, 4}, {1, 4}, {2, 5}, {3, 4},
+            {0, 6}, {2, 6},
+        };
+        uint32_t spine_lengths[] = {3, 2, 4, 2};
+        parsl_spine_list32 spines = {
+            .num_vertices = 11,
+            .num_spines = 4,
+            .vertices = vertices,
+            .spine_lengths = spine_lengths,
+        };
+        parsl_config config = {
+            .thickness = 0.2f,
+            .flags = PARSL_FLAG_ANNOTATIONS | PARSL_FLAG_SPINE_LENGTHS,
+        };
+
+        it("should only rewrite the edited spine when its length is kept") {
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_context* reference = parsl_create_context(config);
+            parsl_mesh_from_spine_set(ctx, spines);
+            parsl_position edited[] = {{0, 4}, {1, 3}, {2, 3}, {3, 5}};
+            parsl_dirty_range dirty;
+            parsl_mesh* mesh = parsl_update_spine(ctx, 2, edited, 4, &dirty);
+            assert_equal(dirty.first_vertex, 10);
+            assert_equal(dirty.num_vertices, 8);
+            assert_equal(dirty.first_index, 18);
+            assert_equal(dirty.num_indices, 18);
+
+            parsl_position expected_vertices[11];
+            memcpy(expected_vertices, vertices, sizeof(vertices));
+            memcpy(expected_vertices + 5, edited, sizeof(edited));
+            parsl_spine_list32 expected_spines = spines;
+            expected_spines.vertices = expected_vertices;
+            parsl_mesh* expected = parsl_mesh_from_lines32(reference,
+                expected_spines);
+            assert_ok(same_mesh(expected, mesh));
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(reference);
+        }
+
+        it("should move subsequent spines when the length changes") {
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_context* reference = parsl_create_context(config);
+            parsl_mesh_from_spine_set(ctx, spines);
+            parsl_position longer[] = {{0, 2}, {1, 3}, {2, 2}, {3, 3}, {4, 2}};
+            parsl_dirty_range dirty;
+            parsl_mesh* mesh = parsl_update_spine(ctx, 1, longer, 5, &dirty);
+            assert_equal(dirty.first_vertex, 6);
+            assert_equal(dirty.num_vertices, 22);
+            assert_equal(dirty.first_index, 12);
+            assert_equal(dirty.num_indices, 48);
+
+            parsl_position expected_vertices[] = {
+                {0, 0}, {1, 0}, {2, 1},
+                {0, 2}, {1, 3}, {2, 2}, {3, 3}, {4, 2},
+                {0, 4}, {1, 4}, {2, 5}, {3, 4},
+                {0, 6}, {2, 6},
+            };
+            uint32_t expected_lengths[] = {3, 5, 4, 2};
+            parsl_spine_list32 expected_spines = {
+                14, 4, expected_vertices, expected_lengths
+            };
+            parsl_mesh* expected = parsl_mesh_from_lines32(reference,
+                expected_spines);
+            assert_ok(same_mesh(expected, mesh));
+
+            // Shrink it back down to the original spine.
+            mesh = parsl_update_spine(ctx, 1, vertices + 3, 2, &dirty);
+            expected = parsl_mesh_from_lines32(reference, spines);
+            assert_ok(same_mesh(expected, mesh));
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(reference);
+        }
+
+        it("should preserve the random offsets of other spines") {
+            parsl_config random_config = config;
+            random_config.flags |= PARSL_FLAG_RANDOM_OFFSETS;
+            parsl_context* ctx = parsl_create_context(random_config);
+            parsl_mesh* mesh = parsl_mesh_from_spine_set(ctx, spines);
+            float before[4];
+            const uint32_t first_vertex[] = {0, 6, 10, 18, 22};
+            for (int spine = 0; spine < 4; spine++) {
+                before[spine] = mesh->random_offsets[first_vertex[spine]];
+            }
+            parsl_position shorter[] = {{0, 4}, {3, 4}};
+            parsl_update_spine(ctx, 2, shorter, 2, NULL);
+            const uint32_t new_first_vertex[] = {0, 6, 10, 14, 18};
+            for (int spine = 0; spine < 4; spine++) {
+                const uint32_t begin = new_first_vertex[spine];
+                const uint32_t end = new_first_vertex[spine + 1];
+                for (uint32_t v = begin; v < end; v++) {
+                    assert_ok(mesh->random_offsets[v] == before[spine]);
+                }
+            }
+            parsl_destroy_context(ctx);
+        }
+
+        it("should rebuild everything after another call") {
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_context* reference = parsl_create_context(config);
+            parsl_mesh_from_spine_set(ctx, spines);
+            parsl_position other[] = {{5, 5}, {6, 6}};
+            uint32_t other_length = 2;
+            parsl_mesh_from_lines32(ctx, (parsl_spine_list32) {
+                2, 1, other, &other_length
+            });
+            parsl_dirty_range dirty;
+            parsl_mesh* mesh = parsl_update_spine(ctx, 3, vertices + 9, 2,
+                &dirty);
+            parsl_mesh* expected = parsl_mesh_from_lines32(reference, spines);
+            assert_ok(same_mesh(expected, mesh));
+            assert_equal(dirty.first_vertex, 0);
+            assert_equal(dirty.num_vertices, 22);
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(reference);
+        }
+    }
+
+    describe("parsl_set_output") {
+
+        parsl_position vertices[] = {
+            {0, 0}, {1, 0}, {2, 1},
+            {0, 2}, {1, 3},
+            {0, 4}, {1, 4}, {2, 5}, {3, 4},
+        };
+        uint32_t spine_lengths[] = {3, 2, 4};
+        parsl_spine_list32 spines = {
+            .num_vertices = 9,
+            .num_spines = 3,
+            .vertices = vertices,
+            .spine_lengths = spine_lengths,
+        };
+        parsl_config config = {
+            .thickness = 0.2f,
+            .flags = PARSL_FLAG_ANNOTATIONS | PARSL_FLAG_SPINE_LENGTHS,
+        };
+        typedef struct {
+            parsl_position position;
+            parsl_annotation annotation;
+            float spine_length;
+        } vertex;
+
+        it("should write interleaved attributes into client buffers") {
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_context* reference = parsl_create_context(config);
+            parsl_mesh* expected = parsl_mesh_from_lines32(reference, spines);
+            vertex buffer[18];
+            uint32_t indices[36];
+            parsl_output output = {
+                .positions = &buffer[0].position,
+                .positions_stride = sizeof(vertex),
+                .annotations = &buffer[0].annotation,
+                .annotations_stride = sizeof(vertex),
+                .spine_lengths = &buffer[0].spine_length,
+                .spine_lengths_stride = sizeof(vertex),
+                .triangle_indices = indices,
+                .max_vertices = 18,
+                .max_indices = 36,
+            };
+            parsl_set_output(ctx, &output);
+            parsl_mesh* mesh = parsl_mesh_from_lines32(ctx, spines);
+            assert_equal(mesh->num_vertices, 18);
+            assert_equal(mesh->num_triangles, 12);
+            assert_null(mesh->positions);
+            bool same = true;
+            for (uint32_t i = 0; i < 18; i++) {
+                same = same && !memcmp(&buffer[i].position,
+                    &expected->positions[i], sizeof(parsl_position));
+                same = same && !memcmp(&buffer[i].annotation,
+                    &expected->annotations[i], sizeof(parsl_annotation));
+                same = same &&
+                    buffer[i].spine_length == expected->spine_lengths[i];
+            }
+            assert_ok(same);
+            assert_ok(!memcmp(indices, expected->triangle_indices,
+                sizeof(indices)));
+
+            parsl_set_output(ctx, NULL);
+            mesh = parsl_mesh_from_lines32(ctx, spines);
+            assert_ok(same_mesh(expected, mesh));
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(reference);
+        }
+
+        it("should support 16-bit indices") {
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_context* reference = parsl_create_context(config);
+            parsl_mesh* expected = parsl_mesh_from_lines32(reference, spines);
+            parsl_position positions[18];
+            uint16_t indices[36];
+            parsl_output output = {
+                .positions = positions,
+                .triangle_indices = indices,
+                .indices_16bit = true,
+                .max_vertices = 18,
+                .max_indices = 36,
+            };
+            parsl_set_output(ctx, &output);
+            parsl_mesh_from_lines32(ctx, spines);
+            bool same = !memcmp(positions, expected->positions,
+                sizeof(positions));
+            for (uint32_t i = 0; i < 36; i++) {
+                same = same && indices[i] == expected->triangle_indices[i];
+            }
+            assert_ok(same);
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(reference);
+        }
+
+        it("should return null when the client buffers are too small") {
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_position positions[18];
+            uint32_t indices[36];
+            parsl_output output = {
+                .positions = positions,
+                .triangle_indices = indices,
+                .max_vertices = 17,
+                .max_indices = 36,
+            };
+            parsl_set_output(ctx, &output);
+            assert_null(parsl_mesh_from_lines32(ctx, spines));
+            assert_null(parsl_mesh_from_spine_set(ctx, spines));
+            output.max_vertices = 18;
+            parsl_set_output(ctx, &output);
+            assert_ok(parsl_mesh_from_spine_set(ctx, spines));
+            parsl_position edited[] = {{0, 2}, {1, 3}, {2, 2}};
+            assert_null(parsl_update_spine(ctx, 1, edited, 3, NULL));
+            parsl_destroy_context(ctx);
+        }
+    }
+
+    describe("PARSL_FLAG_SCREEN_SPACE_LOD") {
+
+        parsl_config config = {
+            .thickness = 2,
+            .flags = PARSL_FLAG_SCREEN_SPACE_LOD,
+            .view_matrix = {1, 0, 0, 1, 0, 0},
+            .view_viewport = {0, 0, 640, 480},
+        };
+
+        it("should cull spines that are outside of the viewport") {
+            parsl_position vertices[] = {
+                {10, 10}, {100, 10},
+                {-500, 10}, {-100, 10},
+                {600, 470}, {700, 500},
+            };
+            uint32_t spine_lengths[] = {2, 2, 2};
+            parsl_spine_list32 spines = { 6, 3, vertices, spine_lengths };
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_mesh* mesh = parsl_mesh_from_lines32(ctx, spines);
+            assert_equal(mesh->num_vertices, 8);
+            assert_ok(mesh->positions[4].x > 590);
+
+            // Panning the view brings the culled spine back.
+            parsl_config panned = config;
+            panned.view_matrix[4] = 600;
+            parsl_context* panned_ctx = parsl_create_context(panned);
+            mesh = parsl_mesh_from_lines32(panned_ctx, spines);
+            assert_equal(mesh->num_vertices, 8);
+            assert_ok(mesh->positions[4].x < -400);
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(panned_ctx);
+        }
+
+        it("should merge sub-pixel segments") {
+            enum { NUM_VERTICES = 1000 };
+            parsl_position vertices[NUM_VERTICES];
+            for (int i = 0; i < NUM_VERTICES; i++) {
+                vertices[i] = (parsl_position) {100 + i * 0.01f, 100};
+            }
+            uint32_t spine_length = NUM_VERTICES;
+            parsl_spine_list32 spines = {
+                NUM_VERTICES, 1, vertices, &spine_length
+            };
+            parsl_context* ctx = parsl_create_context(config);
+            parsl_mesh* mesh = parsl_mesh_from_lines32(ctx, spines);
+            assert_ok(mesh->num_vertices <= 24);
+            assert_ok(mesh->positions[mesh->num_vertices - 1].x ==
+                vertices[NUM_VERTICES - 1].x);
+
+            // Zooming in by 100x makes every segment one pixel long.
+            parsl_config zoomed = config;
+            zoomed.view_matrix[0] = zoomed.view_matrix[3] = 100;
+            zoomed.view_matrix[4] = zoomed.view_matrix[5] = -10000;
+            parsl_context* zoomed_ctx = parsl_create_context(zoomed);
+            mesh = parsl_mesh_from_lines32(zoomed_ctx, spines);
+            assert_ok(mesh->num_vertices > NUM_VERTICES);
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(zoomed_ctx);
+        }
+
+        it("should measure curve flatness in pixels") {
+            parsl_position vertices[] = {
+                {10, 10}, {20, 40}, {40, -10}, {50, 20},
+            };
+            uint16_t spine_lengths[] = {4};
+            parsl_spine_list spines = { 4, 1, vertices, spine_lengths };
+            parsl_context* ctx = parsl_create_context(config);
+            const uint32_t num_vertices = parsl_mesh_from_curves_cubic(ctx,
+                spines)->num_vertices;
+            parsl_config zoomed = config;
+            zoomed.view_matrix[0] = zoomed.view_matrix[3] = 8;
+            parsl_context* zoomed_ctx = parsl_create_context(zoomed);
+            const uint32_t num_zoomed_vertices = parsl_mesh_from_curves_cubic(
+                zoomed_ctx, spines)->num_vertices;
+            assert_ok(num_zoomed_vertices > num_vertices * 2);
+            parsl_destroy_context(ctx);
+            parsl_destroy_context(zoomed_ctx);
+        }
+    }
+
+    describe("parsl_mesh_from_curves_cubic") {
+
+        it("should stay within the flatness tolerance") {
+            parsl_position vertices[] = {
+                {0, 0}, {10, 40}, {30, -20}, {40, 10}, {60, 50}, {80, 0},
+            };
+            uint16_t spine_lengths[] = {6};
+            const float tolerance = 0.05f;
+            parsl_context* ctx = parsl_create_context((parsl_config) {
+                .thickness = 0,
+                .curves_max_flatness = tolerance,
+            });
+            parsl_mesh* mesh = parsl_mesh_from_curves_cubic(ctx,
+                (parsl_spine_list) { 6, 1, vertices, spine_lengths });
+            const uint32_t npoints = mesh->num_vertices / 2;
+            const parsl_position last = mesh->positions[npoints * 2 - 1];
+            assert_ok(npoints > 10);
+            assert_ok(last.x == 80 && last.y == 0);
+
+            // Densely sample both curves and compare against the polyline.
+            const parsl_position c1 = {50, 40};
+            const parsl_position curves[2][4] = {
+                { vertices[0], vertices[1], vertices[2], vertices[3] },
+                { vertices[3], c1, vertices[4], vertices[5] },
+            };
+            float max_error = 0;
+            for (int c = 0; c < 2; c++) {
+                parsl_position const* p = curves[c];
+                for (int i = 0; i <= 1000; i++) {
+                    const float t = i / 1000.0f, s = 1 - t;
+                    const parsl_position q = {
+                        s*s*s*p[0].x + 3*s*s*t*p[1].x + 3*s*t*t*p[2].x +
+                            t*t*t*p[3].x,
+                        s*s*s*p[0].y + 3*s*s*t*p[1].y + 3*s*t*t*p[2].y +
+                            t*t*t*p[3].y,
+                    };
+                    const float d = distance_to_polyline(q, mesh->positions,
+                        npoints, 2);
+                    max_error = d > max_error ? d : max_error;
+                }
+            }
+            assert_ok(max_error <= tolerance * 1.01f);
+            parsl_destroy_context(ctx);
+        }
+
+        it("should append guides after the flattened curves") {
+            parsl_position vertices[] = {
+                {0, 0}, {1, 2}, {3, 2}, {4, 0}, {6, -3}, {8, 0},
+            };
+            uint16_t spine_lengths[] = {6};
+            parsl_context* ctx = parsl_create_context((parsl_config) {
+                .thickness = 0,
+                .flags = PARSL_FLAG_CURVE_GUIDES,
+            });
+            parsl_mesh* mesh = parsl_mesh_from_curves_cubic(ctx,
+                (parsl_spine_list) { 6, 1, vertices, spine_lengths });
+            // Guides are drawn with unit thickness, so compare the midpoints.
+            const float expected[8][2] = {
+                {0, 0}, {1, 2}, {3, 2}, {4, 0},
+                {4, 0}, {5, -2}, {8, 0}, {6, -3},
+            };
+            parsl_position const* guides = mesh->positions +
+                mesh->num_vertices - 16;
+            for (int i = 0; i < 8; i++) {
+                const float x = (guides[i * 2].x + guides[i * 2 + 1].x) / 2;
+                const float y = (guides[i * 2].y + guides[i * 2 + 1].y) / 2;
+                assert_ok(fabsf(x - expected[i][0]) < 0.0001f);
+                assert_ok(fabsf(y - expected[i][1]) < 0.0001f);
+            }
+            parsl_destroy_context(ctx);
+        }
+    }
+
+    describe("parsl_mesh_from_curves_quadratic") {
+
+        it("should stay within the flatness tolerance") {
+            parsl_position vertices[] = {
+                {0, 0}, {20, 60}, {40, 0}, {60, -30}, {70, 0},
+            };
+            uint16_t spine_lengths[] = {5};
+            const float tolerance = 0.02f;
+            parsl_context* ctx = parsl_create_context((parsl_config) {
+                .thickness = 0,
+                .curves_max_flatness = tolerance,
+            });
+            parsl_mesh* mesh = parsl_mesh_from_curves_quadratic(ctx,
+                (parsl_spine_list) { 5, 1, vertices, spine_lengths });
+            const uint32_t npoints = mesh->num_vertices / 2;
+            float max_error = 0;
+            for (int c = 0; c < 2; c++) {
+                parsl_position const* p = vertices + c * 2;
+                for (int i = 0; i <= 1000; i++) {
+                    const float t = i / 1000.0f, s = 1 - t;
+                    const parsl_position q = {
+                        s*s*p[0].x + 2*s*t*p[1].x + t*t*p[2].x,
+                        s*s*p[0].y + 2*s*t*p[1].y + t*t*p[2].y,
+                    };
+                    const float d = distance_to_polyline(q, mesh->positions,
+                        npoints, 2);
+                    max_error = d > max_error ? d : max_error;
+                }
+            }
+            assert_ok(max_error <= tolerance * 1.01f);
+            parsl_destroy_context(ctx);
+        }
+    }
+
+    describe("parsl_mesh_from_streamlines_advance") {
+
+        it("should match the stateless function at every tick") {
+            parsl_context* stateless = parsl_create_context(
+                streamlines_config());
+            parsl_context* stateful = parsl_create_context(
+                streamlines_config());
+            advection_stats stats = {0};
+            uint32_t first_tick = 0;
+            const uint32_t deltas[] = {0, 1, 3, 7, 10, 25, 2};
+            for (int i = 0; i < sizeof(deltas) / sizeof(deltas[0]); i++) {
+                first_tick += deltas[i];
+                parsl_mesh* expected = parsl_mesh_from_streamlines(stateless,
+                    swirl, first_tick, 10, &stats);
+                parsl_mesh* actual = parsl_mesh_from_streamlines_advance(
+                    stateful, swirl, deltas[i], 10, &stats);
+                assert_ok(same_mesh(expected, actual));
+            }
+            parsl_destroy_context(stateless);
+            parsl_destroy_context(stateful);
+        }
+
+        it("should only advect the delta on each call") {
+            parsl_context* ctx = parsl_create_context(streamlines_config());
+            advection_stats stats = {0};
+            parsl_mesh* mesh = parsl_mesh_from_streamlines_advance(ctx, swirl,
+                0, 16, &stats);
+            const int num_seeds = mesh->num_vertices / 32;
+            assert_equal(stats.num_calls, num_seeds * 16);
+            for (int frame = 0; frame < 100; frame++) {
+                stats.num_calls = 0;
+                parsl_mesh_from_streamlines_advance(ctx, swirl, 2, 16, &stats);
+                assert_equal(stats.num_calls, num_seeds * 2);
+            }
+            parsl_destroy_context(ctx);
+        }
+
+        it("should replay the history when the window changes") {
+            parsl_context* stateless = parsl_create_context(
+                streamlines_config());
+            parsl_context* stateful = parsl_create_context(
+                streamlines_config());
+            advection_stats stats = {0};
+            parsl_mesh_from_streamlines_advance(stateful, swirl, 5, 8, &stats);
+            parsl_mesh* actual = parsl_mesh_from_streamlines_advance(stateful,
+                swirl, 4, 12, &stats);
+            parsl_mesh* expected = parsl_mesh_from_streamlines(stateless,
+                swirl, 9, 12, &stats);
+            assert_ok(same_mesh(expected, actual));
+            parsl_destroy_context(stateless);
+            parsl_destroy_context(stateful);
+        }
+    }
+
+    describe("parsl_set_streamline_seeds") {
+
+        it("should share cached seeds across contexts") {
+            parsl_context* source = parsl_create_context(streamlines_config());
+            uint32_t num_seeds;
+            parsl_position const* seeds = parsl_get_streamline_seeds(source,
+                &num_seeds);
+            assert_ok(num_seeds > 10);
+            for (uint32_t i = 0; i < num_seeds; i++) {
+                assert_ok(seeds[i].x >= -2 && seeds[i].x <= 2);
+                assert_ok(seeds[i].y >= -2 && seeds[i].y <= 2);
+            }
+
+            // The second context has no seed viewport of its own.
+            parsl_config config = streamlines_config();
+            config.streamlines_seed_spacing = 0;
+            parsl_context* target = parsl_create_context(config);
+            parsl_set_streamline_seeds(target, seeds, num_seeds);
+
+            advection_stats stats = {0};
+            parsl_mesh* expected = parsl_mesh_from_streamlines(source, swirl,
+                4, 10, &stats);
+            parsl_mesh* actual = parsl_mesh_from_streamlines(target, swirl,
+                4, 10, &stats);
+            assert_ok(same_mesh(expected, actual));
+            parsl_destroy_context(source);
+            parsl_destroy_context(target);
+        }
+
+        it("should restart retained particles from the new seeds") {
+            parsl_context* ctx = parsl_create_context(streamlines_config());
+            advection_stats stats = {0};
+            parsl_mesh_from_streamlines_advance(ctx, swirl, 5, 8, &stats);
+            parsl_position seeds[] = {{0, 1}, {1, 0}, {-1, 0}};
+            parsl_set_streamline_seeds(ctx, seeds, 3);
+            stats.num_calls = 0;
+            parsl_mesh* mesh = parsl_mesh_from_streamlines_advance(ctx, swirl,
+                2, 8, &stats);
+            assert_equal(mesh->num_vertices, 3 * 8 * 2);
+            assert_equal(stats.num_calls, 3 * (7 + 8));
+            parsl_destroy_context(ctx);
+        }
+    }
+
+    describe("parsl_mesh_from_streamlines_batch") {
+
+        it("should match the single-particle callback") {
+            parsl_context* pointwise = parsl_create_context(
+                streamlines_config());
+            parsl_context* batched = parsl_create_context(
+                streamlines_config());
+            advection_stats stats = {0};
+            batch_stats bstats = {0};
+            parsl_mesh* expected = parsl_mesh_from_streamlines(pointwise,
+                swirl, 5, 10, &stats);
+            parsl_mesh* actual = parsl_mesh_from_streamlines_batch(batched,
+                swirl_batch, 5, 10, &bstats);
+            assert_ok(same_mesh(expected, actual));
+            assert_equal(bstats.num_calls, 15);
+            assert_equal(bstats.max_count, expected->num_vertices / 20);
+            parsl_destroy_context(pointwise);
+            parsl_destroy_context(batched);
+        }
+
+        it("should advance with one call per tick") {
+            parsl_context* pointwise = parsl_create_context(
+                streamlines_config());
+            parsl_context* batched = parsl_create_context(
+                streamlines_config());
+            advection_stats stats = {0};
+            batch_stats bstats = {0};
+            for (int frame = 0; frame < 10; frame++) {
+                bstats.num_calls = 0;
+                parsl_mesh* expected = parsl_mesh_from_streamlines_advance(
+                    pointwise, swirl, 3, 10, &stats);
+                parsl_mesh* actual = parsl_mesh_from_streamlines_advance_batch(
+                    batched, swirl_batch, 3, 10, &bstats);
+                const int num_calls = frame ? 3 : 13;
+                assert_ok(same_mesh(expected, actual));
+                assert_equal(bstats.num_calls, num_calls);
+            }
+            parsl_destroy_context(pointwise);
+            parsl_destroy_context(batched);
+        }
+    }
+
+    return assert_failures();
+}